@@ -0,0 +1,66 @@
+/*
+*
+*  Universal Tensor Network Library (Uni10)
+*  @file
+*  benchContract.cpp
+*
+*  @license
+*  Copyright (C) 2013-2014
+*  This file is part of Uni10
+*
+*  Uni10 is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Lesser General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <uni10.hpp>
+#include <uni10/tools/uni10_tools.h>
+
+// Throughput of contract() on two MPS-like tensors under each NUMA policy, with and without the memory pool.
+// Usage: benchContract [chi] [d] [repeats]
+int main(int argc, char** argv){
+	int chi = argc > 1 ? atoi(argv[1]) : 256;
+	int d = argc > 2 ? atoi(argv[2]) : 4;
+	int repeats = argc > 3 ? atoi(argv[3]) : 50;
+
+	std::vector<uni10::Bond> bonds;
+	bonds.push_back(uni10::Bond(uni10::BD_IN, chi));
+	bonds.push_back(uni10::Bond(uni10::BD_IN, d));
+	bonds.push_back(uni10::Bond(uni10::BD_OUT, chi));
+	int labelA[] = {1, 2, 3};
+	int labelB[] = {3, 4, 5};
+	uni10::UniTensor A(bonds, labelA, "A");
+	uni10::UniTensor B(bonds, labelB, "B");
+	A.randomize();
+	B.randomize();
+	double flops = 2.0 * chi * d * chi * d * chi;
+
+	const char* names[] = {"default", "interleave", "firsttouch"};
+	uni10::numaPolicy policies[] = {uni10::NUMA_DEFAULT, uni10::NUMA_INTERLEAVE, uni10::NUMA_FIRST_TOUCH};
+	printf("chi = %d, d = %d, %d threads, %.2f GFLOP per contraction\n", chi, d, uni10::getThreadNum(), flops / 1e9);
+	printf("%-12s %-6s %12s %10s\n", "policy", "pool", "contract/s", "GFLOP/s");
+	for(int pool = 1; pool >= 0; pool--)
+		for(int p = 0; p < 3; p++){
+			uni10::setPoolEnabled(pool);
+			uni10::setNumaPolicy(policies[p]);
+			uni10::contract(A, B);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int r = 0; r < repeats; r++)
+				uni10::contract(A, B);
+			double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("%-12s %-6s %12.1f %10.2f\n", names[p], pool ? "on" : "off", repeats / sec, repeats * flops / sec / 1e9);
+		}
+	return 0;
+}
@@ -153,6 +153,18 @@ namespace uni10{
         /// @brief Copy constructor
         ///
         Block(const Block& _b);
+        /// @brief Move constructor
+        ///
+        /// Takes over the elements referenced by \c _b and leaves it as an empty Block.
+        Block(Block&& _b);
+        /// @brief Assign a Block
+        ///
+        /// Block references the elements of \c _b, no elements are copied.
+        Block& operator=(const Block& _b);
+        /// @brief Move assignment
+        ///
+        /// Takes over the elements referenced by \c _b and leaves it as an empty Block.
+        Block& operator=(Block&& _b);
 	    virtual ~Block();
         ///
         /// @brief Returns the number of rows in Block
@@ -84,6 +84,24 @@ public:
 
     Bond(const Bond& bd);
 
+    /// @brief Move constructor
+    ///
+    /// Takes over the quantum numbers of \c bd and leaves it with dimension zero.
+    /// @param bd Reference to a second Bond
+    Bond(Bond&& bd);
+
+    /// @brief Assign elements
+    ///
+    /// Assigns the content of \c bd to Bond, replacing the original content.
+    /// @param bd Reference to a second Bond
+    Bond& operator=(const Bond& bd);
+
+    /// @brief Move assignment
+    ///
+    /// Takes over the quantum numbers of \c bd and leaves it with dimension zero.
+    /// @param bd Reference to a second Bond
+    Bond& operator=(Bond&& bd);
+
     /// @brief Destructor
     ///
     ~Bond();
@@ -128,6 +146,12 @@ public:
     /// @return Vector of Qnum
     std::vector<Qnum> Qlist()const;
 
+    /// @brief Check for a bond without symmetry
+    ///
+    /// Unlike comparing Qlist(), this takes no copy of the quantum numbers.
+    /// @return \c True if all the states of Bond carry the trivial Qnum
+    bool withoutSymmetry()const;
+
     /// @brief Change the type of Bond
     ///
     /// Changes the type of Bond and the Qnum's of the bond when necssary.
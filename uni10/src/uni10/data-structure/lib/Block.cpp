@@ -203,6 +203,36 @@ namespace uni10{
 
   Block::Block(const Block& _b): r_flag(_b.r_flag), c_flag(_b.c_flag), m_elem(_b.m_elem), cm_elem(_b.cm_elem), Rnum(_b.Rnum), Cnum(_b.Cnum), diag(_b.diag), ongpu(_b.ongpu){}
 
+  Block::Block(Block&& _b): r_flag(_b.r_flag), c_flag(_b.c_flag), m_elem(_b.m_elem), cm_elem(_b.cm_elem), Rnum(_b.Rnum), Cnum(_b.Cnum), diag(_b.diag), ongpu(_b.ongpu){
+    _b.m_elem = NULL;
+    _b.cm_elem = NULL;
+    _b.Rnum = 0;
+    _b.Cnum = 0;
+  }
+
+  Block& Block::operator=(const Block& _b){
+    r_flag = _b.r_flag;
+    c_flag = _b.c_flag;
+    m_elem = _b.m_elem;
+    cm_elem = _b.cm_elem;
+    Rnum = _b.Rnum;
+    Cnum = _b.Cnum;
+    diag = _b.diag;
+    ongpu = _b.ongpu;
+    return *this;
+  }
+
+  Block& Block::operator=(Block&& _b){
+    if(this == &_b)
+      return *this;
+    Block::operator=(_b);
+    _b.m_elem = NULL;
+    _b.cm_elem = NULL;
+    _b.Rnum = 0;
+    _b.Cnum = 0;
+    return *this;
+  }
+
   Block::~Block(){}
 
   size_t Block::row()const{return Rnum;}
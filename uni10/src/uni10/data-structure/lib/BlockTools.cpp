@@ -45,7 +45,14 @@ namespace uni10{
       }
       if((!Ma.diag) && (!Mb.diag)){
         Matrix Mc(RTYPE, Ma.Rnum, Mb.Cnum);
-        matrixMul(Ma.m_elem, Mb.m_elem, Ma.Rnum, Mb.Cnum, Ma.Cnum, Mc.m_elem, Ma.ongpu, Mb.ongpu, Mc.ongpu);
+        int M = Ma.Rnum, N = Mb.Cnum, K = Ma.Cnum;
+        if(!Ma.ongpu && !Mb.ongpu && !Mc.ongpu && smallGemm(M, N, K)){
+          const Real* A = Ma.m_elem;
+          const Real* B = Mb.m_elem;
+          matrixMulBatch(false, false, 1, &A, &B, &M, &N, &K, 1.0, 0.0, &Mc.m_elem, false);
+        }
+        else
+          matrixMul(Ma.m_elem, Mb.m_elem, Ma.Rnum, Mb.Cnum, Ma.Cnum, Mc.m_elem, Ma.ongpu, Mb.ongpu, Mc.ongpu);
         return Mc;
       }
       else if(Ma.diag && (!Mb.diag)){
@@ -84,7 +91,14 @@ namespace uni10{
     }
     if((!Ma.diag) && (!Mb.diag)){
       Matrix Mc(CTYPE, Ma.Rnum, Mb.Cnum);
-      matrixMul(Ma.cm_elem, Mb.cm_elem, Ma.Rnum, Mb.Cnum, Ma.Cnum, Mc.cm_elem, Ma.ongpu, Mb.ongpu, Mc.ongpu);
+      int M = Ma.Rnum, N = Mb.Cnum, K = Ma.Cnum;
+      if(!Ma.ongpu && !Mb.ongpu && !Mc.ongpu && smallGemm(M, N, K)){
+        const Complex* A = Ma.cm_elem;
+        const Complex* B = Mb.cm_elem;
+        matrixMulBatch(false, false, 1, &A, &B, &M, &N, &K, Complex(1.0), Complex(0.0), &Mc.cm_elem, false);
+      }
+      else
+        matrixMul(Ma.cm_elem, Mb.cm_elem, Ma.Rnum, Mb.Cnum, Ma.Cnum, Mc.cm_elem, Ma.ongpu, Mb.ongpu, Mc.ongpu);
       return Mc;
     }
     else if(Ma.diag && (!Mb.diag)){
@@ -54,6 +54,31 @@ Bond::Bond(bondType _type, const std::vector<Qnum>& qnums) : m_type(_type){
 
 Bond::Bond(const Bond& _b):m_type(_b.m_type), m_dim(_b.m_dim), Qnums(_b.Qnums), Qdegs(_b.Qdegs), offsets(_b.offsets){
 }
+Bond::Bond(Bond&& _b):m_type(_b.m_type), m_dim(_b.m_dim), Qnums(std::move(_b.Qnums)), Qdegs(std::move(_b.Qdegs)), offsets(std::move(_b.offsets)){
+  _b.m_dim = 0;
+}
+Bond& Bond::operator=(const Bond& _b){
+  m_type = _b.m_type;
+  m_dim = _b.m_dim;
+  Qnums = _b.Qnums;
+  Qdegs = _b.Qdegs;
+  offsets = _b.offsets;
+  return *this;
+}
+Bond& Bond::operator=(Bond&& _b){
+  if(this == &_b)
+    return *this;
+  m_type = _b.m_type;
+  m_dim = _b.m_dim;
+  Qnums.swap(_b.Qnums);
+  Qdegs.swap(_b.Qdegs);
+  offsets.swap(_b.offsets);
+  _b.m_dim = 0;
+  _b.Qnums.clear();
+  _b.Qdegs.clear();
+  _b.offsets.clear();
+  return *this;
+}
 bondType Bond::type()const{
 	return m_type;
 }
@@ -146,6 +171,10 @@ std::vector<Qnum> Bond::Qlist()const{
 	return list;
 }
 
+bool Bond::withoutSymmetry()const{
+	return Qnums.empty() || (Qnums.size() == 1 && Qnums[0] == Qnum());
+}
+
 bool operator== (const Bond& b1, const Bond& b2){
 	return (b1.m_type == b2.m_type) && (b1.Qnums == b2.Qnums) && (b1.Qdegs == b2.Qdegs);
 }
@@ -34,14 +34,21 @@
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include <map>
 #include <uni10/data-structure/Block.h>
+#include <uni10/data-structure/Bond.h>
 namespace uni10{
 typedef struct{
 	int b1;
 	int b2;
 }_Swap;
+// Cost of a pair-wise contraction, resolved into the symmetry sectors of the bonds
+typedef struct{
+	double flops;	//multiply-adds of the products of the blocks
+	double traffic;	//elements moved to permute the operands and the outer product
+	int64_t elemNum;	//elements of the result
+}_ContractCost;
 class UniTensor;
-class Bond;
 class Node {
 public:
     Node();
@@ -51,6 +58,9 @@ public:
     ~Node();
     Node contract(Node* nd);
     float metric(Node* nd);
+    _ContractCost cost(Node* nd);
+    static void addSectors(std::map<Qnum, double>& sectors, const Bond& bd, bondType tp);
+    static double sectorCost(const std::map<Qnum, double>& rows, const std::map<Qnum, double>& inner, const std::map<Qnum, double>& cols, double& size);
     friend std::ostream& operator<< (std::ostream& os, const Node& nd);
     friend class Network;
 private:
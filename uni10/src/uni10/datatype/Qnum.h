@@ -29,6 +29,7 @@
 *****************************************************************************/
 #ifndef QNUM_H
 #define QNUM_H
+#include <atomic>
 #include <iostream>
 #include <iomanip>
 #include <assert.h>
@@ -129,7 +130,7 @@ public:
     /// Tests whether fermionic parity \c PRTF_ODD exists
     /// @return \c True if the fermionic odd parity exists; \c False otherwise.
     static bool isFermionic() {
-        return Fermionic;
+        return Fermionic.load(std::memory_order_relaxed);
     }
     long int hash()const;
 
@@ -177,7 +178,8 @@ public:
     static const int U1_UPB = 1000; ///<Upper bound of U1 quantum number
     static const int U1_LOB = -1000;///<Lower bound of U1 quantum number
 private:
-    static bool Fermionic;
+    static std::atomic<bool> Fermionic;  // Only ever set, by constructors on any thread
+    static void setFermionic();
     int m_U1;
     parityType m_prt;
     parityFType m_prtF;
@@ -32,7 +32,12 @@
 #include <uni10/tools/uni10_tools.h>
 
 namespace uni10{
-bool Qnum::Fermionic = false;
+std::atomic<bool> Qnum::Fermionic(false);
+void Qnum::setFermionic(){
+  // Test first, so that concurrent constructors do not keep writing the shared flag.
+  if(!Fermionic.load(std::memory_order_relaxed))
+    Fermionic.store(true, std::memory_order_relaxed);
+}
 Qnum::Qnum(int _U1, parityType _prt): m_U1(_U1), m_prt(_prt), m_prtF(PRTF_EVEN){
   try{
     if(!(m_U1 < U1_UPB && m_U1 > U1_LOB)){
@@ -53,7 +58,7 @@ Qnum::Qnum(parityFType _prtF, int _U1, parityType _prt): m_U1(_U1), m_prt(_prt),
     throw std::runtime_error(exception_msg(err.str()));
   }
 	if(_prtF == PRTF_ODD)
-		Fermionic = true;
+		setFermionic();
   }
   catch(const std::exception& e){
     propogate_exception(e, "In constructor Qnum::Qnum(parityFType, int, parityType):");
@@ -93,7 +98,7 @@ void Qnum::assign(parityFType _prtF, int _U1, parityType _prt){
 	m_prt = _prt;
 	m_prtF = _prtF;
 	if(_prtF == PRTF_ODD)
-		Fermionic = true;
+		setFermionic();
 }
 
 int Qnum::U1()const{return m_U1;}
@@ -212,6 +212,7 @@ size_t lanczosEigh(rflag _tp, Matrix& ori_mat, double& E0, Matrix& psi, size_t m
         throw std::runtime_error(exception_msg(err.str()));
       }
     }
+    psi.MelemDetach();
     size_t iter = max_iter;
     if(!arpackEigh(ori_mat.m_elem, psi.m_elem, ori_mat.Rnum, iter, E0, psi.m_elem, ori_mat.ongpu, err_tol)){
       std::ostringstream err;
@@ -245,6 +246,7 @@ size_t lanczosEigh(cflag _tp, Matrix& ori_mat, double& E0, Matrix& psi, size_t m
         throw std::runtime_error(exception_msg(err.str()));
       }
     }
+    psi.MelemDetach();
     size_t iter = max_iter;
     if(!arpackEigh(ori_mat.cm_elem, psi.cm_elem, ori_mat.Rnum, iter, E0, psi.cm_elem, ori_mat.ongpu, err_tol)){
       std::ostringstream err;
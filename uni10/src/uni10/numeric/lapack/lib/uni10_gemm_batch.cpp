@@ -0,0 +1,174 @@
+/****************************************************************************
+*  @file uni10_gemm_batch.cpp
+*  @license
+*    Universal Tensor Network Library
+*    Copyright (c) 2013-2016
+*    National Taiwan University
+*    National Tsing-Hua University
+*
+*    This file is part of Uni10, the Universal Tensor Network Library.
+*
+*    Uni10 is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU Lesser General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    Uni10 is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public License
+*    along with Uni10.  If not, see <http://www.gnu.org/licenses/>.
+*  @endlicense
+*  @brief Batched multiplication of many small matrices on the host
+*  @author Ying-Jer Kao
+*  @date 2016-06-06
+*  @since 1.0.0
+*
+*****************************************************************************/
+#include <complex>
+#ifdef MKL
+  #define MKL_Complex8 std::complex<float>
+  #define MKL_Complex16 std::complex<double>
+  #include "mkl.h"
+#else
+  #include <uni10/numeric/lapack/uni10_lapack_wrapper.h>
+#endif
+#include <algorithm>
+#include <vector>
+#include <uni10/numeric/lapack/uni10_lapack.h>
+#include <uni10/tools/uni10_tools.h>
+
+namespace uni10{
+
+namespace {
+
+/* Register tile of C held by the micro-kernel. */
+const int TILE_M = 4;
+const int TILE_N = 4;
+
+/*
+ * Row-major C = alpha * op(A) * op(B) + beta * C. Each TILE_M x TILE_N tile of C is accumulated in local
+ * variables over the whole K range, which the compiler keeps in registers, and written back once.
+ */
+template<typename T, bool transA, bool transB>
+void microGemm(const T* A, const T* B, int M, int N, int K, T alpha, T beta, T* C){
+  const int strideA = transA ? 1 : K;   // next row of op(A)
+  const int stepA = transA ? M : 1;     // next column of op(A)
+  const int strideB = transB ? K : 1;   // next column of op(B)
+  const int stepB = transB ? 1 : N;     // next row of op(B)
+  for(int i = 0; i < M; i += TILE_M){
+    int mi = std::min(TILE_M, M - i);
+    for(int j = 0; j < N; j += TILE_N){
+      int nj = std::min(TILE_N, N - j);
+      T acc[TILE_M][TILE_N] = {};
+      const T* a = A + i * strideA;
+      const T* b = B + j * strideB;
+      if(mi == TILE_M && nj == TILE_N){
+        for(int k = 0; k < K; k++, a += stepA, b += stepB){
+          T ar[TILE_M], br[TILE_N];
+          for(int r = 0; r < TILE_M; r++)
+            ar[r] = a[r * strideA];
+          for(int c = 0; c < TILE_N; c++)
+            br[c] = b[c * strideB];
+          for(int r = 0; r < TILE_M; r++)
+            for(int c = 0; c < TILE_N; c++)
+              acc[r][c] += ar[r] * br[c];
+        }
+      }
+      else{
+        for(int k = 0; k < K; k++, a += stepA, b += stepB)
+          for(int r = 0; r < mi; r++)
+            for(int c = 0; c < nj; c++)
+              acc[r][c] += a[r * strideA] * b[c * strideB];
+      }
+      for(int r = 0; r < mi; r++){
+        T* c = C + (size_t)(i + r) * N + j;
+        // beta == 0 must not read C, which may be uninitialized.
+        if(beta == T(0))
+          for(int s = 0; s < nj; s++)
+            c[s] = alpha * acc[r][s];
+        else
+          for(int s = 0; s < nj; s++)
+            c[s] = alpha * acc[r][s] + beta * c[s];
+      }
+    }
+  }
+}
+
+template<typename T>
+void microGemm(bool transA, bool transB, const T* A, const T* B, int M, int N, int K, T alpha, T beta, T* C){
+  if(transA)
+    transB ? microGemm<T, true, true>(A, B, M, N, K, alpha, beta, C) : microGemm<T, true, false>(A, B, M, N, K, alpha, beta, C);
+  else
+    transB ? microGemm<T, false, true>(A, B, M, N, K, alpha, beta, C) : microGemm<T, false, false>(A, B, M, N, K, alpha, beta, C);
+}
+
+void blasGemm(bool transA, bool transB, const double* A, const double* B, int M, int N, int K, double alpha, double beta, double* C){
+  int ldA = transA ? M : K;
+  int ldB = transB ? K : N;
+  dgemm(transB ? "T" : "N", transA ? "T" : "N", &N, &M, &K, &alpha, B, &ldB, A, &ldA, &beta, C, &N);
+}
+
+void blasGemm(bool transA, bool transB, const std::complex<double>* A, const std::complex<double>* B, int M, int N, int K, std::complex<double> alpha, std::complex<double> beta, std::complex<double>* C){
+  int ldA = transA ? M : K;
+  int ldB = transB ? K : N;
+  zgemm(transB ? "T" : "N", transA ? "T" : "N", &N, &M, &K, &alpha, B, &ldB, A, &ldA, &beta, C, &N);
+}
+
+struct ShapeLess{
+  ShapeLess(const int* _M, const int* _N, const int* _K): M(_M), N(_N), K(_K){}
+  bool operator()(size_t a, size_t b)const{
+    if(M[a] != M[b])
+      return M[a] < M[b];
+    if(N[a] != N[b])
+      return N[a] < N[b];
+    return K[a] < K[b];
+  }
+  const int* M;
+  const int* N;
+  const int* K;
+};
+
+template<typename T>
+void gemmBatch(bool transA, bool transB, size_t count, const T* const* A, const T* const* B, const int* M, const int* N, const int* K, T alpha, T beta, T* const* C, bool ongpu){
+  if(ongpu){
+    for(size_t i = 0; i < count; i++)
+      matrixMul(transA, transB, A[i], B[i], M[i], N[i], K[i], alpha, beta, C[i], true, true, true);
+    return;
+  }
+  // Products of one shape run back to back on the same kernel.
+  std::vector<size_t> order(count);
+  for(size_t i = 0; i < count; i++)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), ShapeLess(M, N, K));
+  for(size_t g = 0; g < count; ){
+    size_t i = order[g];
+    size_t end = g + 1;
+    while(end < count && M[order[end]] == M[i] && N[order[end]] == N[i] && K[order[end]] == K[i])
+      end++;
+    if(M[i] == 0 || N[i] == 0){
+      g = end;
+      continue;
+    }
+    if(smallGemm(M[i], N[i], K[i]))
+      for(; g < end; g++)
+        microGemm(transA, transB, A[order[g]], B[order[g]], M[i], N[i], K[i], alpha, beta, C[order[g]]);
+    else
+      for(; g < end; g++)
+        blasGemm(transA, transB, A[order[g]], B[order[g]], M[i], N[i], K[i], alpha, beta, C[order[g]]);
+  }
+}
+
+};  /* namespace */
+
+void matrixMulBatch(bool transA, bool transB, size_t count, const double* const* A, const double* const* B, const int* M, const int* N, const int* K, double alpha, double beta, double* const* C, bool ongpu){
+  gemmBatch(transA, transB, count, A, B, M, N, K, alpha, beta, C, ongpu);
+}
+
+void matrixMulBatch(bool transA, bool transB, size_t count, const std::complex<double>* const* A, const std::complex<double>* const* B, const int* M, const int* N, const int* K, std::complex<double> alpha, std::complex<double> beta, std::complex<double>* const* C, bool ongpu){
+  gemmBatch(transA, transB, count, A, B, M, N, K, alpha, beta, C, ongpu);
+}
+
+};  /* namespace uni10 */
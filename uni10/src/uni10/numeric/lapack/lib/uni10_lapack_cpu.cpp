@@ -35,6 +35,12 @@
 #else
   #include <uni10/numeric/lapack/uni10_lapack_wrapper.h>
 #endif
+#ifdef OPENBLAS
+extern "C" {
+void openblas_set_num_threads(int num_threads);
+int openblas_get_num_threads(void);
+}
+#endif
 #include <string.h>
 #include <uni10/numeric/lapack/uni10_lapack.h>
 #include <uni10/tools/uni10_tools.h>
@@ -45,6 +51,29 @@ void matrixMul(double* A, double* B, int M, int N, int K, double* C, bool ongpuA
 	dgemm((char*)"N", (char*)"N", &N, &M, &K, &alpha, B, &N, A, &K, &beta, C, &N);
 }
 
+void matrixMul(bool transA, bool transB, const double* A, const double* B, int M, int N, int K, double alpha, double beta, double* C, bool, bool, bool){
+  // Row-major C = op(A) * op(B) is column-major C^T = op(B)^T * op(A)^T.
+  int ldA = transA ? M : K;
+  int ldB = transB ? K : N;
+  dgemm(transB ? "T" : "N", transA ? "T" : "N", &N, &M, &K, &alpha, B, &ldB, A, &ldA, &beta, C, &N);
+}
+
+int setBlasLocalThreadNum(int num){
+#ifdef MKL
+  return mkl_set_num_threads_local(num);
+#elif defined(OPENBLAS)
+  // The setting is process-wide. Tasks of parallelFor() run under the one made by the thread that started them.
+  if(num < 1 || inParallelFor())
+    return 0;
+  int prev = openblas_get_num_threads();
+  openblas_set_num_threads(num);
+  return prev;
+#else
+  (void)num;
+  return 0;
+#endif
+}
+
 void diagRowMul(double* mat, double* diag, size_t M, size_t N, bool mat_ongpu, bool diag_ongpu){
 	for(size_t i = 0; i < M; i++)
 		vectorScal(diag[i], &(mat[i * N]), N, false);
@@ -105,29 +134,29 @@ void vectorExp(double a, double* X, size_t N, bool ongpu){
  */
 void orthoRandomize(double* elem, int M, int N, bool ongpu){
 	int eleNum = M*N;
-	double *random = (double*)malloc(eleNum * sizeof(double));
+	double *random = (double*)poolAlloc(eleNum * sizeof(double), MEM_LAPACK);
 	elemRand(random, M * N, false);
 	int min = M < N ? M : N;
-	double *S = (double*)malloc(min*sizeof(double));
+	double *S = (double*)poolAlloc(min*sizeof(double), MEM_LAPACK);
 	if(M <= N){
-		double *U = (double*)malloc(M * min * sizeof(double));
+		double *U = (double*)poolAlloc(M * min * sizeof(double), MEM_LAPACK);
 		matrixSVD(random, M, N, U, S, elem, false);
-		free(U);
+		poolFree(U);
 	}
 	else{
-		double *VT = (double*)malloc(min * N * sizeof(double));
+		double *VT = (double*)poolAlloc(min * N * sizeof(double), MEM_LAPACK);
 		matrixSVD(random, M, N, elem, S, VT, false);
-		free(VT);
+		poolFree(VT);
 	}
-	free(random);
-	free(S);
+	poolFree(random);
+	poolFree(S);
 }
 
 void eigDecompose(double* Kij_ori, int N, std::complex<double>* Eig, std::complex<double>* EigVec, bool ongpu){
-  std::complex<double> *Kij = (std::complex<double>*) malloc(N * N * sizeof(std::complex<double>));
+  std::complex<double> *Kij = (std::complex<double>*) poolAlloc(N * N * sizeof(std::complex<double>), MEM_LAPACK);
   elemCast(Kij, Kij_ori, N * N, ongpu, ongpu);
   eigDecompose(Kij, N, Eig, EigVec, ongpu);
-  free(Kij);
+  poolFree(Kij);
 }
 
 void eigSyDecompose(double* Kij, int N, double* Eig, double* EigVec, bool ongpu){
@@ -143,14 +172,14 @@ void eigSyDecompose(double* Kij, int N, double* Eig, double* EigVec, bool ongpu)
     throw std::runtime_error(exception_msg(err.str()));
   }
 	lwork = (int)worktest;
-	double* work= (double*)malloc(sizeof(double)*lwork);
+	double* work= (double*)poolAlloc(sizeof(double)*lwork, MEM_LAPACK);
 	dsyev((char*)"V", (char*)"U", &N, EigVec, &ldA, Eig, work, &lwork, &info);
   if(info != 0){
     std::ostringstream err;
     err<<"Error in Lapack function 'dsyev': Lapack INFO = "<<info;
     throw std::runtime_error(exception_msg(err.str()));
   }
-	free(work);
+	poolFree(work);
 }
 // lapack is builded by fortran which is load by column, so we use
 // dorgqr -> lq
@@ -159,9 +188,9 @@ void eigSyDecompose(double* Kij, int N, double* Eig, double* EigVec, bool ongpu)
 // dorgql -> rq
 void matrixQR(double* Mij_ori, int M, int N, double* Q, double* R, bool ongpu){
   assert(M >= N);
-  double* Mij = (double*)malloc(N*M*sizeof(double));
+  double* Mij = (double*)poolAlloc(N*M*sizeof(double), MEM_LAPACK);
   memcpy(Mij, Mij_ori, N*M*sizeof(double));
-  double* tau = (double*)malloc(M*sizeof(double));
+  double* tau = (double*)poolAlloc(M*sizeof(double), MEM_LAPACK);
   int lda = N;
   int lwork = -1;
   double worktestdge;
@@ -171,29 +200,29 @@ void matrixQR(double* Mij_ori, int M, int N, double* Q, double* R, bool ongpu){
   dgelqf(&N, &M, Mij, &lda, tau, &worktestdge, &lwork, &info);
   dorglq(&N, &M, &K, Mij, &lda, tau, &worktestdor, &lwork, &info);
   lwork = (int)worktestdge;
-  double* workdge = (double*)malloc(lwork*sizeof(double));
+  double* workdge = (double*)poolAlloc(lwork*sizeof(double), MEM_LAPACK);
   dgelqf(&N, &M, Mij, &lda, tau, workdge, &lwork, &info);
   //getQ
   lwork = (int)worktestdor;
-  double* workdor = (double*)malloc(lwork*sizeof(double));
+  double* workdor = (double*)poolAlloc(lwork*sizeof(double), MEM_LAPACK);
   dorglq(&N, &M, &K, Mij, &lda, tau, workdor, &lwork, &info);
   memcpy(Q, Mij, N*M*sizeof(double));
   //getR
   double alpha = 1, beta = 0;
   dgemm((char*)"N", (char*)"T", &N, &N, &M, &alpha, Mij_ori, &N, Mij, &N, &beta, R, &N);
 
-  free(Mij);
-  free(tau);
-  free(workdge);
-  free(workdor);
+  poolFree(Mij);
+  poolFree(tau);
+  poolFree(workdge);
+  poolFree(workdor);
 }
 
 void matrixRQ(double* Mij_ori, int M, int N, double* Q, double* R, bool ongpu){
 
   assert(N >= M);
-  double* Mij = (double*)malloc(M*N*sizeof(double));
+  double* Mij = (double*)poolAlloc(M*N*sizeof(double), MEM_LAPACK);
   memcpy(Mij, Mij_ori, M*N*sizeof(double));
-  double* tau = (double*)malloc(M*sizeof(double));
+  double* tau = (double*)poolAlloc(M*sizeof(double), MEM_LAPACK);
   int lda = N;
   int lwork = -1;
   double worktestdge;
@@ -203,31 +232,30 @@ void matrixRQ(double* Mij_ori, int M, int N, double* Q, double* R, bool ongpu){
   dgeqlf(&N, &M, Mij, &lda, tau, &worktestdge, &lwork, &info);
   dorgql(&N, &M, &K, Mij, &lda, tau, &worktestdor, &lwork, &info);
   lwork = (int)worktestdge;
-  double* workdge = (double*)malloc(lwork*sizeof(double));
+  double* workdge = (double*)poolAlloc(lwork*sizeof(double), MEM_LAPACK);
   dgeqlf(&N, &M, Mij, &lda, tau, workdge, &lwork, &info);
-  free(workdge);
   ///getQ
   lwork = (int)worktestdor;
-  double* workdor = (double*)malloc(lwork*sizeof(double));
+  double* workdor = (double*)poolAlloc(lwork*sizeof(double), MEM_LAPACK);
   dorgql(&N, &M, &K, Mij, &lda, tau, workdor, &lwork, &info);
   memcpy(Q, Mij, N*M*sizeof(double));
   //getR
   double alpha = 1, beta = 0;
   dgemm((char*)"T", (char*)"N", &M, &M, &N, &alpha, Mij, &N, Mij_ori, &N, &beta, R, &M);
 
-  free(Mij);
-  free(tau);
-  free(workdge);
-  free(workdor);
+  poolFree(Mij);
+  poolFree(tau);
+  poolFree(workdge);
+  poolFree(workdor);
 
 }
 
 void matrixLQ(double* Mij_ori, int M, int N, double* Q, double* L, bool ongpu){
 
   assert(N >= M);
-  double* Mij = (double*)malloc(M*N*sizeof(double));
+  double* Mij = (double*)poolAlloc(M*N*sizeof(double), MEM_LAPACK);
   memcpy(Mij, Mij_ori, M*N*sizeof(double));
-  double* tau = (double*)malloc(M*sizeof(double));
+  double* tau = (double*)poolAlloc(M*sizeof(double), MEM_LAPACK);
   int lda = N;
   int lwork = -1;
   double worktestdge;
@@ -237,28 +265,28 @@ void matrixLQ(double* Mij_ori, int M, int N, double* Q, double* L, bool ongpu){
   dgeqrf(&N, &M, Mij, &lda, tau, &worktestdge, &lwork, &info);
   dorgqr(&N, &M, &K, Mij, &lda, tau, &worktestdor, &lwork, &info);
   lwork = (int)worktestdge;
-  double* workdge = (double*)malloc(lwork*sizeof(double));
+  double* workdge = (double*)poolAlloc(lwork*sizeof(double), MEM_LAPACK);
   dgeqrf(&N, &M, Mij, &lda, tau, workdge, &lwork, &info);
   //getQ
   lwork = (int)worktestdor;
-  double* workdor = (double*)malloc(lwork*sizeof(double));
+  double* workdor = (double*)poolAlloc(lwork*sizeof(double), MEM_LAPACK);
   dorgqr(&N, &M, &K, Mij, &lda, tau, workdor, &lwork, &info);
   memcpy(Q, Mij, N*M*sizeof(double));
   //getR
   double alpha = 1, beta = 0;
   dgemm((char*)"T", (char*)"N", &M, &M, &N, &alpha, Mij, &N, Mij_ori, &N, &beta, L, &M);
 
-  free(Mij);
-  free(tau);
-  free(workdge);
-  free(workdor);
+  poolFree(Mij);
+  poolFree(tau);
+  poolFree(workdge);
+  poolFree(workdor);
 }
 
 void matrixQL(double* Mij_ori, int M, int N, double* Q, double* R, bool ongpu){
   assert(M >= N);
-  double* Mij = (double*)malloc(N*M*sizeof(double));
+  double* Mij = (double*)poolAlloc(N*M*sizeof(double), MEM_LAPACK);
   memcpy(Mij, Mij_ori, N*M*sizeof(double));
-  double* tau = (double*)malloc(M*sizeof(double));
+  double* tau = (double*)poolAlloc(M*sizeof(double), MEM_LAPACK);
   int lda = N;
   int lwork = -1;
   double worktestdge;
@@ -268,25 +296,25 @@ void matrixQL(double* Mij_ori, int M, int N, double* Q, double* R, bool ongpu){
   dgerqf(&N, &M, Mij, &lda, tau, &worktestdge, &lwork, &info);
   dorgrq(&N, &M, &K, Mij, &lda, tau, &worktestdor, &lwork, &info);
   lwork = (int)worktestdge;
-  double* workdge = (double*)malloc(lwork*sizeof(double));
+  double* workdge = (double*)poolAlloc(lwork*sizeof(double), MEM_LAPACK);
   dgerqf(&N, &M, Mij, &lda, tau, workdge, &lwork, &info);
   //getQ
   lwork = (int)worktestdor;
-  double* workdor = (double*)malloc(lwork*sizeof(double));
+  double* workdor = (double*)poolAlloc(lwork*sizeof(double), MEM_LAPACK);
   dorgrq(&N, &M, &K, Mij, &lda, tau, workdor, &lwork, &info);
   memcpy(Q, Mij, N*M*sizeof(double));
   //getR
   double alpha = 1, beta = 0;
   dgemm((char*)"N", (char*)"T", &N, &N, &M, &alpha, Mij_ori, &N, Mij, &N, &beta, R, &N);
 
-  free(Mij);
-  free(tau);
-  free(workdge);
-  free(workdor);
+  poolFree(Mij);
+  poolFree(tau);
+  poolFree(workdge);
+  poolFree(workdor);
 }
 
 void matrixSVD(double* Mij_ori, int M, int N, double* U, double* S, double* vT, bool ongpu){
-	double* Mij = (double*)malloc(M * N * sizeof(double));
+	double* Mij = (double*)poolAlloc(M * N * sizeof(double), MEM_LAPACK);
 	memcpy(Mij, Mij_ori, M * N * sizeof(double));
 	int min = std::min(M, N);
 	int ldA = N, ldu = N, ldvT = min;
@@ -300,15 +328,15 @@ void matrixSVD(double* Mij_ori, int M, int N, double* U, double* S, double* vT,
     throw std::runtime_error(exception_msg(err.str()));
   }
 	lwork = (int)worktest;
-	double *work = (double*)malloc(lwork*sizeof(double));
+	double *work = (double*)poolAlloc(lwork*sizeof(double), MEM_LAPACK);
 	dgesvd((char*)"S", (char*)"S", &N, &M, Mij, &ldA, S, vT, &ldu, U, &ldvT, work, &lwork, &info);
   if(info != 0){
     std::ostringstream err;
     err<<"Error in Lapack function 'dgesvd': Lapack INFO = "<<info;
     throw std::runtime_error(exception_msg(err.str()));
   }
-	free(work);
-	free(Mij);
+	poolFree(work);
+	poolFree(Mij);
 }
 
 void matrixInv(double* A, int N, bool diag, bool ongpu){
@@ -317,7 +345,7 @@ void matrixInv(double* A, int N, bool diag, bool ongpu){
       A[i] = A[i] == 0 ? 0 : 1.0/A[i];
     return;
   }
-  int *ipiv = (int*)malloc((N+1)*sizeof(int));
+  int *ipiv = (int*)poolAlloc((N+1)*sizeof(int), MEM_LAPACK);
   int info;
   dgetrf(&N, &N, A, &N, ipiv, &info);
   if(info != 0){
@@ -334,30 +362,32 @@ void matrixInv(double* A, int N, bool diag, bool ongpu){
     throw std::runtime_error(exception_msg(err.str()));
   }
   lwork = (int)worktest;
-  double *work = (double*)malloc(lwork * sizeof(double));
+  double *work = (double*)poolAlloc(lwork * sizeof(double), MEM_LAPACK);
   dgetri(&N, A, &N, ipiv, work, &lwork, &info);
   if(info != 0){
     std::ostringstream err;
     err<<"Error in Lapack function 'dgetri': Lapack INFO = "<<info;
     throw std::runtime_error(exception_msg(err.str()));
   }
-  free(ipiv);
-  free(work);
+  poolFree(ipiv);
+  poolFree(work);
 }
 
 
 void setTranspose(double* A, size_t M, size_t N, double* AT, bool ongpu, bool ongpuT){
-  for(size_t i = 0; i < M; i++)
-    for(size_t j = 0; j < N; j++)
-      AT[j * M + i] = A[i * N + j];
+  std::vector<size_t> dims(2), acc(2), accT(2);
+  dims[0] = M; dims[1] = N;
+  acc[0] = N; acc[1] = 1;
+  accT[0] = 1; accT[1] = M;
+  permuteElem(A, AT, dims, acc, accT);
 }
 
 void setTranspose(double* A, size_t M, size_t N, bool ongpu){
   size_t memsize = M * N * sizeof(double);
-  double *AT = (double*)malloc(memsize);
+  double *AT = (double*)poolAlloc(memsize, MEM_LAPACK);
   setTranspose(A, M, N, AT, ongpu, ongpu);
   memcpy(A, AT, memsize);
-  free(AT);
+  poolFree(AT);
 }
 
 void setCTranspose(double* A, size_t M, size_t N, double* AT, bool ongpu, bool ongpuT){
@@ -419,11 +449,11 @@ bool lanczosEV(double* A, double* psi, size_t dim, size_t& max_iter, double err_
   double beta = 1;
   int inc = 1;
   size_t M = max_iter;
-  double *Vm = (double*)malloc((M + 1) * N * sizeof(double));
-  double *As = (double*)malloc(M * sizeof(double));
-  double *Bs = (double*)malloc(M * sizeof(double));
-  double *d = (double*)malloc(M * sizeof(double));
-  double *e = (double*)malloc(M * sizeof(double));
+  double *Vm = (double*)poolAlloc((M + 1) * N * sizeof(double), MEM_LAPACK);
+  double *As = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
+  double *Bs = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
+  double *d = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
+  double *e = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
   int it = 0;
   memcpy(Vm, psi, N * sizeof(double));
   vectorScal(1 / vectorNorm(psi, N, 1, false), Vm, N, false);
@@ -474,8 +504,8 @@ bool lanczosEV(double* A, double* psi, size_t dim, size_t& max_iter, double err_
   if(it > 1){
     memcpy(d, As, it * sizeof(double));
     memcpy(e, Bs, it * sizeof(double));
-    double* z = (double*)malloc(it * it * sizeof(double));
-    double* work = (double*)malloc(4 * it * sizeof(double));
+    double* z = (double*)poolAlloc(it * it * sizeof(double), MEM_LAPACK);
+    double* work = (double*)poolAlloc(4 * it * sizeof(double), MEM_LAPACK);
     int info;
     dstev((char*)"V", &it, d, e, z, &it, work, &info);
     if(info != 0){
@@ -490,13 +520,13 @@ bool lanczosEV(double* A, double* psi, size_t dim, size_t& max_iter, double err_
     }
     max_iter = it;
     eigVal = d[0];
-    free(z), free(work);
+    poolFree(z), poolFree(work);
   }
   else{
     max_iter = 1;
     eigVal = 0;
   }
-  free(Vm), free(As), free(Bs), free(d), free(e);
+  poolFree(Vm), poolFree(As), poolFree(Bs), poolFree(d), poolFree(e);
   return converged;
 }
 
@@ -514,11 +544,11 @@ bool lanczosEVL(double* A, double* psi, size_t dim, size_t& max_iter, double err
   double beta = 1;
   int inc = 1;
   size_t M = max_iter;
-  double *Vm = (double*)malloc((M + 1) * N * sizeof(double));
-  double *As = (double*)malloc(M * sizeof(double));
-  double *Bs = (double*)malloc(M * sizeof(double));
-  double *d = (double*)malloc(M * sizeof(double));
-  double *e = (double*)malloc(M * sizeof(double));
+  double *Vm = (double*)poolAlloc((M + 1) * N * sizeof(double), MEM_LAPACK);
+  double *As = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
+  double *Bs = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
+  double *d = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
+  double *e = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
   int it = 0;
   memcpy(Vm, psi, N * sizeof(double));
   vectorScal(1 / vectorNorm(psi, N, 1, false), Vm, N, false);
@@ -569,8 +599,8 @@ bool lanczosEVL(double* A, double* psi, size_t dim, size_t& max_iter, double err
   if(it > 1){
     memcpy(d, As, it * sizeof(double));
     memcpy(e, Bs, it * sizeof(double));
-    double* z = (double*)malloc(it * it * sizeof(double));
-    double* work = (double*)malloc(4 * it * sizeof(double));
+    double* z = (double*)poolAlloc(it * it * sizeof(double), MEM_LAPACK);
+    double* work = (double*)poolAlloc(4 * it * sizeof(double), MEM_LAPACK);
     int info;
     dstev((char*)"V", &it, d, e, z, &it, work, &info);
     if(info != 0){
@@ -585,26 +615,26 @@ bool lanczosEVL(double* A, double* psi, size_t dim, size_t& max_iter, double err
     }
     max_iter = it;
     eigVal = d[0];
-    free(z), free(work);
+    poolFree(z), poolFree(work);
   }
   else{
     max_iter = 1;
     eigVal = 0;
   }
-  free(Vm), free(As), free(Bs), free(d), free(e);
+  poolFree(Vm), poolFree(As), poolFree(Bs), poolFree(d), poolFree(e);
   return converged;
 }
 
 /***** Complex version *****/
 void matrixSVD(std::complex<double>* Mij_ori, int M, int N, std::complex<double>* U, double *S, std::complex<double>* vT, bool ongpu){
-	std::complex<double>* Mij = (std::complex<double>*)malloc(M * N * sizeof(std::complex<double>));
+	std::complex<double>* Mij = (std::complex<double>*)poolAlloc(M * N * sizeof(std::complex<double>), MEM_LAPACK);
 	memcpy(Mij, Mij_ori, M * N * sizeof(std::complex<double>));
 	int min = std::min(M, N);
 	int ldA = N, ldu = N, ldvT = min;
 	int lwork = -1;
   std::complex<double> worktest;
 	int info;
-  double *rwork = (double*) malloc(std::max(1, 5 * min) * sizeof(double));
+  double *rwork = (double*) poolAlloc(std::max(1, 5 * min) * sizeof(double), MEM_LAPACK);
 	zgesvd((char*)"S", (char*)"S", &N, &M, Mij, &ldA, S, vT, &ldu, U, &ldvT, &worktest, &lwork, rwork, &info);
   if(info != 0){
     std::ostringstream err;
@@ -612,23 +642,23 @@ void matrixSVD(std::complex<double>* Mij_ori, int M, int N, std::complex<double>
     throw std::runtime_error(exception_msg(err.str()));
   }
 	lwork = (int)(worktest.real());
-	std::complex<double> *work = (std::complex<double>*)malloc(lwork*sizeof(std::complex<double>));
+	std::complex<double> *work = (std::complex<double>*)poolAlloc(lwork*sizeof(std::complex<double>), MEM_LAPACK);
 	zgesvd((char*)"S", (char*)"S", &N, &M, Mij, &ldA, S, vT, &ldu, U, &ldvT, work, &lwork, rwork, &info);
   if(info != 0){
     std::ostringstream err;
     err<<"Error in Lapack function 'zgesvd': Lapack INFO = "<<info;
     throw std::runtime_error(exception_msg(err.str()));
   }
-  free(rwork);
-	free(work);
-	free(Mij);
+  poolFree(rwork);
+	poolFree(work);
+	poolFree(Mij);
 }
 void matrixSVD(std::complex<double>* Mij_ori, int M, int N, std::complex<double>* U, std::complex<double>* S_ori, std::complex<double>* vT, bool ongpu){
 	int min = std::min(M, N);
-  double* S = (double*)malloc(min * sizeof(double));
+  double* S = (double*)poolAlloc(min * sizeof(double), MEM_LAPACK);
   matrixSVD(Mij_ori, M, N, U, S, vT, ongpu);
   elemCast(S_ori, S, min, false, false);
-  free(S);
+  poolFree(S);
 }
 
 void matrixInv(std::complex<double>* A, int N, bool diag, bool ongpu){
@@ -637,7 +667,7 @@ void matrixInv(std::complex<double>* A, int N, bool diag, bool ongpu){
       A[i] = std::abs(A[i]) == 0 ? 0.0 : 1.0/A[i];
     return;
   }
-  int *ipiv = (int*)malloc((N+1) * sizeof(int));
+  int *ipiv = (int*)poolAlloc((N+1) * sizeof(int), MEM_LAPACK);
   int info;
   zgetrf(&N, &N, A, &N, ipiv, &info);
   if(info != 0){
@@ -654,15 +684,15 @@ void matrixInv(std::complex<double>* A, int N, bool diag, bool ongpu){
     throw std::runtime_error(exception_msg(err.str()));
   }
 	lwork = (int)(worktest.real());
-  std::complex<double> *work = (std::complex<double>*)malloc(lwork * sizeof(std::complex<double>));
+  std::complex<double> *work = (std::complex<double>*)poolAlloc(lwork * sizeof(std::complex<double>), MEM_LAPACK);
   zgetri(&N, A, &N, ipiv, work, &lwork, &info);
   if(info != 0){
     std::ostringstream err;
     err<<"Error in Lapack function 'dgetri': Lapack INFO = "<<info;
     throw std::runtime_error(exception_msg(err.str()));
   }
-  free(ipiv);
-  free(work);
+  poolFree(ipiv);
+  poolFree(work);
 }
 
 double vectorNorm(std::complex<double>* X, size_t N, int inc, bool ongpu){
@@ -698,6 +728,12 @@ void matrixMul(std::complex<double>* A, std::complex<double>* B, int M, int N, i
 	zgemm((char*)"N", (char*)"N", &N, &M, &K, &alpha, B, &N, A, &K, &beta, C, &N);
 }
 
+void matrixMul(bool transA, bool transB, const std::complex<double>* A, const std::complex<double>* B, int M, int N, int K, std::complex<double> alpha, std::complex<double> beta, std::complex<double>* C, bool, bool, bool){
+  int ldA = transA ? M : K;
+  int ldB = transB ? K : N;
+  zgemm(transB ? "T" : "N", transA ? "T" : "N", &N, &M, &K, &alpha, B, &ldB, A, &ldA, &beta, C, &N);
+}
+
 void vectorAdd(std::complex<double>* Y, double* X, size_t N, bool y_ongpu, bool x_ongpu){	// Y = Y + X
   for(size_t i = 0; i < N; i++)
     Y[i] += X[i];
@@ -780,34 +816,36 @@ void vectorExp(const std::complex<double>& a, std::complex<double>* X, size_t N,
 
 void orthoRandomize(std::complex<double> *elem, int M, int N, bool ongpu){
 	int eleNum = M*N;
-  std::complex<double> *random = (std::complex<double>*)malloc(eleNum * sizeof(std::complex<double>));
+  std::complex<double> *random = (std::complex<double>*)poolAlloc(eleNum * sizeof(std::complex<double>), MEM_LAPACK);
 	elemRand(random, M * N, false);
 	int min = M < N ? M : N;
-	double *S = (double*)malloc(min*sizeof(double));
+	double *S = (double*)poolAlloc(min*sizeof(double), MEM_LAPACK);
 	if(M <= N){
-    std::complex<double> *U = (std::complex<double>*)malloc(M * min * sizeof(std::complex<double>));
+    std::complex<double> *U = (std::complex<double>*)poolAlloc(M * min * sizeof(std::complex<double>), MEM_LAPACK);
 		matrixSVD(random, M, N, U, S, elem, false);
-		free(U);
+		poolFree(U);
 	}
 	else{
-		std::complex<double> *VT = (std::complex<double>*)malloc(min * N * sizeof(std::complex<double>));
+		std::complex<double> *VT = (std::complex<double>*)poolAlloc(min * N * sizeof(std::complex<double>), MEM_LAPACK);
 		matrixSVD(random, M, N, elem, S, VT, false);
-		free(VT);
+		poolFree(VT);
 	}
-	free(random);
-	free(S);
+	poolFree(random);
+	poolFree(S);
 }
 void setTranspose(std::complex<double>* A, size_t M, size_t N, std::complex<double>* AT, bool ongpu, bool ongpuT){
-	for(size_t i = 0; i < M; i++)
-		for(size_t j = 0; j < N; j++)
-			AT[j * M + i] = A[i * N + j];
+  std::vector<size_t> dims(2), acc(2), accT(2);
+  dims[0] = M; dims[1] = N;
+  acc[0] = N; acc[1] = 1;
+  accT[0] = 1; accT[1] = M;
+  permuteElem(A, AT, dims, acc, accT);
 }
 void setTranspose(std::complex<double>* A, size_t M, size_t N, bool ongpu){
   size_t memsize = M * N * sizeof(std::complex<double>);
-  std::complex<double> *AT = (std::complex<double>*)malloc(memsize);
+  std::complex<double> *AT = (std::complex<double>*)poolAlloc(memsize, MEM_LAPACK);
   setTranspose(A, M, N, AT, ongpu, ongpu);
   memcpy(A, AT, memsize);
-  free(AT);
+  poolFree(AT);
 }
 
 void setCTranspose(std::complex<double>* A, size_t M, size_t N, std::complex<double> *AT, bool ongpu, bool ongpuT){
@@ -817,21 +855,21 @@ void setCTranspose(std::complex<double>* A, size_t M, size_t N, std::complex<dou
 }
 void setCTranspose(std::complex<double>* A, size_t M, size_t N, bool ongpu){
   size_t memsize = M * N * sizeof(std::complex<double>);
-  std::complex<double> *AT = (std::complex<double>*)malloc(memsize);
+  std::complex<double> *AT = (std::complex<double>*)poolAlloc(memsize, MEM_LAPACK);
   setCTranspose(A, M, N, AT, ongpu, ongpu);
   memcpy(A, AT, memsize);
-  free(AT);
+  poolFree(AT);
 }
 
 void eigDecompose(std::complex<double>* Kij, int N, std::complex<double>* Eig, std::complex<double>* EigVec, bool ongpu){
   size_t memsize = N * N * sizeof(std::complex<double>);
-  std::complex<double> *A = (std::complex<double>*) malloc(memsize);
+  std::complex<double> *A = (std::complex<double>*) poolAlloc(memsize, MEM_LAPACK);
   memcpy(A, Kij, memsize);
   int ldA = N;
   int ldvl = 1;
   int ldvr = N;
   int lwork = -1;
-  double *rwork = (double*) malloc(2 * N * sizeof(double));
+  double *rwork = (double*) poolAlloc(2 * N * sizeof(double), MEM_LAPACK);
   std::complex<double> worktest;
   int info;
   zgeev((char*)"N", (char*)"V", &N, A, &ldA, Eig, NULL, &ldvl, EigVec, &ldvr, &worktest, &lwork, rwork, &info);
@@ -841,16 +879,16 @@ void eigDecompose(std::complex<double>* Kij, int N, std::complex<double>* Eig, s
     throw std::runtime_error(exception_msg(err.str()));
   }
   lwork = (int)worktest.real();
-  std::complex<double>* work = (std::complex<double>*)malloc(sizeof(std::complex<double>)*lwork);
+  std::complex<double>* work = (std::complex<double>*)poolAlloc(sizeof(std::complex<double>)*lwork, MEM_LAPACK);
   zgeev((char*)"N", (char*)"V", &N, A, &ldA, Eig, NULL, &ldvl, EigVec, &ldvr, work, &lwork, rwork, &info);
   if(info != 0){
     std::ostringstream err;
     err<<"Error in Lapack function 'zgeev': Lapack INFO = "<<info;
     throw std::runtime_error(exception_msg(err.str()));
   }
-  free(work);
-  free(rwork);
-  free(A);
+  poolFree(work);
+  poolFree(rwork);
+  poolFree(A);
 }
 
 void eigSyDecompose(std::complex<double>* Kij, int N, double* Eig, std::complex<double>* EigVec, bool ongpu){
@@ -859,7 +897,7 @@ void eigSyDecompose(std::complex<double>* Kij, int N, double* Eig, std::complex<
   int ldA = N;
   int lwork = -1;
   std::complex<double> worktest;
-  double* rwork = (double*) malloc((3*N+1) * sizeof(double));
+  double* rwork = (double*) poolAlloc((3*N+1) * sizeof(double), MEM_LAPACK);
   int info;
   zheev((char*)"V", (char*)"U", &N, EigVec, &ldA, Eig, &worktest, &lwork, rwork, &info);
   if(info != 0){
@@ -868,15 +906,15 @@ void eigSyDecompose(std::complex<double>* Kij, int N, double* Eig, std::complex<
     throw std::runtime_error(exception_msg(err.str()));
   }
   lwork = (int)worktest.real();
-  std::complex<double>* work= (std::complex<double>*)malloc(sizeof(std::complex<double>)*lwork);
+  std::complex<double>* work= (std::complex<double>*)poolAlloc(sizeof(std::complex<double>)*lwork, MEM_LAPACK);
   zheev((char*)"V", (char*)"U", &N, EigVec, &ldA, Eig, work, &lwork, rwork, &info);
   if(info != 0){
     std::ostringstream err;
     err<<"Error in Lapack function 'zheev': Lapack INFO = "<<info;
     throw std::runtime_error(exception_msg(err.str()));
   }
-  free(work);
-  free(rwork);
+  poolFree(work);
+  poolFree(rwork);
 }
 
 void setConjugate(std::complex<double> *A, size_t N, bool ongpu){
@@ -908,11 +946,11 @@ bool lanczosEV(std::complex<double>* A, std::complex<double>* psi, size_t dim, s
   double beta = 1;
   int inc = 1;
   size_t M = max_iter;
-  std::complex<double> *Vm = (std::complex<double>*)malloc((M + 1) * N * sizeof(std::complex<double>));
-  double *As = (double*)malloc(M * sizeof(double));
-  double *Bs = (double*)malloc(M * sizeof(double));
-  double *d = (double*)malloc(M * sizeof(double));
-  double *e = (double*)malloc(M * sizeof(double));
+  std::complex<double> *Vm = (std::complex<double>*)poolAlloc((M + 1) * N * sizeof(std::complex<double>), MEM_LAPACK);
+  double *As = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
+  double *Bs = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
+  double *d = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
+  double *e = (double*)poolAlloc(M * sizeof(double), MEM_LAPACK);
   int it = 0;
   memcpy(Vm, psi, N * sizeof(std::complex<double>));
   vectorScal(1 / vectorNorm(psi, N, 1, false), Vm, N, false);
@@ -963,8 +1001,8 @@ bool lanczosEV(std::complex<double>* A, std::complex<double>* psi, size_t dim, s
   if(it > 1){
     memcpy(d, As, it * sizeof(double));
     memcpy(e, Bs, it * sizeof(double));
-    double* z = (double*)malloc(it * it * sizeof(double));
-    double* work = (double*)malloc(4 * it * sizeof(double));
+    double* z = (double*)poolAlloc(it * it * sizeof(double), MEM_LAPACK);
+    double* work = (double*)poolAlloc(4 * it * sizeof(double), MEM_LAPACK);
     int info;
     dstev((char*)"V", &it, d, e, z, &it, work, &info);
     if(info != 0){
@@ -980,20 +1018,20 @@ bool lanczosEV(std::complex<double>* A, std::complex<double>* psi, size_t dim, s
     }
     max_iter = it;
     eigVal = d[0];
-    free(z), free(work);
+    poolFree(z), poolFree(work);
   }
   else{
     max_iter = 1;
     eigVal = 0;
   }
-  free(Vm), free(As), free(Bs), free(d), free(e);
+  poolFree(Vm), poolFree(As), poolFree(Bs), poolFree(d), poolFree(e);
   return converged;
 }
 
 void matrixQR(std::complex<double>* Mij_ori, int M, int N, std::complex<double>* Q, std::complex<double>* R, bool ongpu){
-  std::complex<double>* Mij = (std::complex<double>*)malloc(N*M*sizeof(std::complex<double>));
+  std::complex<double>* Mij = (std::complex<double>*)poolAlloc(N*M*sizeof(std::complex<double>), MEM_LAPACK);
   memcpy(Mij, Mij_ori, N*M*sizeof(std::complex<double>));
-  std::complex<double>* tau = (std::complex<double>*)malloc(M*sizeof(std::complex<double>));
+  std::complex<double>* tau = (std::complex<double>*)poolAlloc(M*sizeof(std::complex<double>), MEM_LAPACK);
   int lda = N;
   int lwork = -1;
   std::complex<double> worktestzge;
@@ -1003,28 +1041,28 @@ void matrixQR(std::complex<double>* Mij_ori, int M, int N, std::complex<double>*
   zgelqf(&N, &M, Mij, &lda, tau, &worktestzge, &lwork, &info);
   zunglq(&N, &M, &K, Mij, &lda, tau, &worktestzun, &lwork, &info);
   lwork = (int)worktestzge.real();
-  std::complex<double>* workzge = (std::complex<double>*)malloc(lwork*sizeof(std::complex<double>));
+  std::complex<double>* workzge = (std::complex<double>*)poolAlloc(lwork*sizeof(std::complex<double>), MEM_LAPACK);
   zgelqf(&N, &M, Mij, &lda, tau, workzge, &lwork, &info);
   //getQ
   lwork = (int)worktestzun.real();
-  std::complex<double>* workzun = (std::complex<double>*)malloc(lwork*sizeof(std::complex<double>));
+  std::complex<double>* workzun = (std::complex<double>*)poolAlloc(lwork*sizeof(std::complex<double>), MEM_LAPACK);
   zunglq(&N, &M, &K, Mij, &lda, tau, workzun, &lwork, &info);
   memcpy(Q, Mij, N*M*sizeof(std::complex<double>));
   //getR
   std::complex<double> alpha(1.0, 0.0), beta(0.0, 0.0);
   zgemm((char*)"N", (char*)"C", &N, &N, &M, &alpha, Mij_ori, &N, Mij, &N, &beta, R, &N);
 
-  free(Mij);
-  free(tau);
-  free(workzge);
-  free(workzun);
+  poolFree(Mij);
+  poolFree(tau);
+  poolFree(workzge);
+  poolFree(workzun);
 }
 
 void matrixRQ(std::complex<double>* Mij_ori, int M, int N, std::complex<double>* Q, std::complex<double>* R, bool ongpu){
 
-  std::complex<double>* Mij = (std::complex<double>*)malloc(M*N*sizeof(std::complex<double>));
+  std::complex<double>* Mij = (std::complex<double>*)poolAlloc(M*N*sizeof(std::complex<double>), MEM_LAPACK);
   memcpy(Mij, Mij_ori, M*N*sizeof(std::complex<double>));
-  std::complex<double>* tau = (std::complex<double>*)malloc(M*sizeof(std::complex<double>));
+  std::complex<double>* tau = (std::complex<double>*)poolAlloc(M*sizeof(std::complex<double>), MEM_LAPACK);
   int lda = N;
   int lwork = -1;
   std::complex<double> worktestzge;
@@ -1034,29 +1072,29 @@ void matrixRQ(std::complex<double>* Mij_ori, int M, int N, std::complex<double>*
   zgeqlf(&N, &M, Mij, &lda, tau, &worktestzge, &lwork, &info);
   zungql(&N, &M, &K, Mij, &lda, tau, &worktestzun, &lwork, &info);
   lwork = (int)worktestzge.real();
-  std::complex<double>* workzge = (std::complex<double>*)malloc(lwork*sizeof(std::complex<double>));
+  std::complex<double>* workzge = (std::complex<double>*)poolAlloc(lwork*sizeof(std::complex<double>), MEM_LAPACK);
   zgeqlf(&N, &M, Mij, &lda, tau, workzge, &lwork, &info);
   //getQ
   lwork = (int)worktestzun.real();
-  std::complex<double>* workzun = (std::complex<double>*)malloc(lwork*sizeof(std::complex<double>));
+  std::complex<double>* workzun = (std::complex<double>*)poolAlloc(lwork*sizeof(std::complex<double>), MEM_LAPACK);
   zungql(&N, &M, &K, Mij, &lda, tau, workzun, &lwork, &info);
   memcpy(Q, Mij, N*M*sizeof(std::complex<double>));
   //getR
   std::complex<double> alpha (1.0, 0.0), beta (0.0, 0.0);
   zgemm((char*)"C", (char*)"N", &M, &M, &N, &alpha, Mij, &N, Mij_ori, &N, &beta, R, &M);
 
-  free(Mij);
-  free(tau);
-  free(workzge);
-  free(workzun);
+  poolFree(Mij);
+  poolFree(tau);
+  poolFree(workzge);
+  poolFree(workzun);
 
 }
 
 void matrixLQ(std::complex<double>* Mij_ori, int M, int N, std::complex<double>* Q, std::complex<double>* L, bool ongpu){
 
-  std::complex<double>* Mij = (std::complex<double>*)malloc(M*N*sizeof(std::complex<double>));
+  std::complex<double>* Mij = (std::complex<double>*)poolAlloc(M*N*sizeof(std::complex<double>), MEM_LAPACK);
   memcpy(Mij, Mij_ori, M*N*sizeof(std::complex<double>));
-  std::complex<double>* tau = (std::complex<double>*)malloc(M*sizeof(std::complex<double>));
+  std::complex<double>* tau = (std::complex<double>*)poolAlloc(M*sizeof(std::complex<double>), MEM_LAPACK);
   int lda = N;
   int lwork = -1;
   std::complex<double> worktestzge;
@@ -1066,28 +1104,28 @@ void matrixLQ(std::complex<double>* Mij_ori, int M, int N, std::complex<double>*
   zgeqrf(&N, &M, Mij, &lda, tau, &worktestzge, &lwork, &info);
   zungqr(&N, &M, &K, Mij, &lda, tau, &worktestzun, &lwork, &info);
   lwork = (int)worktestzge.real();
-  std::complex<double>* workzge = (std::complex<double>*)malloc(lwork*sizeof(std::complex<double>));
+  std::complex<double>* workzge = (std::complex<double>*)poolAlloc(lwork*sizeof(std::complex<double>), MEM_LAPACK);
   zgeqrf(&N, &M, Mij, &lda, tau, workzge, &lwork, &info);
   //getQ
   lwork = (int)worktestzun.real();
-  std::complex<double>* workzun = (std::complex<double>*)malloc(lwork*sizeof(std::complex<double>));
+  std::complex<double>* workzun = (std::complex<double>*)poolAlloc(lwork*sizeof(std::complex<double>), MEM_LAPACK);
   zungqr(&N, &M, &K, Mij, &lda, tau, workzun, &lwork, &info);
   memcpy(Q, Mij, N*M*sizeof(std::complex<double>));
   //getR
   std::complex<double> alpha (1.0, 0.0), beta (0.0, 0.0);
   zgemm((char*)"C", (char*)"N", &M, &M, &N, &alpha, Mij, &N, Mij_ori, &N, &beta, L, &M);
 
-  free(Mij);
-  free(tau);
-  free(workzge);
-  free(workzun);
+  poolFree(Mij);
+  poolFree(tau);
+  poolFree(workzge);
+  poolFree(workzun);
 }
 
 void matrixQL(std::complex<double>* Mij_ori, int M, int N, std::complex<double>* Q, std::complex<double>* L, bool ongpu){
   assert(M >= N);
-  std::complex<double>* Mij = (std::complex<double>*)malloc(N*M*sizeof(std::complex<double>));
+  std::complex<double>* Mij = (std::complex<double>*)poolAlloc(N*M*sizeof(std::complex<double>), MEM_LAPACK);
   memcpy(Mij, Mij_ori, N*M*sizeof(std::complex<double>));
-  std::complex<double>* tau = (std::complex<double>*)malloc(M*sizeof(std::complex<double>));
+  std::complex<double>* tau = (std::complex<double>*)poolAlloc(M*sizeof(std::complex<double>), MEM_LAPACK);
   int lda = N;
   int lwork = -1;
   std::complex<double> worktestzge;
@@ -1097,21 +1135,21 @@ void matrixQL(std::complex<double>* Mij_ori, int M, int N, std::complex<double>*
   zgerqf(&N, &M, Mij, &lda, tau, &worktestzge, &lwork, &info);
   zungrq(&N, &M, &K, Mij, &lda, tau, &worktestzun, &lwork, &info);
   lwork = (int)worktestzge.real();
-  std::complex<double>* workzge = (std::complex<double>*)malloc(lwork*sizeof(std::complex<double>));
+  std::complex<double>* workzge = (std::complex<double>*)poolAlloc(lwork*sizeof(std::complex<double>), MEM_LAPACK);
   zgerqf(&N, &M, Mij, &lda, tau, workzge, &lwork, &info);
   //getQ
   lwork = (int)worktestzun.real();
-  std::complex<double>* workzun = (std::complex<double>*)malloc(lwork*sizeof(std::complex<double>));
+  std::complex<double>* workzun = (std::complex<double>*)poolAlloc(lwork*sizeof(std::complex<double>), MEM_LAPACK);
   zungrq(&N, &M, &K, Mij, &lda, tau, workzun, &lwork, &info);
   memcpy(Q, Mij, N*M*sizeof(std::complex<double>));
   //getR
   std::complex<double> alpha (1.0, 0.0), beta (1.0, 1.0);
   zgemm((char*)"N", (char*)"C", &N, &N, &M, &alpha, Mij_ori, &N, Mij, &N, &beta, L, &N);
 
-  free(Mij);
-  free(tau);
-  free(workzge);
-  free(workzun);
+  poolFree(Mij);
+  poolFree(tau);
+  poolFree(workzge);
+  poolFree(workzun);
 }
 
 };	/* namespace uni10 */
@@ -623,6 +623,36 @@ double vectorNorm(std::complex<double>* X, size_t N, int inc, bool ongpu){
   err<<"GPU version is not ready !!!!";
   throw std::runtime_error(exception_msg(err.str()));
 
+}
+void matrixMul(bool transA, bool transB, const double* A, const double* B, int M, int N, int K, double alpha, double beta, double* C, bool ongpuA, bool ongpuB, bool ongpuC){
+  if(!(ongpuA && ongpuB && ongpuC)){
+    std::ostringstream err;
+    err<<"GPU version is not ready !!!!";
+    throw std::runtime_error(exception_msg(err.str()));
+  }
+  int ldA = transA ? M : K;
+  int ldB = transB ? K : N;
+  cublasHandle_t handle;
+  cublasStatus_t status = cublasCreate(&handle);
+  status = cublasDgemm(handle, transB ? CUBLAS_OP_T : CUBLAS_OP_N, transA ? CUBLAS_OP_T : CUBLAS_OP_N, N, M, K, &alpha, B, ldB, A, ldA, &beta, C, N);
+  assert(status == CUBLAS_STATUS_SUCCESS);
+  cublasDestroy(handle);
+}
+
+int setBlasLocalThreadNum(int num){
+#ifdef MKL
+  return mkl_set_num_threads_local(num);
+#else
+  return 0;
+#endif
+}
+
+void matrixMul(bool transA, bool transB, const std::complex<double>* A, const std::complex<double>* B, int M, int N, int K, std::complex<double> alpha, std::complex<double> beta, std::complex<double>* C, bool ongpuA, bool ongpuB, bool ongpuC){
+
+  std::ostringstream err;
+  err<<"GPU version is not ready !!!!";
+  throw std::runtime_error(exception_msg(err.str()));
+
 }
 void matrixMul(std::complex<double>* A, std::complex<double>* B, int M, int N, int K, std::complex<double>* C, bool ongpuA, bool ongpuB, bool ongpuC){
 
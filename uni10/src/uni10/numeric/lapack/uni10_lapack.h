@@ -51,6 +51,30 @@ enum mmtype{
 };
 void uni10Dgemm(int p, int q, int M, int N, int K, double* A, double* B, double* C, mmtype how);
 void matrixMul(double* A, double* B, int M, int N, int K, double* C, bool ongpuA, bool ongpuB, bool ongpuC);
+/* C = alpha * op(A) * op(B) + beta * C for row-major M x K op(A) and K x N op(B), where op(X) is X^T if transX */
+void matrixMul(bool transA, bool transB, const double* A, const double* B, int M, int N, int K, double alpha, double beta, double* C, bool ongpuA, bool ongpuB, bool ongpuC);
+/* Products of at most this many multiply-adds are cheaper on the batched micro-kernels than through BLAS */
+const size_t UNI10_SMALL_GEMM_FLOPS = 32 * 32 * 32;
+inline bool smallGemm(int M, int N, int K){ return (size_t)M * N * K <= UNI10_SMALL_GEMM_FLOPS; }
+/* C[i] = alpha * op(A[i]) * op(B[i]) + beta * C[i] for count row-major products of the shapes M[i], N[i], K[i].
+ * Host products are grouped by shape, the small ones run on register-blocked kernels and the others on BLAS. */
+void matrixMulBatch(bool transA, bool transB, size_t count, const double* const* A, const double* const* B, const int* M, const int* N, const int* K, double alpha, double beta, double* const* C, bool ongpu);
+/* Sets the BLAS threads of the calling thread and returns the previous setting, 0 means the global one.
+ * MKL keeps the setting per thread. OpenBLAS only has a process-wide one, which is left alone inside tasks of
+ * parallelFor(), so the thread that starts a parallel region sets it for all of its tasks. Other BLAS libraries
+ * keep their own threading and this returns 0. */
+int setBlasLocalThreadNum(int num);
+/* Holds the BLAS threads of the calling thread at num while it lives. A parallelFor() whose tasks call BLAS holds
+ * one around the call, which is the one OpenBLAS follows, and one in every task, which is the one MKL follows. */
+class BlasThreads{
+public:
+  explicit BlasThreads(int num): prev(setBlasLocalThreadNum(num)){}
+  ~BlasThreads(){ setBlasLocalThreadNum(prev); }
+private:
+  BlasThreads(const BlasThreads&);
+  BlasThreads& operator=(const BlasThreads&);
+  int prev;
+};
 void vectorAdd(double* Y, double* X, size_t N, bool y_ongpu, bool x_ongpu);// Y = Y + X
 void vectorScal(double a, double* X, size_t N, bool ongpu);	// X = a * X
 void vectorMul(double* Y, double* X, size_t N, bool y_ongpu, bool x_ongpu); // Y = Y * X, element-wise multiplication;
@@ -87,6 +111,8 @@ void matrixInv(std::complex<double>* A, int N, bool diag, bool ongpu);
 std::complex<double> vectorSum(std::complex<double>* X, size_t N, int inc, bool ongpu);
 double vectorNorm(std::complex<double>* X, size_t N, int inc, bool ongpu);
 void matrixMul(std::complex<double>* A, std::complex<double>* B, int M, int N, int K, std::complex<double>* C, bool ongpuA, bool ongpuB, bool ongpuC);
+void matrixMul(bool transA, bool transB, const std::complex<double>* A, const std::complex<double>* B, int M, int N, int K, std::complex<double> alpha, std::complex<double> beta, std::complex<double>* C, bool ongpuA, bool ongpuB, bool ongpuC);
+void matrixMulBatch(bool transA, bool transB, size_t count, const std::complex<double>* const* A, const std::complex<double>* const* B, const int* M, const int* N, const int* K, std::complex<double> alpha, std::complex<double> beta, std::complex<double>* const* C, bool ongpu);
 void vectorAdd(std::complex<double>* Y, double* X, size_t N, bool y_ongpu, bool x_ongpu);// Y = Y + X
 void vectorAdd(std::complex<double>* Y, std::complex<double>* X, size_t N, bool y_ongpu, bool x_ongpu);// Y = Y + X
 void vectorScal(double a, std::complex<double>* X, size_t N, bool ongpu);	// X = a * X
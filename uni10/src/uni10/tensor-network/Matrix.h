@@ -39,10 +39,13 @@
 #include <stdexcept>
 #include <sstream>
 #include <cstdio>
+#include <memory>
 #include <uni10/data-structure/Block.h>
 
 namespace uni10{
 
+struct _ElemStore;
+
 /// @class Matrix
 /// @brief The Matrix class defines a common matrix
 ///
@@ -61,6 +64,8 @@ public:
     friend void CAddR(Matrix& Ma, const Matrix& Mb);
     friend void RAddC(Matrix& Ma, const Matrix& Mb);
     friend void CAddC(Matrix& Ma, const Matrix& Mb);
+    friend size_t lanczosEigh(rflag tp, Matrix& ori_mat, double& E0, Matrix& psi, size_t max_iter, double err_tol);
+    friend size_t lanczosEigh(cflag tp, Matrix& ori_mat, double& E0, Matrix& psi, size_t max_iter, double err_tol);
 
     /*********************  developping  **********************/
 
@@ -77,15 +82,29 @@ public:
     Real* getHostElem(rflag _tp);
     Complex* getHostElem(cflag _tp);
 
+    /// @brief Returns a writable pointer to the elements
+    ///
+    /// The elements are first unshared from the copies of this Matrix, so that writes through the pointer
+    /// do not show up in them. A const Matrix returns the shared elements through Block::getElem().
+    Real* getElem(rflag _tp = RTYPE);
+    /// @overload
+    Complex* getElem(cflag _tp);
+    using Block::getElem;
+
     bool toGPU();
 
 	  /*********************  OPERATOR **************************/
     /// @brief Assigns to Matrix
     ///
-    /// Assigns the content of \c mat to Matrix, replacing the original content by reallocating new memory
-    /// fit for \c mat.
+    /// Assigns the content of \c mat to Matrix, replacing the original content. A Matrix \c _m shares its
+    /// elements until one of the two matrices modifies them, a Block is copied into new memory.
     /// @param _m Second Matrix
     Matrix& operator=(const Matrix& _m);
+    /// @brief Move assignment
+    ///
+    /// Takes over the elements of \c _m, which is left as an empty Matrix.
+    /// @param _m Second Matrix
+    Matrix& operator=(Matrix&& _m);
     /// @overload
     Matrix& operator=(const Block& _m);
 
@@ -125,8 +144,16 @@ public:
     Matrix(size_t _Rnum, size_t _Cnum, bool _diag=false, bool _ongpu=false);
     Matrix(std::string tp, size_t _Rnum, size_t _Cnum, bool _diag=false, bool _ongpu=false);
     /// @brief Copy constructor
+    ///
+    /// The copy shares the elements of \c _m until one of the two matrices modifies them.
     Matrix(const Matrix& _m);
+    /// @brief Move constructor
+    ///
+    /// Takes over the elements of \c _m, which is left as an empty Matrix.
+    Matrix(Matrix&& _m);
     /// @overload
+    ///
+    /// A Block may be a view into a UniTensor, its elements are always copied.
     Matrix(const Block& _b);
     // #### new
     Matrix(const std::string& fname);
@@ -147,7 +174,8 @@ public:
 
     /// @brief Assign random elements
     ///
-    /// Assigns random values between [0, 1) to  elements of Matrix.
+    /// Assigns random values between [0, 1) to  elements of Matrix. Until setRandomSeed() is called, each thread
+    /// seeds its generator from \c rand() on its first draw.
     void randomize();
 
     /// @brief Assign elements
@@ -381,7 +409,14 @@ public:
 private:
     /*********************  NO TYPE **********************/
 
+    std::shared_ptr<_ElemStore> m_store;  // Owns m_elem or cm_elem, shared with copies until one of them writes
+
     void MelemFree();
+    void MelemOwn(void* buf, size_t memsize);
+    void MelemDetach();
+    void MelemShrink(size_t memsize);
+    void MelemToGPU();
+    void MelemToCPU();
     void setMelemBNULL();
     void init(const Real* _m_elem, const Complex* _cm_elem, bool src_ongpu);
 
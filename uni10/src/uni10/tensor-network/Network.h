@@ -37,12 +37,26 @@
 #include <assert.h>
 #include <vector>
 #include <map>
+#include <set>
 #include <stdexcept>
 #include <sstream>
+#include <utility>
+#include <memory>
 //Bond property
 #include <uni10/data-structure/uni10_struct.h>
 namespace uni10 {
 
+struct _NetworkPlan;
+struct _PlanStep;
+
+//!  Methods to search for the pair-wise contraction order of a Network
+enum orderMethod {
+    ORD_AUTO = 0,   ///<Dynamic programming for small networks, branch and bound for larger ones
+    ORD_DP = 1,     ///<Exact dynamic programming over subsets of tensors
+    ORD_BRANCH = 2, ///<Branch and bound over pair-wise contractions, bounded by a time limit
+    ORD_GREEDY = 3  ///<Contract the cheapest pair first
+};
+
     ///@class Network
     ///@brief The Network class defines the tensor networks
     ///
@@ -67,6 +81,10 @@ namespace uni10 {
     ///
     ///     ORDER: ((((A B) C) E) (D F))
     ///
+    /// Without the `ORDER:` line, a cheap order is searched for when the network is constructed: the cheapest one for
+    /// networks of up to 12 tensors (10 with symmetric bonds), the greedy one for larger networks. It is kept until
+    /// the bonds of the tensors put or the memory limit change. optimizeOrder() searches further within a time limit.
+    ///
     /// @note The `TOUT:` line is required. If the result is a scalar, keep the line `TOUT:` without any labels.
     ///
     /// @see UniTensor
@@ -98,6 +116,9 @@ public:
     ///
     /// Assigns UniTensor \c uT to position \c idx in Network
     /// If \c force is set \c true, replace the tensor without reconstructing the pair-wise contraction sequence.
+    ///
+    /// Network shares the elements of \c UniT instead of copying them, the labels and the name of the network file
+    /// are set on its own handle of the tensor. Modifying \c UniT afterwards leaves the tensor in Network unchanged.
     /// @param idx Position
     /// @param UniT A UniTensor
     /// @param force If set \true, replace without chaning the contraction sequence. Defaults to \c true.
@@ -120,6 +141,9 @@ public:
     ///
     /// Assigns the transpose of \c uT  to the position labeled by \c nameT in Network.
     /// If \c force is set \c true, replace the tensor without reconstructing the pair-wise contraction sequence.
+    ///
+    /// The transpose of a tensor without symmetry is not formed, the contractions read the blocks of \c UniT
+    /// transposed. Tensors with symmetry or fermionic statistics are transposed when put.
     /// @param nameT Name of tensor in Network
     /// @param UniT A UniTensor
     /// @param force If set \true, replace without chaning the contraction sequence. Defaults to \c true.
@@ -133,12 +157,104 @@ public:
     /// @param name Name of the result tensor
     /// @return A UniTensor
     UniTensor launch(const std::string& name="");
+
+    /// @brief Contract Network for each of many tensors
+    ///
+    /// Contracts Network once for each tensor of \c tens put at the position labeled by \c name, and returns the
+    /// results in the same order. The pair-wise contractions which do not involve the tensor \c name are carried out
+    /// once, the ones on the path from \c name to the root of the contraction tree once per tensor, up to
+    /// getThreadNum() tensors at a time. The first tensor of \c tens is left in Network.
+    /// @param name Name of tensor in Network
+    /// @param tens Tensors of the same bonds
+    /// @return The results of the contractions
+    std::vector<UniTensor> launchBatch(const std::string& name, const std::vector<UniTensor>& tens);
+
+    /// @brief Environments of the tensors of Network
+    ///
+    /// The environment of a tensor is the contraction of all the other tensors of Network. Its bonds are the
+    /// out-going bonds of the tensor as in-coming ones, its in-coming bonds as out-going ones, then the bonds of
+    /// \c TOUT on the other tensors, so that contracting it with the tensor gives the result of launch().
+    /// The bonds of \c TOUT on the tensor itself are left out.
+    ///
+    /// All the environments are worked out in one pass: the pair-wise contractions of launch() are kept, and the
+    /// environment of each node of the contraction tree is the environment of its parent contracted with its
+    /// sibling. This takes at most about twice the contractions of one launch().
+    /// @note The swap gates of fermionic tensors are applied to the other tensors only.
+    /// @param names Names of the tensors, all the tensors of Network in the order of the network file if empty
+    /// @return The environments, in the order of \c names
+    std::vector<UniTensor> environments(const std::vector<std::string>& names = std::vector<std::string>());
+
+    /// @brief Compile the contractions of Network
+    ///
+    /// Works out once how Network is contracted: the order of the pair-wise contractions, the permutations packing
+    /// their operands, the blocks to multiply and the layouts of the intermediate tensors. The intermediate tensors
+    /// are kept in a pool of buffers reused from one launch() to the next, so that the following launch() calls only
+    /// copy elements and multiply blocks.
+    ///
+    /// A putTensor() which changes the bonds or the element type of a tensor invalidates the compiled contractions,
+    /// they are compiled again at the next launch(). All the tensors must have been put into Network.
+    /// @note Networks with tensors on the GPU are launched without compiling.
+    void compile();
+
+    /// @brief Contract independent subtrees concurrently
+    ///
+    /// Pair-wise contractions which do not depend on each other, e.g. the two halves of a balanced contraction
+    /// tree, are carried out at the same time by up to \c num threads of the Uni10 thread pool, see setThreadNum().
+    /// The threads of the BLAS are divided among them. A contraction is not started while the intermediate tensors
+    /// held and being computed would exceed \c memBudget bytes, unless no other contraction is running. With
+    /// setCache(), the intermediate tensors to be kept are held until the launch ends and count against the budget.
+    ///
+    /// Small networks and networks compiled by compile() are contracted by the calling thread.
+    /// @param num Number of concurrent contractions, \c 0 for the number of threads of the thread pool, \c 1 to
+    /// contract one pair after another
+    /// @param memBudget Bytes of the intermediate tensors, \c 0 for no limit
+    void setParallel(int num, size_t memBudget = 0);
+
+    /// @brief Keep the intermediate tensors from one launch to the next
+    ///
+    /// launch() keeps the result of each pair-wise contraction, up to \c memCap bytes. putTensor() drops the kept
+    /// tensors depending on the replaced tensor, those on the path from its leaf to the root of the contraction
+    /// tree, and the following launch() contracts these pairs only. When \c memCap is reached, the tensors used
+    /// least recently are dropped first.
+    ///
+    /// Networks compiled by compile() are contracted in full at each launch().
+    /// @param memCap Bytes of the kept intermediate tensors, \c 0 to keep none
+    void setCache(size_t memCap);
+
+    /// @brief Bound the memory held by launch()
+    ///
+    /// Counts the tensors put into Network, the intermediate tensors alive at the same time with the buffers
+    /// packing the operands of each contraction, the cap of setCache() and the result. launch() contracts the
+    /// subtree needing more memory first and frees each intermediate tensor once it is contracted, one pair after
+    /// another. The order searched for a network file without ORDER line and by optimizeOrder() avoids the
+    /// intermediate tensors which do not fit.
+    ///
+    /// When Network cannot be contracted within \c bytes, launch() throws before the first contraction, reporting
+    /// the memory needed and the contraction holding the most.
+    /// @param bytes Memory limit in bytes, \c 0 for no limit
+    void setMemoryLimit(size_t bytes);
+
+    /// @brief Contract Network in slices of its summed bonds
+    ///
+    /// When the intermediate tensors other than the result exceed \c memTarget bytes, launch() splits the index
+    /// range of some bonds which are summed over into pieces, contracts Network once for each combination of the
+    /// pieces, up to getThreadNum() slices at a time, and sums the results in the order of the slices. The bonds
+    /// are picked from the contraction tree: the largest intermediate tensor is halved along its largest summed
+    /// bond until the intermediate tensors of the slices running at the same time fit.
+    /// Only bonds between tensors without symmetry are sliced.
+    ///
+    /// Sliced launches do not use compile() or setCache(). setMemoryLimit() counts the slices running at the same
+    /// time. profile() lists the sliced bonds.
+    /// @param memTarget Bytes of the intermediate tensors of the slices running at the same time, \c 0 to
+    /// contract Network whole
+    void setSlicing(size_t memTarget);
     /// @brief Print out the memory usage
     /// Prints out the memory usage and requirement to contract  Network as:
     /** @code
      ===== Network profile =====
      Memory Requirement: 1032
-     Sum of memory usage: 504
+     Multiply-adds: 240 (dense bonds: 1296)
+     Permutation traffic: 57
      Maximun tensor:
      elemNum: 19
      4 bonds and labels: 1, 2, 3, 4,
@@ -146,8 +262,22 @@ public:
      @endcode
      */
     /// In the above example, to contract Network, the memory requirement is 1032 bytes.
+    /// The pair-wise contractions take 240 multiply-adds summed over the blocks of the symmetry sectors, against 1296
+    /// for the same bonds without symmetry, and 57 elements are moved to permute the operands.
     /// The maximum tensor in Network has 19 elements and has four bonds with labels 1, 2, 3, 4.
     std::string profile(bool print=true);
+
+    /// @brief Search for the cheapest contraction order
+    ///
+    /// Searches for the order of pair-wise contractions which minimizes the number of multiply-adds, summed over the
+    /// blocks of the symmetry sectors of the bonds as in profile(). Among orders of the same cost, the one with the smallest intermediate tensor is
+    /// chosen. The order replaces the one of the network file and is used by the following launch() calls.
+    /// All the tensors must have been put into Network.
+    /// @param method Search method, see \ref orderMethod
+    /// @param timeLimit Time limit in seconds of the branch and bound search, after which the best order found
+    /// so far is taken
+    /// @return The order in the syntax of the `ORDER:` line, e.g. `((A B) (C D))`
+    std::string optimizeOrder(orderMethod method = ORD_AUTO, double timeLimit = 1.0);
     /// @brief Print out Network
     ///
     /// For a newtork described in the following network file,
@@ -217,16 +347,59 @@ private:
     std::vector<int> conOrder;  //contraction order;
     std::vector<int> order; //add order
     std::vector<int> brakets;   //add order
+    bool autoOrder; //no ORDER line, the order is searched for at construction
+    std::vector<Bond> orderBonds;   //bonds of the leafs the automatic order was searched for
+    size_t orderLimit;  //memory limit the automatic order was searched for
     Node* root;
+    std::shared_ptr<_NetworkPlan> plan;   //compiled contractions, NULL when invalidated
+    bool compiled;  //compile() was called, launch() replays the plan
+    int parallelNum;    //concurrent contractions, 0 for the size of the thread pool
+    size_t parallelBudget;  //bytes of intermediate tensors of concurrent contractions, 0 for no limit
+    std::map<Node*, std::pair<UniTensor*, size_t> > cached;  //kept intermediate tensors and the stamp of their last use
+    size_t cacheCap;    //bytes of the kept intermediate tensors, 0 to keep none
+    size_t cacheBytes;
+    size_t cacheStamp;
+    size_t memLimit;    //bytes held by launch(), 0 for no limit
+    std::set<Node*> rightFirst; //contracted before their left sibling, see setMemoryLimit()
+    size_t sliceTarget; //bytes of the intermediate tensors of the slices running at the same time, 0 for no slicing
+    std::map<int, int> slices;  //pieces of each sliced label
     bool load;  //whether or not the network is ready for contraction, construct=> load=true, destruct=>load=false
     int times;  //construction times
     int tot_elem;   //total memory ussage
     int max_elem;   //maximum
     void construct();
+    std::vector< std::pair<int, int> > searchOrder(orderMethod method, double timeLimit);
+    void setOrder(const std::vector< std::pair<int, int> >& path);
     void destruct();
     void matching(Node* sbj, Node* tar);
     void branch(Node* sbj, Node* tar);
+    void bindTensor(size_t idx, const UniTensor& UniT, bool force, bool trans);
     UniTensor merge(Node* nd);
+    UniTensor mergeParallel();
+    const UniTensor* cacheFind(Node* nd);
+    void cacheKeep(Node* nd, const UniTensor& T);
+    void cacheEvict(size_t bytes);
+    void cacheDrop(Node* nd);
+    void cacheClear();
+    void checkMemory();
+    void addSwaps();
+    size_t _live_bytes(Node* nd, bool& complex, Node*& worst, size_t& worstBytes);
+    size_t planBytes() const;
+    void chooseSlices();
+    size_t sliceNum()const;
+    size_t sliceConcurrency()const;
+    size_t slicedBytes(Node* nd, bool complex)const;
+    size_t _slice_bytes(Node* nd, bool complex)const;
+    UniTensor launchSlices();
+    UniTensor mergeGiven(Node* nd, const std::map<Node*, const UniTensor*>& given);
+    const UniTensor& _inside(Node* nd, std::map<Node*, UniTensor>& inside);
+    void _outside(Node* nd, const UniTensor& out, std::map<Node*, UniTensor>& inside, const std::set<Node*>& wanted, std::map<Node*, UniTensor>& envs);
+    static UniTensor sliceBond(const UniTensor& T, int b, size_t lo, size_t hi);
+    int compileStep(Node* nd, _NetworkPlan& plan, UniTensor& T);
+    const Real* planOperand(int opd, int idx, const Real* tp);
+    const Complex* planOperand(int opd, int idx, const Complex* tp);
+    template<typename T> void runStep(const _PlanStep& st, T* elemC);
+    UniTensor replay();
     void clean(Node* nd);
     void fromfile(const std::string& fname);
     void findConOrd(Node* nd);
@@ -236,6 +409,7 @@ private:
     size_t max_tensor_elemNum();
     size_t memory_requirement();
     void _max_tensor_elemNum(Node* nd, size_t& max_num, Node& max_nd) const;
+    void _contract_cost(Node* nd, _ContractCost& total, double& dense) const;
     size_t _sum_of_tensor_elem(Node* nd) const;
     size_t _elem_usage(Node* nd, size_t& usage, size_t& max_usage)const;
 };
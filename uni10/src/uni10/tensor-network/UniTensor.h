@@ -38,6 +38,8 @@
 #include <map>
 #include <set>
 #include <string>
+#include <memory>
+#include <atomic>
 #include <assert.h>
 #include <sstream>
 #include <stdexcept>
@@ -46,11 +48,85 @@
 #include <uni10/data-structure/Bond.h>
 #include <uni10/data-structure/Block.h>
 #include <uni10/tensor-network/Matrix.h>
+#ifdef HDF5
 #include <uni10/hdf5io/uni10_hdf5io.h>
+#endif
 
 /// @brief Uni10 - the Universal Tensor %Network Library
 namespace uni10 {
 
+    /// @brief Sub-block layout of a bond structure
+    ///
+    /// Indexed by the row and column Qidx of a UniTensor, that is the Qnum indices of its incoming and
+    /// outgoing bonds encoded in row-major order. A table never changes once built, so copies and permuted
+    /// tensors of the same bond structure share it.
+    struct _QidxTable{
+        std::vector<int> Qidxs;           // Qidx = RQidx * CQdim + CQidx of every sub-block, ascending
+        std::vector<int> RQidx2Bidx;      // position of the block in UniTensor::blocks, -1 if in no block
+        std::vector<int> CQidx2Bidx;
+        std::vector<size_t> RQidx2Off;    // the row offset starts from the block origin of a qnum
+        std::vector<size_t> CQidx2Off;    // the col offset starts from the block origin of a qnum
+        std::vector<size_t> RQidx2Dim;
+        std::vector<size_t> CQidx2Dim;
+    };
+
+    /// @brief Precomputed permutation of a bond structure
+    ///
+    /// Holds the layout of the permuted tensor and the list of sub-block copies, so that a repeated
+    /// UniTensor::permute() only moves data. Offsets are counted in elements from the start of the tensor
+    /// and do not depend on the element type.
+    struct _PermutePlan{
+        struct Copy{
+            size_t srcOff;
+            size_t desOff;
+            std::vector<size_t> dims;
+            std::vector<size_t> srcAcc;
+            std::vector<size_t> desAcc;
+            double sign;
+        };
+        bool withoutSymmetry;
+        std::vector<Bond> bonds;
+        std::map<Qnum, Block> blocks;
+        int RBondNum;
+        int RQdim;
+        int CQdim;
+        size_t elemNum;
+        std::shared_ptr<const _QidxTable> qidx;
+        std::vector<Copy> copies;     // largest sub-block first
+        /// Runs the copy list, spreading sub-blocks over the Uni10 thread pool for large tensors.
+        void run(const Real* src, Real* des)const;
+        void run(const Complex* src, Complex* des)const;
+    };
+
+    /// @brief Operand layouts of a contraction
+    ///
+    /// A contraction is carried out as per-sector GEMMs of Ta in the form [free A..., contracted...] and Tb in
+    /// the form [contracted..., free B...]. An operand whose native layout is this form, or its transpose, is
+    /// multiplied in place through the BLAS transpose flags. Only the other operands are permuted.
+    struct _ContractLayout{
+        std::vector<int> labelA;      // target labels of Ta, [free A..., contracted...]
+        std::vector<int> labelB;      // target labels of Tb, [contracted..., free B...]
+        std::vector<int> labelC;      // [free A..., free B...]
+        std::vector<Bond> cBonds;
+        int conBond;
+        size_t conDim;                // product of the dimensions of the contracted bonds
+        bool permA;                   // Ta has to be permuted to labelA
+        bool permB;
+        bool transA;                  // Ta is stored as [contracted..., free A...]
+        bool transB;                  // Tb is stored as [free B..., contracted...]
+        bool trivial;                 // no symmetry at all, the row/column split of the operands is free
+    };
+
+    /// @brief One GEMM of a contraction, offsets are counted in elements from the start of each tensor
+    struct _ContractSector{
+        size_t offA;
+        size_t offB;
+        size_t offC;
+        int M;
+        int N;
+        int K;
+    };
+
     ///@class UniTensor
     ///@brief The UniTensor class defines the symmetric tensors
     ///
@@ -303,16 +379,25 @@ namespace uni10 {
         /// @brief Tensor contraction
         ///
         /// Performs tensor contraction, <tt> Ta * Tb </t>. It contracts  the bonds of the same labels in \c Ta
-        /// and \c Tb by making copies and then call function \ref{contract}.
+        /// and \c Tb without modifying them, see contract(const UniTensor&, const UniTensor&).
         friend UniTensor operator*(const UniTensor& Ta, const UniTensor& Tb);
 
         /// @brief Copy content
         ///
-        /// Assigns new content to the UniTensor from \c UniT, replacing the original contents
+        /// Assigns new content to the UniTensor from \c UniT, replacing the original contents. The elements are
+        /// shared with \c UniT until one of the two tensors modifies them.
         /// @param UniT Tensor to be copied
         ///
         UniTensor& operator=(const UniTensor& UniT);
 
+        /// @brief Move content
+        ///
+        /// Takes over the bonds, blocks and elements of \c UniT, which is left as an empty tensor without bonds or
+        /// elements. It can be assigned to again.
+        /// @param UniT Tensor to be moved
+        ///
+        UniTensor& operator=(UniTensor&& UniT);
+
         /// @brief   Perform  element-wise addition and assign
         ///
         /// Performs element-wise addition. The tensor \c Tb to be added must be \ref{similar} to  UniTensor.
@@ -350,8 +435,16 @@ namespace uni10 {
         UniTensor(const std::vector<Bond>& _bonds, int* labels, const std::string& _name = "");
 
         /// @brief Copy constructor
+        ///
+        /// The copy shares the elements of \c UniT. They are copied on the first call which modifies the elements
+        /// of either tensor, e.g. setElem(), putBlock() or operator*=().
         UniTensor(const UniTensor& UniT);
 
+        /// @brief Move constructor
+        ///
+        /// Takes over the bonds, blocks and elements of \c UniT without copying, see operator=(UniTensor&&).
+        UniTensor(UniTensor&& UniT);
+
         /// @brief Create a UniTensor from a file
         ///
         /// @param fname Filename to be read in
@@ -552,7 +645,9 @@ namespace uni10 {
 
         /// @brief Assign elements
         ///
-        /// Assigns random numbers in [0, 1) to the elements.
+        /// Assigns random numbers in [0, 1) to the elements. Until setRandomSeed() is called, each thread seeds its
+        /// generator from \c rand() on its first draw. setRandomSeed() makes them repeatable also when several
+        /// threads randomize tensors.
         void randomize();
 
         /// @brief Assign elements
@@ -620,6 +715,27 @@ namespace uni10 {
         /// permuted back. Defaults to \c false
         friend UniTensor contract(UniTensor& Ta, UniTensor& Tb, bool fast);
 
+        /// @brief Perform contraction of UniTensor without modifying the operands
+        ///
+        /// Performs tensor contraction of \c Ta and \c Tb. Operands which are not laid out for the block
+        /// multiplications are permuted into scratch buffers instead of in place. The buffers belong to the
+        /// calling thread and are reused by its next contraction, so several threads may contract against the
+        /// same tensor at once.
+        /// @param Ta,Tb Tensors to be contracted.
+        friend UniTensor contract(const UniTensor& Ta, const UniTensor& Tb);
+
+        /// @brief Contract into an existing tensor
+        ///
+        /// Performs <tt> Tc = alpha * contract(Ta, Tb) + beta * Tc </tt> without allocating the result. \c Tc
+        /// must have the bonds and labels of <tt> contract(Ta, Tb) </tt>, e.g. be the result of an earlier
+        /// contraction of tensors of the same shape. With \c beta = 0 the elements of \c Tc are not read.
+        /// A Complex \c Tc accepts Real operands.
+        /// @param Ta,Tb Tensors to be contracted.
+        /// @param Tc Output tensor
+        /// @param alpha,beta Scalars of the result and of the previous \c Tc
+        /// @return \c Tc
+        friend UniTensor& contract(const UniTensor& Ta, const UniTensor& Tb, UniTensor& Tc, Real alpha, Real beta);
+
         /// @brief Tensor product of two tensors
         ///
         /// Performs tensor product of \c Ta and \c Tb.
@@ -677,6 +793,24 @@ namespace uni10 {
         /// In the above example, currently there are 30 tensors and total number of existing elements is 2240.
         /// The maximum element number for now is 4295 and the maximum element number of a tensor is 924.
         static std::string profile(bool print = true);
+
+        /// @brief Number of permutations served from the permutation plan cache
+        static size_t permutePlanHits();
+        /// @brief Number of permutations which had to build a new plan
+        static size_t permutePlanMisses();
+        /// @brief Set the number of plans kept in the permutation plan cache
+        ///
+        /// The cache is shared by all tensors and evicts the least recently used plan. Defaults to 256,
+        /// \c 0 disables caching.
+        /// @param size Maximum number of cached plans
+        static void setPermutePlanCacheSize(size_t size);
+        /// @brief Drop all cached permutation plans and reset the hit/miss counters
+        static void clearPermutePlanCache();
+        /// @brief Free the cached buffers which packed contraction operands
+        ///
+        /// Packed operands are taken from the memory pool and given back after each contraction, this
+        /// calls releasePool() for them only, other cached buffers are kept.
+        static void clearContractWorkspace();
         std::vector<_Swap> exSwap(const UniTensor& Tb)const;
         void addGate(const std::vector<_Swap>& swaps);
 
@@ -792,6 +926,10 @@ namespace uni10 {
 
         friend UniTensor contract(rflag tp, UniTensor& Ta, UniTensor& Tb, bool fast);
 
+        friend UniTensor contract(rflag tp, const UniTensor& Ta, const UniTensor& Tb);
+
+        friend UniTensor& contract(rflag tp, const UniTensor& Ta, const UniTensor& Tb, UniTensor& Tc, Real alpha, Real beta);
+
 
         friend UniTensor otimes(rflag tp, const UniTensor& Ta, const UniTensor& Tb);
 
@@ -873,6 +1011,10 @@ namespace uni10 {
 
         friend UniTensor contract(cflag tp, UniTensor& Ta, UniTensor& Tb, bool fast);
 
+        friend UniTensor contract(cflag tp, const UniTensor& Ta, const UniTensor& Tb);
+
+        friend UniTensor& contract(cflag tp, const UniTensor& Ta, const UniTensor& Tb, UniTensor& Tc, Complex alpha, Complex beta);
+
 
         friend UniTensor otimes(cflag tp, const UniTensor& Ta, const UniTensor& Tb);
 
@@ -940,6 +1082,7 @@ namespace uni10 {
         std::string name;
         Real *elem;       //Array of elements
         Complex* c_elem;       //Array of elements
+        std::shared_ptr<_ElemStore> m_store;  //Owns elem or c_elem, shared with copies until one of them writes
         int status; //Check initialization, 1 initialized, 3 initialized with label, 5 initialized with elements
         std::vector<Bond> bonds;
         std::map<Qnum, Block> blocks;
@@ -949,30 +1092,43 @@ namespace uni10 {
         int RQdim;
         int CQdim;
         size_t m_elemNum;
-        std::map<int, Block*> RQidx2Blk;    //Qidx to the Block
-        std::map<int, size_t> QidxEnc;
-        std::map<int, size_t> RQidx2Off;    //the row offset starts from the block origin of a qnum
-        std::map<int, size_t> CQidx2Off;    //the col offset starts from the block origin of a qnum
-        std::map<int, size_t> RQidx2Dim;
-        std::map<int, size_t> CQidx2Dim;
+        std::shared_ptr<const _QidxTable> m_qidx;   //Sub-block layout, shared with copies
+        std::vector<Block*> RQidx2Blk;    //Row Qidx to the Block, NULL if in no block
         bool ongpu;
-        static int COUNTER;
-        static int64_t ELEMNUM;
-        static size_t MAXELEMNUM;
-        static size_t MAXELEMTEN;   //Max number of element of a tensor
+        static std::atomic<int> COUNTER;
+        static std::atomic<int64_t> ELEMNUM;
+        static std::atomic<size_t> MAXELEMNUM;
+        static std::atomic<size_t> MAXELEMTEN;   //Max number of element of a tensor
 
         //Private Functions
         /*********************  NO TYPE **************************/
         void initUniT(int typeID);
+        static void addElemNum(size_t elemNum);
+        void initLayout(const _PermutePlan& plan);
+        const _QidxTable& qidxTable()const;
+        void bindBlocks();
+        std::shared_ptr<const _PermutePlan> permutePlan(const std::vector<int>& rsp_outin, int rowBondNum)const;
+        std::shared_ptr<const _PermutePlan> buildPermutePlan(const std::vector<int>& rsp_outin, int rowBondNum)const;
+        static _ContractLayout contractLayout(const UniTensor& Ta, const UniTensor& Tb);
+        static std::vector<_ContractSector> contractSectors(const std::map<Qnum, Block>& blocksA, const std::map<Qnum, Block>& blocksB, const UniTensor& Tc, const _ContractLayout& lay);
+        static void multiplySectors(const std::vector<_ContractSector>& sectors, const _ContractLayout& lay, const Real* elemA, const Real* elemB, Real* elemC, bool ongpuA, bool ongpuB, bool ongpuC, Real alpha = 1.0, Real beta = 0.0);
+        static void multiplySectors(const std::vector<_ContractSector>& sectors, const _ContractLayout& lay, const Complex* elemA, const Complex* elemB, Complex* elemC, bool ongpuA, bool ongpuB, bool ongpuC, Complex alpha = 1.0, Complex beta = 0.0);
+        static void contractPacked(rflag tp, const UniTensor& Ta, const UniTensor& Tb, const _ContractLayout& lay, UniTensor& Tc, Real alpha, Real beta);
+        static void contractPacked(cflag tp, const UniTensor& Ta, const UniTensor& Tb, const _ContractLayout& lay, UniTensor& Tc, Complex alpha, Complex beta);
+        std::shared_ptr<const _PermutePlan> packPlan(const std::vector<int>& newLabels, int rowBondNum)const;
         std::vector<UniTensor> _hosvd(size_t modeNum, size_t fixedNum, std::vector<std::map<Qnum, Matrix> >& Ls, bool returnL)const;
         void TelemFree();
+        void TelemOwn(void* buf, size_t memsize);
+        void TelemDetach();
         /*********************  REAL **********************/
+        UniTensor(rflag tp, const _PermutePlan& plan, const std::string& _name, bool zero);
         void initUniT(rflag tp = RTYPE);
         size_t grouping(rflag tp = RTYPE);
         void initBlocks(rflag tp = RTYPE);
         void TelemAlloc(rflag tp = RTYPE);
         void TelemBzero(rflag tp = RTYPE);
         /*********************  COMPLEX **********************/
+        UniTensor(cflag tp, const _PermutePlan& plan, const std::string& _name, bool zero);
         void initUniT(cflag tp);
         size_t grouping(cflag tp);
         void initBlocks(cflag tp);
@@ -987,6 +1143,12 @@ namespace uni10 {
     UniTensor contract(UniTensor& Ta, UniTensor& Tb, bool fast = false);
     UniTensor contract(rflag tp, UniTensor& Ta, UniTensor& Tb, bool fast = false);
     UniTensor contract(cflag tp, UniTensor& Ta, UniTensor& Tb, bool fast = false);
+    UniTensor contract(const UniTensor& Ta, const UniTensor& Tb);
+    UniTensor contract(rflag tp, const UniTensor& Ta, const UniTensor& Tb);
+    UniTensor contract(cflag tp, const UniTensor& Ta, const UniTensor& Tb);
+    UniTensor& contract(const UniTensor& Ta, const UniTensor& Tb, UniTensor& Tc, Real alpha = 1.0, Real beta = 0.0);
+    UniTensor& contract(rflag tp, const UniTensor& Ta, const UniTensor& Tb, UniTensor& Tc, Real alpha = 1.0, Real beta = 0.0);
+    UniTensor& contract(cflag tp, const UniTensor& Ta, const UniTensor& Tb, UniTensor& Tc, Complex alpha = 1.0, Complex beta = 0.0);
     UniTensor otimes(const UniTensor& Ta, const UniTensor& Tb);
     UniTensor otimes(rflag tp, const UniTensor& Ta, const UniTensor& Tb);
     UniTensor otimes(cflag tp, const UniTensor& Ta, const UniTensor& Tb);
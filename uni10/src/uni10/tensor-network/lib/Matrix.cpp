@@ -44,9 +44,9 @@ Matrix& Matrix::operator=(const Matrix& _m){
     Cnum = _m.Cnum;
     diag = _m.diag;
     ongpu = _m.ongpu;
-    MelemFree();
-    setMelemBNULL();
-    init(_m.m_elem, _m.cm_elem, _m.ongpu);
+    m_elem = _m.m_elem;
+    cm_elem = _m.cm_elem;
+    m_store = _m.m_store;
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function Matrix::operator=(uni10::Matrix&):");
@@ -54,6 +54,19 @@ Matrix& Matrix::operator=(const Matrix& _m){
   return *this;
 }
 
+Matrix& Matrix::operator=(Matrix&& _m){
+  try{
+    if(this == &_m)
+      return *this;
+    m_store = std::move(_m.m_store);
+    Block::operator=(std::move(_m));
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function Matrix::operator=(uni10::Matrix&&):");
+  }
+  return *this;
+}
+
 Matrix& Matrix::operator=(const Block& _b){
   try{
     r_flag = _b.r_flag;
@@ -74,9 +87,9 @@ Matrix& Matrix::operator=(const Block& _b){
 Matrix& Matrix::operator*= (const Block& Mb){
   try{
     if(!ongpu && typeID() == 1)
-      m_elem = (Real*)mvGPU(m_elem, elemNum() * sizeof(Real), ongpu);
+      MelemToGPU();
     if(!ongpu && typeID() == 2)
-      cm_elem = (Complex*)mvGPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+      MelemToGPU();
     *this = *this * Mb;
   }
   catch(const std::exception& e){
@@ -87,12 +100,13 @@ Matrix& Matrix::operator*= (const Block& Mb){
 
 Matrix& Matrix::operator*= (Real a){
   try{
+    MelemDetach();
     if(!ongpu && typeID() == 1){
-      m_elem = (Real*)mvGPU(m_elem, elemNum() * sizeof(Real), ongpu);
+      MelemToGPU();
       vectorScal(a, m_elem, elemNum(), ongpu);
     }
     if(!ongpu && typeID() == 2){
-      cm_elem = (Complex*)mvGPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+      MelemToGPU();
       vectorScal(a, cm_elem, elemNum(), ongpu);
     }
   }
@@ -109,8 +123,9 @@ Matrix& Matrix::operator*= (Complex a){
     else{
       if(typeID() == 1)
         RtoC(*this);
+      MelemDetach();
       if(!ongpu){
-        cm_elem = (Complex*)mvGPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+        MelemToGPU();
         vectorScal(a, cm_elem, elemNum(), ongpu);
       }
     }
@@ -128,10 +143,11 @@ Matrix& Matrix::operator+= (const Block& Mb){
       err<<"These two matrix has different shape do not match for matrix add. ";
       throw std::runtime_error(exception_msg(err.str())); ;
     };
+    MelemDetach();
     if(!ongpu && typeID() == 1)
-      m_elem = (Real*)mvGPU(m_elem, elemNum() * sizeof(Real), ongpu);
+      MelemToGPU();
     if(!ongpu && typeID() == 2)
-      cm_elem = (Complex*)mvGPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+      MelemToGPU();
     if(typeID() == 1 && Mb.typeID() == 1)
       RAddR(*this, Mb);
     else if(typeID() == 2 && Mb.typeID() == 2)
@@ -159,8 +175,10 @@ Real& Matrix::operator[](size_t idx){
       err<<"This matrix is COMPLEX. Please use operator()." << std::endl << "In the file Matrix.cpp, line(" << __LINE__ << ")";
       throw std::runtime_error(exception_msg(err.str()));
     }
-    else if(typeID() == 1)
-      m_elem = (Real*)mvCPU(m_elem, elemNum() * sizeof(Real), ongpu);
+    else if(typeID() == 1){
+      MelemDetach();
+      MelemToCPU();
+    }
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function Matrix::opeartor[](size_t):");
@@ -180,8 +198,10 @@ Complex& Matrix::operator()(size_t idx){
       err<<"This matrix is REAL. Please use operator[] instead." << std::endl << "In the file Matrix.cpp, line(" << __LINE__ << ")";
       throw std::runtime_error(exception_msg(err.str()));
     }
-    if(typeID() == 2)
-      cm_elem = (Complex*)mvCPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+    if(typeID() == 2){
+      MelemDetach();
+      MelemToCPU();
+    }
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function Matrix::opeartor()(size_t):");
@@ -192,10 +212,67 @@ Complex& Matrix::operator()(size_t idx){
 /*********************  NO TYPE **************************/
 
 void Matrix::MelemFree(){
-  if(m_elem != NULL)
-    elemFree(m_elem, elemNum() * sizeof(Real), ongpu);
-  if(cm_elem != NULL)
-    elemFree(cm_elem, elemNum() * sizeof(Complex), ongpu);
+  m_store.reset();
+}
+
+void Matrix::MelemOwn(void* buf, size_t memsize){
+  m_store.reset(new _ElemStore(buf, memsize, ongpu));
+}
+
+void Matrix::MelemDetach(){
+  if(m_store.use_count() < 2)
+    return;
+  bool src_ongpu = ongpu;
+  if(m_elem != NULL){
+    Real* src = m_elem;
+    init(RTYPE, ongpu);
+    elemCopy(m_elem, src, elemNum() * sizeof(Real), ongpu, src_ongpu);
+  }
+  else if(cm_elem != NULL){
+    Complex* src = cm_elem;
+    init(CTYPE, ongpu);
+    elemCopy(cm_elem, src, elemNum() * sizeof(Complex), ongpu, src_ongpu);
+  }
+}
+
+void Matrix::MelemShrink(size_t memsize){
+  shrinkWithoutFree(memsize, ongpu);
+  if(m_store)
+    m_store->memsize -= memsize;
+}
+
+void Matrix::MelemToGPU(){
+  // Moving frees the host buffer, which other copies may still read. A shared matrix stays on the host.
+  if(ongpu || m_store.use_count() != 1)
+    return;
+  if(m_elem != NULL){
+    m_elem = (Real*)mvGPU(m_elem, elemNum() * sizeof(Real), ongpu);
+    m_store->elem = m_elem;
+    m_store->memsize = elemNum() * sizeof(Real);
+  }
+  else if(cm_elem != NULL){
+    cm_elem = (Complex*)mvGPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+    m_store->elem = cm_elem;
+    m_store->memsize = elemNum() * sizeof(Complex);
+  }
+  m_store->ongpu = ongpu;
+}
+
+void Matrix::MelemToCPU(){
+  if(!ongpu || !m_store)
+    return;
+  MelemDetach();
+  if(m_elem != NULL){
+    m_elem = (Real*)mvCPU(m_elem, elemNum() * sizeof(Real), ongpu);
+    m_store->elem = m_elem;
+    m_store->memsize = elemNum() * sizeof(Real);
+  }
+  else if(cm_elem != NULL){
+    cm_elem = (Complex*)mvCPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+    m_store->elem = cm_elem;
+    m_store->memsize = elemNum() * sizeof(Complex);
+  }
+  m_store->ongpu = ongpu;
 }
 void Matrix::setMelemBNULL(){
   m_elem = NULL;
@@ -238,17 +315,9 @@ Matrix::Matrix(std::string stp, size_t _Rnum, size_t _Cnum, bool _diag, bool _on
   }
 }
 
-Matrix::Matrix(const Matrix& _m): Block(_m.Rnum, _m.Cnum, _m.diag){
-  try{
-    r_flag = _m.r_flag;
-    c_flag = _m.c_flag;
-    ongpu = _m.ongpu;
-    init(_m.m_elem, _m.cm_elem, _m.ongpu);
-  }
-  catch(const std::exception& e){
-    propogate_exception(e, "In copy constructor Matrix::Matrix(const uni10::Matrix& ):");
-  }
-}
+Matrix::Matrix(const Matrix& _m): Block(_m), m_store(_m.m_store){}
+
+Matrix::Matrix(Matrix&& _m): Block(std::move(_m)), m_store(std::move(_m.m_store)){}
 
 Matrix::Matrix(const Block& _b): Block(_b){
   try{
@@ -405,11 +474,11 @@ void Matrix::load(const std::string& fname){
         elemBzero(m_elem, elemNum() * sizeof(Real), ongpu);
       Real* elem = m_elem;
       if(ongpu)
-        elem = (Real*)malloc(elemNum() * sizeof(Real));
+        elem = (Real*)poolAlloc(elemNum() * sizeof(Real), MEM_MATRIX);
       fread(elem, sizeof(Real), elemNum(), fp);
       if(ongpu){
         elemCopy(m_elem, elem, elemNum() * sizeof(Real), ongpu, false);
-        free(elem);
+        poolFree(elem);
       }
     }
 
@@ -419,11 +488,11 @@ void Matrix::load(const std::string& fname){
         elemBzero(cm_elem, elemNum() * sizeof(Complex), ongpu);
       Complex* elem = cm_elem;
       if(ongpu)
-        elem = (Complex*)malloc(elemNum() * sizeof(Complex));
+        elem = (Complex*)poolAlloc(elemNum() * sizeof(Complex), MEM_MATRIX);
       fread(elem, sizeof(Complex), elemNum(), fp);
       if(ongpu){
         elemCopy(cm_elem, elem, elemNum() * sizeof(Complex), ongpu, false);
-        free(elem);
+        poolFree(elem);
       }
     }
     fclose(fp);
@@ -465,8 +534,10 @@ Real& Matrix::at(size_t r, size_t c){
       err<<"The input indices are out of range.";
       throw std::runtime_error(exception_msg(err.str()));
     }
-    if(typeID() == 1)
-      m_elem = (Real*)mvCPU(m_elem, elemNum() * sizeof(Real), ongpu);
+    if(typeID() == 1){
+      MelemDetach();
+      MelemToCPU();
+    }
     if(diag){
       if(!(r == c && r < elemNum())){
         std::ostringstream err;
@@ -487,8 +558,9 @@ Real& Matrix::at(size_t r, size_t c){
 
 double* Matrix::getHostElem(){
   try{
+    MelemDetach();
     if(ongpu){
-      m_elem = (double*)mvCPU(m_elem, elemNum() * sizeof(double), ongpu);
+      MelemToCPU();
     }
   }
   catch(const std::exception& e){
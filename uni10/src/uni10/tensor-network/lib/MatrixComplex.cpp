@@ -37,13 +37,16 @@ namespace uni10{
 
   void Matrix::init(cflag tp, bool _ongpu){
 
+    MelemFree();
+    cm_elem = NULL;
     if(elemNum()){
       if(_ongpu)	// Try to allocate GPU memory
-        cm_elem = (Complex*)elemAlloc(elemNum() * sizeof(Complex), ongpu);
+        cm_elem = (Complex*)elemAlloc(elemNum() * sizeof(Complex), ongpu, MEM_MATRIX);
       else{
-        cm_elem = (Complex*)elemAllocForce(elemNum() * sizeof(Complex), false);
+        cm_elem = (Complex*)elemAllocForce(elemNum() * sizeof(Complex), false, MEM_MATRIX);
         ongpu = false;
       }
+      MelemOwn(cm_elem, elemNum() * sizeof(Complex));
     }
     m_elem = NULL;
 
@@ -120,11 +123,11 @@ Matrix::Matrix(cflag tp, const std::string& fname){
       elemBzero(cm_elem, elemNum() * sizeof(Complex), ongpu);
     Complex* elem = cm_elem;
     if(ongpu)
-      elem = (Complex*)malloc(elemNum() * sizeof(Complex));
+      elem = (Complex*)poolAlloc(elemNum() * sizeof(Complex), MEM_MATRIX);
     fread(elem, sizeof(Complex), elemNum(), fp);
     if(ongpu){
       elemCopy(cm_elem, elem, elemNum() * sizeof(Complex), ongpu, false);
-      free(elem);
+      poolFree(elem);
     }
     fclose(fp);
   }
@@ -161,6 +164,7 @@ void Matrix::setElem(const Complex* elem, bool src_ongpu){
       c_flag = CTYPE;
       init(CTYPE, ongpu);
     }
+    MelemDetach();
     elemCopy(cm_elem, elem, elemNum() * sizeof(Complex), ongpu, src_ongpu);
   }
   catch(const std::exception& e){
@@ -172,15 +176,13 @@ void Matrix::identity(cflag tp){
   try{
     throwTypeError(tp);
     diag = true;
-    if(cm_elem != NULL)
-      elemFree(cm_elem, elemNum() * sizeof(Complex), ongpu);
-
-    cm_elem = (Complex*)elemAlloc(elemNum() * sizeof(Complex), ongpu);
-    Complex* elemI = (Complex*)malloc(elemNum() * sizeof(Complex));
+    cm_elem = (Complex*)elemAlloc(elemNum() * sizeof(Complex), ongpu, MEM_MATRIX);
+    MelemOwn(cm_elem, elemNum() * sizeof(Complex));
+    Complex* elemI = (Complex*)poolAlloc(elemNum() * sizeof(Complex), MEM_MATRIX);
     for(size_t i = 0; i < elemNum(); i++)
       elemI[i] = 1;
     this->setElem(elemI, false);
-    free(elemI);
+    poolFree(elemI);
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function Matrix::identity(uni10::cflag ):");
@@ -190,6 +192,7 @@ void Matrix::identity(cflag tp){
 void Matrix::set_zero(cflag tp){
   try{
     throwTypeError(tp); 
+    MelemDetach();
     if(elemNum())
       elemBzero(cm_elem, elemNum() * sizeof(Complex), ongpu);
   }
@@ -201,8 +204,9 @@ void Matrix::set_zero(cflag tp){
 void Matrix::randomize(cflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(!ongpu)
-      cm_elem = (Complex*)mvGPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+      MelemToGPU();
     elemRand(cm_elem, elemNum(), ongpu);
   }
   catch(const std::exception& e){
@@ -213,8 +217,9 @@ void Matrix::randomize(cflag tp){
 void Matrix::orthoRand(cflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(!ongpu)
-      cm_elem = (Complex*)mvGPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+      MelemToGPU();
     if(!diag)
       orthoRandomize(cm_elem, Rnum, Cnum, ongpu);
   }
@@ -226,6 +231,7 @@ void Matrix::orthoRand(cflag tp){
 Matrix& Matrix::normalize(cflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     Real norm = vectorNorm(cm_elem, elemNum(), 1, ongpu);
     vectorScal((1./norm), cm_elem, elemNum(), ongpu);
   }
@@ -238,8 +244,9 @@ Matrix& Matrix::normalize(cflag tp){
 Matrix& Matrix::transpose(cflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(!ongpu)
-      cm_elem = (Complex*)mvGPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+      MelemToGPU();
     if(!(diag || Rnum == 1 || Cnum == 1))
       setTranspose(cm_elem, Rnum, Cnum, ongpu);
     size_t tmp = Rnum;
@@ -255,8 +262,9 @@ Matrix& Matrix::transpose(cflag tp){
 Matrix& Matrix::cTranspose(cflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(!ongpu)
-      cm_elem = (Complex*)mvGPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+      MelemToGPU();
     if(diag || Rnum == 1 || Cnum == 1)
       this->conj();
     else
@@ -273,6 +281,7 @@ Matrix& Matrix::cTranspose(cflag tp){
 
 Matrix& Matrix::conj(cflag tp){
   throwTypeError(tp);
+  MelemDetach();
   setConjugate(cm_elem, elemNum(), ongpu);
   return *this;
 }
@@ -280,20 +289,20 @@ Matrix& Matrix::conj(cflag tp){
 Matrix& Matrix::resize(cflag tp, size_t row, size_t col){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(diag){
       size_t _elemNum = row < col ? row : col;
       if(_elemNum > elemNum()){
         bool des_ongpu;
-        Complex* elem = (Complex*)elemAlloc(_elemNum * sizeof(Complex), des_ongpu);
+        Complex* elem = (Complex*)elemAlloc(_elemNum * sizeof(Complex), des_ongpu, MEM_MATRIX);
         elemBzero(elem, _elemNum * sizeof(Complex), des_ongpu);
         elemCopy(elem, cm_elem, elemNum() * sizeof(Complex), des_ongpu, ongpu);
-        if(cm_elem != NULL)
-          elemFree(cm_elem, elemNum() * sizeof(Complex), ongpu);
         cm_elem = elem;
         ongpu = des_ongpu;
+        MelemOwn(cm_elem, _elemNum * sizeof(Complex));
       }
       else
-        shrinkWithoutFree((elemNum() - _elemNum) * sizeof(Complex), ongpu);
+        MelemShrink((elemNum() - _elemNum) * sizeof(Complex));
       Rnum = row;
       Cnum = col;
     }
@@ -302,30 +311,28 @@ Matrix& Matrix::resize(cflag tp, size_t row, size_t col){
         size_t _elemNum = row * col;
         if(row > Rnum){
           bool des_ongpu;
-          Complex* elem = (Complex*)elemAlloc(_elemNum * sizeof(Complex), des_ongpu);
+          Complex* elem = (Complex*)elemAlloc(_elemNum * sizeof(Complex), des_ongpu, MEM_MATRIX);
           elemBzero(elem, _elemNum * sizeof(Complex), des_ongpu);
           elemCopy(elem, cm_elem, elemNum() * sizeof(Complex), des_ongpu, ongpu);
-          if(cm_elem != NULL)
-            elemFree(cm_elem, elemNum() * sizeof(Complex), ongpu);
           cm_elem = elem;
           ongpu = des_ongpu;
+          MelemOwn(cm_elem, _elemNum * sizeof(Complex));
         }
         else
-          shrinkWithoutFree((elemNum() - _elemNum) * sizeof(Complex), ongpu);
+          MelemShrink((elemNum() - _elemNum) * sizeof(Complex));
         Rnum = row;
       }
       else{
         size_t data_row = row < Rnum ? row : Rnum;
         size_t data_col = col < Cnum ? col : Cnum;
         bool des_ongpu;
-        Complex* elem = (Complex*)elemAlloc(row * col * sizeof(Complex), des_ongpu);
+        Complex* elem = (Complex*)elemAlloc(row * col * sizeof(Complex), des_ongpu, MEM_MATRIX);
         elemBzero(elem, row * col * sizeof(Complex), des_ongpu);
         for(size_t r = 0; r < data_row; r++)
           elemCopy(&(elem[r * col]), &(cm_elem[r * Cnum]), data_col * sizeof(Complex), des_ongpu, ongpu);
-        if(cm_elem != NULL)
-          elemFree(cm_elem, elemNum() * sizeof(Complex), ongpu);
         cm_elem = elem;
         ongpu = des_ongpu;
+        MelemOwn(cm_elem, row * col * sizeof(Complex));
         Rnum = row;
         Cnum = col;
       }
@@ -350,8 +357,9 @@ void Matrix::assign(cflag tp, size_t _Rnum, size_t _Cnum){
 
 bool Matrix::toGPU(cflag tp){
   throwTypeError(tp);
+  MelemDetach();
   if(!ongpu)
-    cm_elem = (Complex*)mvGPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+    MelemToGPU();
   return ongpu;
 }
 
@@ -363,7 +371,8 @@ Complex& Matrix::at(cflag tp, size_t idx){
       err<<"Index exceeds the number of the matrix elements("<<elemNum()<<").";
       throw std::runtime_error(exception_msg(err.str()));
     }
-    cm_elem = (Complex*)mvCPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+    MelemDetach();
+    MelemToCPU();
     return cm_elem[idx];
   }
   catch(const std::exception& e){
@@ -375,8 +384,9 @@ Complex& Matrix::at(cflag tp, size_t idx){
 Complex* Matrix::getHostElem(cflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(ongpu){
-      cm_elem = (Complex*)mvCPU(cm_elem, elemNum() * sizeof(Complex), ongpu);
+      MelemToCPU();
     }
   }
   catch(const std::exception& e){
@@ -385,4 +395,14 @@ Complex* Matrix::getHostElem(cflag tp){
   return cm_elem;
 }
 
+Complex* Matrix::getElem(cflag tp){
+  try{
+    MelemDetach();
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function Matrix::getElem(uni10::cflag ):");
+  }
+  return Block::getElem(tp);
+}
+
 };	/* namespace uni10 */
@@ -37,13 +37,16 @@ namespace uni10{
 
 void Matrix::init(rflag tp, bool _ongpu){
 
+  MelemFree();
+  m_elem = NULL;
   if(elemNum()){
     if(_ongpu)	// Try to allocate GPU memory
-      m_elem = (Real*)elemAlloc(elemNum() * sizeof(Real), ongpu);
+      m_elem = (Real*)elemAlloc(elemNum() * sizeof(Real), ongpu, MEM_MATRIX);
     else{
-      m_elem = (Real*)elemAllocForce(elemNum() * sizeof(Real), false);
+      m_elem = (Real*)elemAllocForce(elemNum() * sizeof(Real), false, MEM_MATRIX);
       ongpu = false;
     }
+    MelemOwn(m_elem, elemNum() * sizeof(Real));
   }
   cm_elem = NULL;
 
@@ -118,11 +121,11 @@ Matrix::Matrix(rflag tp, const std::string& fname){
       elemBzero(m_elem, elemNum() * sizeof(Real), ongpu);
     Real* elem = m_elem;
     if(ongpu)
-      elem = (Real*)malloc(elemNum() * sizeof(Real));
+      elem = (Real*)poolAlloc(elemNum() * sizeof(Real), MEM_MATRIX);
     fread(elem, sizeof(Real), elemNum(), fp);
     if(ongpu){
       elemCopy(m_elem, elem, elemNum() * sizeof(Real), ongpu, false);
-      free(elem);
+      poolFree(elem);
     }
     fclose(fp);
   }
@@ -159,6 +162,7 @@ void Matrix::setElem(const Real* elem, bool src_ongpu){
       c_flag = CNULL;
       init(RTYPE, ongpu);
     }
+    MelemDetach();
     elemCopy(m_elem, elem, elemNum() * sizeof(Real), ongpu, src_ongpu);
   }
   catch(const std::exception& e){
@@ -170,16 +174,14 @@ void Matrix::identity(rflag tp){
   try{
     throwTypeError(tp);
     diag = true;
-    if(m_elem != NULL)
-      elemFree(m_elem, elemNum() * sizeof(Real), ongpu);
-
-    m_elem = (Real*)elemAlloc(elemNum() * sizeof(Real), ongpu);
-    Real* elemI = (Real*)malloc(elemNum() * sizeof(Real));
+    m_elem = (Real*)elemAlloc(elemNum() * sizeof(Real), ongpu, MEM_MATRIX);
+    MelemOwn(m_elem, elemNum() * sizeof(Real));
+    Real* elemI = (Real*)poolAlloc(elemNum() * sizeof(Real), MEM_MATRIX);
     
     for(size_t i = 0; i < elemNum(); i++)
       elemI[i] = 1;
     this->setElem(elemI);
-    free(elemI);
+    poolFree(elemI);
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function Matrix::identity(uni10::rflag ):");
@@ -189,6 +191,7 @@ void Matrix::identity(rflag tp){
 void Matrix::set_zero(rflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(elemNum())
       elemBzero(m_elem, elemNum() * sizeof(Real), ongpu);
   }
@@ -200,8 +203,9 @@ void Matrix::set_zero(rflag tp){
 void Matrix::randomize(rflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(!ongpu)
-      m_elem = (Real*)mvGPU(m_elem, elemNum() * sizeof(Real), ongpu);
+      MelemToGPU();
     elemRand(m_elem, elemNum(), ongpu);
   }
   catch(const std::exception& e){
@@ -212,8 +216,9 @@ void Matrix::randomize(rflag tp){
 void Matrix::orthoRand(rflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(!ongpu)
-      m_elem = (Real*)mvGPU(m_elem, elemNum() * sizeof(Real), ongpu);
+      MelemToGPU();
     if(!diag)
       orthoRandomize(m_elem, Rnum, Cnum, ongpu);
   }
@@ -225,8 +230,9 @@ void Matrix::orthoRand(rflag tp){
 Matrix& Matrix::transpose(rflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(!ongpu)
-      m_elem = (Real*)mvGPU(m_elem, elemNum() * sizeof(Real), ongpu);
+      MelemToGPU();
     if(!(diag || Rnum == 1 || Cnum == 1))
       setTranspose(m_elem, Rnum, Cnum, ongpu);
     size_t tmp = Rnum;
@@ -257,20 +263,20 @@ Matrix& Matrix::conj(rflag tp){
 Matrix& Matrix::resize(rflag tp, size_t row, size_t col){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(diag){
       size_t _elemNum = row < col ? row : col;
       if(_elemNum > elemNum()){
         bool des_ongpu;
-        Real* elem = (Real*)elemAlloc(_elemNum * sizeof(Real), des_ongpu);
+        Real* elem = (Real*)elemAlloc(_elemNum * sizeof(Real), des_ongpu, MEM_MATRIX);
         elemBzero(elem, _elemNum * sizeof(Real), des_ongpu);
         elemCopy(elem, m_elem, elemNum() * sizeof(Real), des_ongpu, ongpu);
-        if(m_elem != NULL)
-          elemFree(m_elem, elemNum() * sizeof(Real), ongpu);
         m_elem = elem;
         ongpu = des_ongpu;
+        MelemOwn(m_elem, _elemNum * sizeof(Real));
       }
       else
-        shrinkWithoutFree((elemNum() - _elemNum) * sizeof(Real), ongpu);
+        MelemShrink((elemNum() - _elemNum) * sizeof(Real));
       Rnum = row;
       Cnum = col;
     }
@@ -279,30 +285,28 @@ Matrix& Matrix::resize(rflag tp, size_t row, size_t col){
         size_t _elemNum = row * col;
         if(row > Rnum){
           bool des_ongpu;
-          Real* elem = (Real*)elemAlloc(_elemNum * sizeof(Real), des_ongpu);
+          Real* elem = (Real*)elemAlloc(_elemNum * sizeof(Real), des_ongpu, MEM_MATRIX);
           elemBzero(elem, _elemNum * sizeof(Real), des_ongpu);
           elemCopy(elem, m_elem, elemNum() * sizeof(Real), des_ongpu, ongpu);
-          if(m_elem != NULL)
-            elemFree(m_elem, elemNum() * sizeof(Real), ongpu);
           m_elem = elem;
           ongpu = des_ongpu;
+          MelemOwn(m_elem, _elemNum * sizeof(Real));
         }
         else
-          shrinkWithoutFree((elemNum() - _elemNum) * sizeof(Real), ongpu);
+          MelemShrink((elemNum() - _elemNum) * sizeof(Real));
         Rnum = row;
       }
       else{
         size_t data_row = row < Rnum ? row : Rnum;
         size_t data_col = col < Cnum ? col : Cnum;
         bool des_ongpu;
-        Real* elem = (Real*)elemAlloc(row * col * sizeof(Real), des_ongpu);
+        Real* elem = (Real*)elemAlloc(row * col * sizeof(Real), des_ongpu, MEM_MATRIX);
         elemBzero(elem, row * col * sizeof(Real), des_ongpu);
         for(size_t r = 0; r < data_row; r++)
           elemCopy(&(elem[r * col]), &(m_elem[r * Cnum]), data_col * sizeof(Real), des_ongpu, ongpu);
-        if(m_elem != NULL)
-          elemFree(m_elem, elemNum() * sizeof(Real), ongpu);
         m_elem = elem;
         ongpu = des_ongpu;
+        MelemOwn(m_elem, row * col * sizeof(Real));
         Rnum = row;
         Cnum = col;
       }
@@ -327,8 +331,9 @@ void Matrix::assign(rflag tp, size_t _Rnum, size_t _Cnum){
 
 bool Matrix::toGPU(rflag tp){
   throwTypeError(tp);
+  MelemDetach();
   if(!ongpu)
-    m_elem = (Real*)mvGPU(m_elem, elemNum() * sizeof(Real), ongpu);
+    MelemToGPU();
   return ongpu;
 }
 
@@ -340,7 +345,8 @@ Real& Matrix::at(rflag tp, size_t idx){
       err<<"Index exceeds the number of the matrix elements("<<elemNum()<<").";
       throw std::runtime_error(exception_msg(err.str()));
     }
-    m_elem = (Real*)mvCPU(m_elem, elemNum() * sizeof(Real), ongpu);
+    MelemDetach();
+    MelemToCPU();
     return m_elem[idx];
   }
   catch(const std::exception& e){
@@ -352,8 +358,9 @@ Real& Matrix::at(rflag tp, size_t idx){
 Real* Matrix::getHostElem(rflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     if(ongpu)
-      m_elem = (Real*)mvCPU(m_elem, elemNum() * sizeof(Real), ongpu);
+      MelemToCPU();
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function Matrix::getHostElem(uni10::rflag ):");
@@ -361,6 +368,16 @@ Real* Matrix::getHostElem(rflag tp){
   return m_elem;
 }
 
+Real* Matrix::getElem(rflag tp){
+  try{
+    MelemDetach();
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function Matrix::getElem(uni10::rflag ):");
+  }
+  return Block::getElem(tp);
+}
+
 /*********************  developping  **********************/
 
 Real Matrix::max(rflag tp, bool on_gpu){
@@ -388,6 +405,7 @@ Real Matrix::absMax(rflag tp, bool on_gpu){
 Matrix& Matrix::normalize(rflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     Real norm = vectorNorm(m_elem, elemNum(), 1, ongpu);
     vectorScal((1./norm), m_elem, elemNum(), ongpu);
   }
@@ -400,6 +418,7 @@ Matrix& Matrix::normalize(rflag tp){
 Matrix& Matrix::maxNorm(rflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     Real max = elemMax(m_elem, elemNum(), ongpu);
     vectorScal((1./max), m_elem, elemNum(), ongpu);
   }
@@ -412,6 +431,7 @@ Matrix& Matrix::maxNorm(rflag tp){
 Matrix& Matrix::absMaxNorm(rflag tp){
   try{
     throwTypeError(tp);
+    MelemDetach();
     Real absMax = elemAbsMax(m_elem, elemNum(), ongpu);
     vectorScal((1./absMax), m_elem, elemNum(), ongpu);
   }
@@ -38,13 +38,13 @@ namespace uni10{
   void RtoC(Matrix& mat){
     try{
       if(mat.typeID() == 1){
+        std::shared_ptr<_ElemStore> real = mat.m_store;  // Holds the real elements until they are cast
+        Real* src = mat.m_elem;
+        bool src_ongpu = mat.ongpu;
         mat.r_flag = RNULL;
         mat.c_flag = CTYPE;
-        mat.cm_elem = (Complex*)elemAlloc(mat.elemNum() * sizeof(Complex), mat.ongpu);
-        elemCast(mat.cm_elem, mat.m_elem, mat.elemNum(), mat.ongpu, mat.ongpu);
-        if(mat.m_elem != NULL)
-          elemFree(mat.m_elem, mat.elemNum() * sizeof(Real), mat.ongpu);
-        mat.m_elem = NULL;
+        mat.init(CTYPE, mat.ongpu);
+        elemCast(mat.cm_elem, src, mat.elemNum(), mat.ongpu, src_ongpu);
       }
     }
     catch(const std::exception& e){
@@ -54,6 +54,7 @@ namespace uni10{
 
   void RAddR(Matrix& Ma, const Matrix& Mb){
 
+    Ma.MelemDetach();
     if (Ma.diag && !Mb.diag) {
       Matrix Mc(RTYPE, Ma.Rnum,Ma.Cnum);
       setDiag(Mc.m_elem,Ma.m_elem,Mc.Rnum,Mc.Cnum,Ma.Rnum,Mc.ongpu,Ma.ongpu);
@@ -70,6 +71,7 @@ namespace uni10{
 
   void CAddC(Matrix& Ma, const Matrix& Mb){
 
+    Ma.MelemDetach();
     if (Ma.diag && !Mb.diag) {
       Matrix Mc(CTYPE, Ma.Rnum,Ma.Cnum);
       setDiag(Mc.cm_elem,Ma.cm_elem,Mc.Rnum,Mc.Cnum,Ma.Rnum,Mc.ongpu,Ma.ongpu);
@@ -29,12 +29,24 @@
 *
 *****************************************************************************/
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <uni10/tools/uni10_tools.h>
+#include <uni10/numeric/lapack/uni10_lapack.h>
 #include <uni10/tensor-network/UniTensor.h>
 #include <uni10/tensor-network/Network.h>
 
 
 namespace uni10{
+// Up to this many tensors, the order of a network file without ORDER line is searched for by dynamic programming,
+// larger networks take the greedy order. Both are deterministic, the search takes some 25 ms for 12 tensors.
+const int AUTO_ORDER_DP_MAX = 12;
+// Same for networks with symmetric bonds, whose pairs are costed sector by sector, some 100 ms for 10 tensors.
+const int AUTO_ORDER_DP_SECTOR_MAX = 10;
+// Below this many elements of intermediate tensors a network is contracted by the calling thread only.
+const size_t PARALLEL_MERGE_MIN = 1 << 16;
+
 Node::Node(): T(NULL), elemNum(0), parent(NULL), left(NULL), right(NULL), point(0){
 }
 
@@ -219,8 +231,104 @@ int64_t Node::cal_elemNum(std::vector<Bond>& _bonds){
 	return _elemNum;
 }
 
+namespace {
+
+size_t elemBytes(const UniTensor& T){
+	return T.elemNum() * (T.typeID() == 2 ? sizeof(Complex) : sizeof(Real));
+}
+
+int inBondNum(const std::vector<Bond>& bonds){
+	int num = 0;
+	for(size_t b = 0; b < bonds.size(); b++)
+		if(bonds[b].type() == BD_IN)
+			num++;
+	return num;
+}
+
+/* Copies the index range [lo, hi) of the middle dimension of an outer x dim x inner array. */
+template<typename T>
+void copyRange(const T* src, T* dst, size_t outer, size_t dim, size_t inner, size_t lo, size_t hi){
+	for(size_t o = 0; o < outer; o++)
+		std::copy(src + (o * dim + lo) * inner, src + (o * dim + hi) * inner, dst + o * (hi - lo) * inner);
+}
+
+}
 
-Network::Network(const std::string& fname): root(NULL), load(false), times(0), tot_elem(0), max_elem(0){
+_ContractCost Node::cost(Node* nd){
+	std::vector<int> freeA, conA, freeB, conB;
+	std::map<Qnum, double> rows, inner, cols;
+	rows[Qnum()] = 1;
+	inner[Qnum()] = 1;
+	cols[Qnum()] = 1;
+	//The free bonds of this node become the rows of the result and the free bonds of nd its columns.
+	for(size_t a = 0; a < labels.size(); a++){
+		if(std::find(nd->labels.begin(), nd->labels.end(), labels[a]) != nd->labels.end()){
+			conA.push_back(labels[a]);
+			addSectors(inner, bonds[a], BD_OUT);
+		}
+		else{
+			freeA.push_back(labels[a]);
+			addSectors(rows, bonds[a], BD_IN);
+		}
+	}
+	for(size_t b = 0; b < nd->labels.size(); b++){
+		if(std::find(conA.begin(), conA.end(), nd->labels[b]) != conA.end())
+			conB.push_back(nd->labels[b]);
+		else{
+			freeB.push_back(nd->labels[b]);
+			addSectors(cols, nd->bonds[b], BD_OUT);
+		}
+	}
+	_ContractCost c;
+	double size;
+	c.flops = sectorCost(rows, inner, cols, size);
+	c.elemNum = size;
+	//An operand is moved unless its bonds already line up, as in UniTensor::contractLayout() for host tensors.
+	bool fermionic = Qnum::isFermionic();
+	bool trivial = !fermionic && trivialBonds(bonds) && trivialBonds(nd->bonds);
+	size_t rA = inBondNum(bonds);
+	size_t rB = inBondNum(nd->bonds);
+	for(int cand = 0; cand < 2; cand++){
+		const std::vector<int>& con = cand == 0 ? conA : conB;
+		bool keepA = (labels == concat(freeA, con) && (rA == freeA.size() || trivial))
+			|| (!fermionic && labels == concat(con, freeA) && (rA == con.size() || trivial));
+		bool keepB = (nd->labels == concat(con, freeB) && (rB == con.size() || trivial))
+			|| (!fermionic && nd->labels == concat(freeB, con) && (rB == freeB.size() || trivial));
+		double traffic = (keepA ? 0 : elemNum) + (keepB ? 0 : nd->elemNum);
+		if(cand == 0 || traffic < c.traffic)
+			c.traffic = traffic;
+	}
+	if(conA.empty())	//the outer product is permuted afterwards
+		c.traffic += c.elemNum;
+	return c;
+}
+
+void Node::addSectors(std::map<Qnum, double>& sectors, const Bond& bd, bondType tp){
+	//Counted as if the bond were changed to type tp, see Bond::change().
+	std::map<Qnum, double> folded;
+	for(std::map<Qnum, double>::const_iterator it = sectors.begin(); it != sectors.end(); it++)
+		for(size_t q = 0; q < bd.Qnums.size(); q++)
+			folded[it->first * (bd.m_type == tp ? bd.Qnums[q] : -bd.Qnums[q])] += it->second * bd.Qdegs[q];
+	sectors.swap(folded);
+}
+
+double Node::sectorCost(const std::map<Qnum, double>& rows, const std::map<Qnum, double>& inner, const std::map<Qnum, double>& cols, double& size){
+	double flops = 0;
+	size = 0;
+	std::map<Qnum, double>::const_iterator it, it2;
+	for(it = rows.begin(); it != rows.end(); it++){
+		if((it2 = cols.find(it->first)) == cols.end())
+			continue;
+		size += it->second * it2->second;
+		std::map<Qnum, double>::const_iterator it3 = inner.find(it->first);
+		if(it3 != inner.end())
+			flops += it->second * it3->second * it2->second;
+	}
+	return flops;
+}
+
+
+Network::Network(const std::string& fname): autoOrder(false), orderLimit(0), root(NULL), compiled(false), parallelNum(0), parallelBudget(0), cacheCap(0), cacheBytes(0), cacheStamp(0), memLimit(0), sliceTarget(0), load(false), times(0), tot_elem(0), max_elem(0){
   try{
     fromfile(fname);
     int Tnum = label_arr.size() - 1;
@@ -235,7 +343,7 @@ Network::Network(const std::string& fname): root(NULL), load(false), times(0), t
   }
 }
 
-Network::Network(const std::string& fname, const std::vector<UniTensor*>& tens): root(NULL), load(false), times(0), tot_elem(0), max_elem(0){
+Network::Network(const std::string& fname, const std::vector<UniTensor*>& tens): autoOrder(false), orderLimit(0), root(NULL), compiled(false), parallelNum(0), parallelBudget(0), cacheCap(0), cacheBytes(0), cacheStamp(0), memLimit(0), sliceTarget(0), load(false), times(0), tot_elem(0), max_elem(0){
   try{
     fromfile(fname);
     if(!((label_arr.size() - 1) == tens.size())){
@@ -422,11 +530,28 @@ void Network::fromfile(const std::string& fname){//names, name2pos, label_arr, R
 	else{
 		for(int i = 0; i < numT; i++)
 			order[i] = i;
+		autoOrder = true;
 	}
 	infile.close();
 }
 
 void Network::construct(){
+	if(autoOrder){
+		// The order is kept while the bonds and the memory limit it was searched for are unchanged.
+		std::vector<Bond> leafBonds;
+		for(size_t t = 0; t < leafs.size(); t++)
+			if(leafs[t] != NULL)
+				leafBonds.insert(leafBonds.end(), leafs[t]->bonds.begin(), leafs[t]->bonds.end());
+		if(brakets.empty() || !(leafBonds == orderBonds) || memLimit != orderLimit){
+			bool dense = true;
+			for(size_t b = 0; b < leafBonds.size(); b++)
+				dense = dense && leafBonds[b].degeneracy().size() <= 1;
+			int dpMax = dense ? AUTO_ORDER_DP_MAX : AUTO_ORDER_DP_SECTOR_MAX;
+			setOrder(searchOrder((int)leafs.size() <= dpMax ? ORD_DP : ORD_GREEDY, 0));
+			orderBonds.swap(leafBonds);
+			orderLimit = memLimit;
+		}
+	}
 	if(brakets.size()){
 		std::vector<Node*> stack(leafs.size(), NULL);
 		int cursor = 0;
@@ -508,39 +633,58 @@ void Network::construct(){
 
 void Network::putTensor(size_t idx, const UniTensor* UniT, bool force){
   try{
-    if(!(idx < (label_arr.size()-1))){
-      std::ostringstream err;
-      err<<"Index exceeds the number of the tensors in the list of network file.";
-      throw std::runtime_error(exception_msg(err.str()));
-    }
-    if((!force) && load){
-      destruct();
-    }
-    if(!(UniT->RBondNum == Rnums[idx])){
-      std::ostringstream err;
-      err<<"The number of in-coming bonds does not match with the tensor '"<<names[idx]<<"' specified in network file";
-      throw std::runtime_error(exception_msg(err.str()));
-    }
-    if(leafs[idx] != NULL){
-      *(tensors[idx]) = *UniT;
-      tensors[idx]->setLabel(label_arr[idx]);
-      tensors[idx]->setName(names[idx]);
-      swapflags[idx] = false;
-    }
-    else{
-      UniTensor* ten = new UniTensor(*UniT);
-      ten->setName(names[idx]);
-      ten->setLabel(label_arr[idx]);
-      tensors[idx] = ten;
-      Node* ndp = new Node(ten);
-      leafs[idx] = ndp;
-    }
+    bindTensor(idx, *UniT, force, false);
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function Network::putTensor(size_t, uni10::UniTensor*, bool=true):");
   }
 }
 
+void Network::bindTensor(size_t idx, const UniTensor& UniT, bool force, bool trans){
+  if(!(idx < (label_arr.size()-1))){
+    std::ostringstream err;
+    err<<"Index exceeds the number of the tensors in the list of network file.";
+    throw std::runtime_error(exception_msg(err.str()));
+  }
+  if((!force) && load){
+    destruct();
+  }
+  // The transpose of a tensor is its bonds, out-going ones first, read through the transposed blocks.
+  int bondNum = UniT.bonds.size();
+  int RBondNum = trans ? bondNum - UniT.RBondNum : UniT.RBondNum;
+  if(!(RBondNum == Rnums[idx])){
+    std::ostringstream err;
+    err<<"The number of in-coming bonds does not match with the tensor '"<<names[idx]<<"' specified in network file";
+    throw std::runtime_error(exception_msg(err.str()));
+  }
+  std::vector<int> labels(label_arr[idx]);
+  if(!(labels.size() == UniT.bonds.size())){
+    std::ostringstream err;
+    err<<"The number of bonds does not match with the tensor '"<<names[idx]<<"' specified in network file";
+    throw std::runtime_error(exception_msg(err.str()));
+  }
+  if(trans)
+    for(int b = 0; b < bondNum; b++)
+      labels[b] = label_arr[idx][b < UniT.RBondNum ? bondNum - UniT.RBondNum + b : b - UniT.RBondNum];
+  if(leafs[idx] != NULL){
+    if(plan && !(tensors[idx]->bonds == UniT.bonds && tensors[idx]->labels == labels && tensors[idx]->typeID() == UniT.typeID()))
+      plan.reset();	//the layouts of the compiled contractions changed
+    cacheDrop(leafs[idx]->parent);	//the intermediate tensors depending on the tensor
+    *(tensors[idx]) = UniT;	//shares the elements
+    tensors[idx]->setLabel(labels);
+    tensors[idx]->setName(names[idx]);
+    swapflags[idx] = false;
+  }
+  else{
+    UniTensor* ten = new UniTensor(UniT);
+    ten->setName(names[idx]);
+    ten->setLabel(labels);
+    tensors[idx] = ten;
+    Node* ndp = new Node(ten);
+    leafs[idx] = ndp;
+  }
+}
+
 void Network::putTensor(size_t idx, const UniTensor& UniT, bool force){
   try{
     putTensor(idx, &UniT, force);
@@ -582,9 +726,14 @@ void Network::putTensorT(const std::string& nameT, const UniTensor* UniT, bool f
       err<<"There is no tensor named '"<<nameT<<"' in the network file";
       throw std::runtime_error(exception_msg(err.str()));
     }
-    UniTensor transT = *UniT;
-    transT.transpose();
-    putTensor(itT->second, &transT, force);
+    // Bonds without symmetry are transposed by the contractions reading the blocks, the others right away.
+    if(!Qnum::isFermionic() && !UniT->ongpu && trivialBonds(UniT->bonds))
+      bindTensor(itT->second, *UniT, force, true);
+    else{
+      UniTensor transT = *UniT;
+      transT.transpose();
+      bindTensor(itT->second, transT, force, false);
+    }
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function Network::putTensorT(std::string&, uni10::UniTensor*, bool=true):");
@@ -684,6 +833,10 @@ void Network::destruct(){
 	for(int i = 0; i < leafs.size(); i++)
 		leafs[i]->delink();
 	conOrder.clear();
+	plan.reset();
+	cacheClear();
+	rightFirst.clear();
+	slices.clear();
 	for(int t = 0; t < tensors.size(); t++){
 		if(Qnum::isFermionic() && swapflags[t]){
 			tensors[t]->addGate(swaps_arr[t]);
@@ -697,14 +850,23 @@ void Network::destruct(){
 
 UniTensor Network::launch(const std::string& _name){
   try{
+    MemoryScope scope("Network::launch", MEM_NETWORK);
     if(!load)
       construct();
-    for(int t = 0; t < tensors.size(); t++)
-      if(Qnum::isFermionic() && !swapflags[t]){
-	tensors[t]->addGate(swaps_arr[t]);
-	swapflags[t] = true;
-      }
-    UniTensor UniT = merge(root);
+    if(compiled && !plan)
+      compile();
+    addSwaps();
+    if(sliceTarget)
+      chooseSlices();
+    if(memLimit)
+      checkMemory();
+    if(plan && slices.empty()){
+      UniTensor UniT = replay();
+      UniT.setName(_name);
+      return UniT;
+    }
+    // Within a memory limit the pairs are contracted one after another.
+    UniTensor UniT = slices.size() ? launchSlices() : memLimit ? merge(root) : mergeParallel();
     int idx = label_arr.size() - 1;
     if(label_arr.size() > 0 && label_arr[idx].size() > 1)
       UniT.permute(label_arr[idx], Rnums[idx]);
@@ -717,26 +879,650 @@ UniTensor Network::launch(const std::string& _name){
   }
 }
 
-UniTensor Network::merge(Node* nd){
-  if(nd->left->T == NULL){
-    UniTensor lftT = merge(nd->left);
-    if(nd->right->T == NULL){
-      UniTensor rhtT = merge(nd->right);
-      return contract(lftT, rhtT, true);
+void Network::addSwaps(){
+  for(size_t t = 0; t < tensors.size(); t++)
+    if(Qnum::isFermionic() && !swapflags[t]){
+      tensors[t]->addGate(swaps_arr[t]);
+      swapflags[t] = true;
     }
-    else{
-      return contract(lftT, *(nd->right->T), true);
+}
+
+std::vector<UniTensor> Network::launchBatch(const std::string& name, const std::vector<UniTensor>& tens){
+  try{
+    MemoryScope scope("Network::launchBatch", MEM_NETWORK);
+    std::map<std::string, size_t>::const_iterator it = name2pos.find(name);
+    if(!(it != name2pos.end())){
+      std::ostringstream err;
+      err<<"There is no tensor named '"<<name<<"' in the network file";
+      throw std::runtime_error(exception_msg(err.str()));
+    }
+    size_t idx = it->second;
+    std::vector<UniTensor> results(tens.size());
+    if(tens.empty())
+      return results;
+    for(size_t i = 1; i < tens.size(); i++)
+      if(!(tens[i].bonds == tens[0].bonds)){
+        std::ostringstream err;
+        err<<"The tensors put at '"<<name<<"' have different bonds.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+    putTensor(idx, tens[0]);
+    if(!load)
+      construct();
+    addSwaps();
+    // The siblings of the path from the tensor to the root are contracted once.
+    std::vector<Node*> path;
+    std::vector<UniTensor> others;
+    for(Node* nd = leafs[idx]; nd->parent != NULL; nd = nd->parent){
+      Node* sib = nd->parent->left == nd ? nd->parent->right : nd->parent->left;
+      others.push_back(sib->T ? *(sib->T) : merge(sib));
+      path.push_back(nd->parent);
+    }
+    int outIdx = label_arr.size() - 1;
+    int blasNum = std::max(1, getThreadNum() / (int)std::min(tens.size(), (size_t)getThreadNum()));
+    BlasThreads blas(blasNum);
+    parallelFor(tens.size(), [&](size_t i){
+      BlasThreads local(blasNum);
+      UniTensor T = tens[i];
+      T.setLabel(label_arr[idx]);
+      T.setName(names[idx]);
+      if(Qnum::isFermionic())
+        T.addGate(swaps_arr[idx]);
+      Node* nd = leafs[idx];
+      for(size_t p = 0; p < path.size(); nd = path[p++])
+        T = path[p]->left == nd ? contract(T, others[p]) : contract(others[p], T);
+      if(label_arr[outIdx].size() > 1)
+        T.permute(label_arr[outIdx], Rnums[outIdx]);
+      results[i] = T;
+    });
+    return results;
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function Network::launchBatch(std::string&, std::vector<uni10::UniTensor>&):");
+    return std::vector<UniTensor>();
+  }
+}
+
+const UniTensor& Network::_inside(Node* nd, std::map<Node*, UniTensor>& inside){
+  // The contraction of the subtree of nd, kept for the environments.
+  if(nd->T != NULL)
+    return *(nd->T);
+  std::map<Node*, UniTensor>::iterator it = inside.find(nd);
+  if(it == inside.end()){
+    const UniTensor& lftT = _inside(nd->left, inside);
+    const UniTensor& rhtT = _inside(nd->right, inside);
+    it = inside.insert(std::make_pair(nd, contract(lftT, rhtT))).first;
+  }
+  return it->second;
+}
+
+void Network::_outside(Node* nd, const UniTensor& out, std::map<Node*, UniTensor>& inside, const std::set<Node*>& wanted, std::map<Node*, UniTensor>& envs){
+  // out is the environment of nd, the one of a child is out contracted with the other child.
+  if(nd->T != NULL){
+    envs[nd] = out;
+    return;
+  }
+  Node* children[] = {nd->left, nd->right};
+  for(int c = 0; c < 2; c++){
+    if(!wanted.count(children[c]))
+      continue;
+    const UniTensor& sib = _inside(children[1 - c], inside);
+    _outside(children[c], nd == root ? sib : contract(out, sib), inside, wanted, envs);
+  }
+  inside.erase(nd);
+}
+
+std::vector<UniTensor> Network::environments(const std::vector<std::string>& _names){
+  try{
+    MemoryScope scope("Network::environments", MEM_NETWORK);
+    std::vector<size_t> holes;
+    for(size_t i = 0; i < _names.size(); i++){
+      std::map<std::string, size_t>::const_iterator it = name2pos.find(_names[i]);
+      if(!(it != name2pos.end())){
+        std::ostringstream err;
+        err<<"There is no tensor named '"<<_names[i]<<"' in the network file";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      holes.push_back(it->second);
+    }
+    if(_names.empty())
+      for(size_t t = 0; t < leafs.size(); t++)
+        holes.push_back(t);
+    if(!load)
+      construct();
+    if(root->T != NULL){
+      std::ostringstream err;
+      err<<"The network of a single tensor has no environment.";
+      throw std::runtime_error(exception_msg(err.str()));
+    }
+    addSwaps();
+    // Only the nodes above the tensors asked for need their environments.
+    std::set<Node*> wanted;
+    for(size_t h = 0; h < holes.size(); h++)
+      for(Node* nd = leafs[holes[h]]; nd != NULL && wanted.insert(nd).second; nd = nd->parent);
+    std::map<Node*, UniTensor> inside, envs;
+    _outside(root, UniTensor(), inside, wanted, envs);
+
+    const std::vector<int>& outLabels = label_arr.back();
+    std::vector<UniTensor> results;
+    for(size_t h = 0; h < holes.size(); h++){
+      size_t t = holes[h];
+      UniTensor env = envs[leafs[t]];
+      // The out-going bonds of the tensor, its in-coming bonds, then the bonds of TOUT on the other tensors.
+      std::vector<int> rows, cols;
+      for(size_t l = 0; l < label_arr[t].size(); l++)
+        if(std::find(outLabels.begin(), outLabels.end(), label_arr[t][l]) == outLabels.end())
+          (l < (size_t)Rnums[t] ? cols : rows).push_back(label_arr[t][l]);
+      std::vector<int> labels = concat(rows, cols);
+      for(size_t l = 0; l < outLabels.size(); l++)
+        if(std::find(label_arr[t].begin(), label_arr[t].end(), outLabels[l]) == label_arr[t].end())
+          labels.push_back(outLabels[l]);
+      if(labels.size())
+        env.permute(labels, rows.size());
+      env.setName(names[t]);
+      results.push_back(env);
+    }
+    return results;
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function Network::environments(std::vector<std::string>&):");
+    return std::vector<UniTensor>();
+  }
+}
+
+UniTensor Network::merge(Node* nd){
+  const UniTensor* kept = cacheFind(nd);
+  if(kept != NULL)
+    return *kept;
+  // The const contract() packs its operands, the tensors held by the network keep their layout.
+  UniTensor lftT, rhtT;
+  if(rightFirst.count(nd)){
+    rhtT = nd->right->T ? *(nd->right->T) : merge(nd->right);
+    lftT = nd->left->T ? *(nd->left->T) : merge(nd->left);
+  }
+  else{
+    lftT = nd->left->T ? *(nd->left->T) : merge(nd->left);
+    rhtT = nd->right->T ? *(nd->right->T) : merge(nd->right);
+  }
+  UniTensor T = contract(lftT, rhtT);
+  cacheKeep(nd, T);
+  return T;
+}
+
+void Network::setCache(size_t memCap){
+  try{
+    cacheCap = memCap;
+    cacheEvict(cacheCap);
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function Network::setCache(size_t):");
+  }
+}
+
+const UniTensor* Network::cacheFind(Node* nd){
+  std::map<Node*, std::pair<UniTensor*, size_t> >::iterator it = cached.find(nd);
+  if(it == cached.end())
+    return NULL;
+  it->second.second = ++cacheStamp;
+  return it->second.first;
+}
+
+void Network::cacheKeep(Node* nd, const UniTensor& T){
+  size_t bytes = elemBytes(T);
+  if(cacheCap == 0 || bytes > cacheCap)
+    return;
+  cacheEvict(cacheCap - bytes);
+  // The kept copy shares the elements of the result until either is modified.
+  cached[nd] = std::make_pair(new UniTensor(T), ++cacheStamp);
+  cacheBytes += bytes;
+}
+
+void Network::cacheEvict(size_t bytes){
+  while(cacheBytes > bytes){	//least recently used first
+    std::map<Node*, std::pair<UniTensor*, size_t> >::iterator lru = cached.begin();
+    for(std::map<Node*, std::pair<UniTensor*, size_t> >::iterator it = cached.begin(); it != cached.end(); ++it)
+      if(it->second.second < lru->second.second)
+        lru = it;
+    cacheBytes -= elemBytes(*(lru->second.first));
+    delete lru->second.first;
+    cached.erase(lru);
+  }
+}
+
+void Network::cacheDrop(Node* nd){
+  for(; nd != NULL; nd = nd->parent){
+    std::map<Node*, std::pair<UniTensor*, size_t> >::iterator it = cached.find(nd);
+    if(it != cached.end()){
+      cacheBytes -= elemBytes(*(it->second.first));
+      delete it->second.first;
+      cached.erase(it);
     }
   }
+}
+
+void Network::cacheClear(){
+  cacheEvict(0);
+}
+
+void Network::setMemoryLimit(size_t bytes){
+  try{
+    memLimit = bytes;
+    if(autoOrder && load)
+      destruct();	//search again within the limit at the next construction
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function Network::setMemoryLimit(size_t):");
+  }
+}
+
+size_t Network::_live_bytes(Node* nd, bool& complex, Node*& worst, size_t& worstBytes){
+  // Peak bytes of the intermediate tensors while the subtree of nd is contracted, the tensors put are not counted.
+  if(nd->T != NULL){
+    complex = nd->T->typeID() == 2;
+    return 0;
+  }
+  bool lftC, rhtC;
+  size_t lftPeak = _live_bytes(nd->left, lftC, worst, worstBytes);
+  size_t rhtPeak = _live_bytes(nd->right, rhtC, worst, worstBytes);
+  complex = lftC || rhtC;
+  size_t elemSize = complex ? sizeof(Complex) : sizeof(Real);
+  size_t lftBytes = nd->left->T ? 0 : nd->left->elemNum * (lftC ? sizeof(Complex) : sizeof(Real));
+  size_t rhtBytes = nd->right->T ? 0 : nd->right->elemNum * (rhtC ? sizeof(Complex) : sizeof(Real));
+  // The operands, the packed copies of the operands which are permuted and the result.
+  size_t work = lftBytes + rhtBytes + (nd->elemNum + (size_t)nd->left->cost(nd->right).traffic) * elemSize;
+  if(work > worstBytes){
+    worst = nd;
+    worstBytes = work;
+  }
+  // The operand computed first is held while the other one is computed.
+  size_t lftFirst = std::max(lftPeak, lftBytes + rhtPeak);
+  size_t rhtFirst = std::max(rhtPeak, rhtBytes + lftPeak);
+  if(rhtFirst < lftFirst)
+    rightFirst.insert(nd);
+  else
+    rightFirst.erase(nd);
+  return std::max(std::min(lftFirst, rhtFirst), work);
+}
+
+void Network::checkMemory(){
+  size_t given = 0;
+  bool complex = false;
+  for(size_t t = 0; t < tensors.size(); t++){
+    given += elemBytes(*tensors[t]);
+    complex = complex || tensors[t]->typeID() == 2;
+  }
+  Node* worst = root;
+  size_t worstBytes = 0;
+  size_t live;
+  if(slices.size()){
+    // Every slice running holds sliced copies of the tensors put, its intermediate tensors and its result, the sum
+    // of the slices is one more result.
+    size_t result = root->elemNum * (complex ? sizeof(Complex) : sizeof(Real));
+    size_t one = _slice_bytes(root, complex) + result;
+    for(size_t t = 0; t < leafs.size(); t++)
+      one += slicedBytes(leafs[t], tensors[t]->typeID() == 2);
+    live = sliceConcurrency() * one + result;
+  }
+  else if(plan)
+    live = planBytes();
   else{
-    if(nd->right->T == NULL){
-      UniTensor rhtT = merge(nd->right);
-      return contract(*(nd->left->T), rhtT, true);
+    live = _live_bytes(root, complex, worst, worstBytes);
+    // The result is permuted to the labels of TOUT.
+    live += root->elemNum * (complex ? sizeof(Complex) : sizeof(Real));
+  }
+  size_t need = given + live + (slices.size() ? 0 : cacheCap);
+  if(need > memLimit){
+    std::ostringstream err;
+    err<<"Contracting the network needs "<<need<<" bytes, above the limit of "<<memLimit<<" bytes:";
+    err<<"\n  tensors put: "<<given<<" bytes";
+    err<<"\n  intermediate tensors: "<<live<<" bytes";
+    if(slices.size())
+      err<<" in "<<sliceConcurrency()<<" of "<<sliceNum()<<" slices at a time";
+    else if(plan)
+      err<<" in the buffers of the compiled contractions";
+    else if(worst->left != NULL){
+      err<<", at most "<<worstBytes<<" while contracting to the tensor with labels";
+      for(size_t l = 0; l < worst->labels.size(); l++)
+        err<<(l ? ", " : " ")<<worst->labels[l];
     }
-    else{
-      return contract(*(nd->left->T), *(nd->right->T), true);
+    if(cacheCap && slices.empty())
+      err<<"\n  kept tensors: "<<cacheCap<<" bytes, see setCache()";
+    if(slices.size())
+      err<<"\n  Hint: Lower the target of setSlicing() to contract the network in more, smaller slices.";
+    else
+      err<<"\n  Hint: Use optimizeOrder() after setMemoryLimit() to avoid the largest intermediate tensors.";
+    throw std::runtime_error(exception_msg(err.str()));
+  }
+}
+
+void Network::setSlicing(size_t memTarget){
+  try{
+    sliceTarget = memTarget;
+    slices.clear();
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function Network::setSlicing(size_t):");
+  }
+}
+
+void Network::chooseSlices(){
+  slices.clear();
+  // Labels summed over between two tensors without symmetry.
+  std::map<int, int> count;
+  std::set<int> fixed(label_arr.back().begin(), label_arr.back().end());
+  bool complex = false;
+  for(size_t t = 0; t < leafs.size(); t++){
+    bool dense = !tensors[t]->ongpu && trivialBonds(tensors[t]->bonds);
+    const std::vector<int>& lbs = leafs[t]->labels;
+    for(size_t l = 0; l < lbs.size(); l++){
+      count[lbs[l]]++;
+      if(!dense || std::count(lbs.begin(), lbs.end(), lbs[l]) > 1)
+        fixed.insert(lbs[l]);
     }
+    complex = complex || tensors[t]->typeID() == 2;
   }
+  // The result of the network is not sliced.
+  std::vector<Node*> nodes;
+  std::vector<Node*> stack(1, root);
+  while(stack.size()){
+    Node* nd = stack.back();
+    stack.pop_back();
+    if(nd->T == NULL){
+      if(nd != root)
+        nodes.push_back(nd);
+      stack.push_back(nd->left);
+      stack.push_back(nd->right);
+    }
+  }
+  while(true){
+    // The slices running at the same time share the target.
+    size_t peak = _slice_bytes(root, complex);
+    if(peak * sliceConcurrency() <= sliceTarget)
+      return;
+    // Halve the largest intermediate tensor of a slice along its largest summed bond.
+    Node* big = NULL;
+    size_t bigBytes = 0;
+    for(size_t i = 0; i < nodes.size(); i++){
+      size_t bytes = slicedBytes(nodes[i], complex);
+      if(bytes > bigBytes){
+        big = nodes[i];
+        bigBytes = bytes;
+      }
+    }
+    if(big == NULL)
+      return;
+    int label = 0, piece = 1;
+    for(size_t l = 0; l < big->labels.size(); l++){
+      int lb = big->labels[l];
+      if(count[lb] != 2 || fixed.count(lb))
+        continue;
+      int dim = big->bonds[l].dim();
+      int pieces = slices.count(lb) ? slices[lb] : 1;
+      if((dim + pieces - 1) / pieces > piece){
+        label = lb;
+        piece = (dim + pieces - 1) / pieces;
+      }
+    }
+    if(piece == 1){
+      std::ostringstream err;
+      err<<"The intermediate tensors of "<<sliceConcurrency()<<" slices at a time take "<<peak * sliceConcurrency();
+      err<<" bytes, above the target of "<<sliceTarget<<" bytes. The largest one, with labels";
+      for(size_t l = 0; l < big->labels.size(); l++)
+        err<<(l ? ", " : " ")<<big->labels[l];
+      err<<", takes "<<bigBytes<<" bytes in each slice.";
+      err<<"\n  Hint: Only the bonds summed over between tensors without symmetry are sliced.";
+      throw std::runtime_error(exception_msg(err.str()));
+    }
+    for(size_t l = 0; l < big->labels.size(); l++)
+      if(big->labels[l] == label)
+        slices[label] = std::min(big->bonds[l].dim(), 2 * (slices.count(label) ? slices[label] : 1));
+  }
+}
+
+size_t Network::sliceNum()const{
+  size_t num = 1;
+  for(std::map<int, int>::const_iterator it = slices.begin(); it != slices.end(); ++it)
+    num *= it->second;
+  return num;
+}
+
+size_t Network::sliceConcurrency()const{
+  // One slice per thread.
+  return std::min(sliceNum(), (size_t)getThreadNum());
+}
+
+size_t Network::slicedBytes(Node* nd, bool complex)const{
+  size_t bytes = complex ? sizeof(Complex) : sizeof(Real);
+  for(size_t l = 0; l < nd->labels.size(); l++){
+    std::map<int, int>::const_iterator it = slices.find(nd->labels[l]);
+    size_t dim = nd->bonds[l].dim();
+    bytes *= it == slices.end() ? dim : (dim + it->second - 1) / it->second;
+  }
+  return bytes;
+}
+
+size_t Network::_slice_bytes(Node* nd, bool complex)const{
+  // Peak bytes of the intermediate tensors of one slice while mergeGiven() contracts the subtree of nd, left first.
+  // The sliced copies of the tensors put and the result of the network are not counted.
+  if(nd->T != NULL)
+    return 0;
+  size_t lftBytes = nd->left->T ? 0 : slicedBytes(nd->left, complex);
+  size_t rhtBytes = nd->right->T ? 0 : slicedBytes(nd->right, complex);
+  size_t work = lftBytes + rhtBytes + (nd == root ? 0 : slicedBytes(nd, complex));
+  return std::max(std::max(_slice_bytes(nd->left, complex), lftBytes + _slice_bytes(nd->right, complex)), work);
+}
+
+UniTensor Network::sliceBond(const UniTensor& T, int b, size_t lo, size_t hi){
+  // The tensor without symmetry whose b-th index is restricted to [lo, hi).
+  std::vector<Bond> bonds = T.bonds;
+  size_t outer = 1, inner = 1, dim = bonds[b].dim();
+  for(size_t i = 0; i < bonds.size(); i++)
+    if(i < (size_t)b)
+      outer *= bonds[i].dim();
+    else if(i > (size_t)b)
+      inner *= bonds[i].dim();
+  bonds[b] = Bond(bonds[b].type(), hi - lo);
+  std::vector<int> labels = T.labels;
+  bool complex = T.typeID() == 2;
+  UniTensor S = complex ? UniTensor(CTYPE, bonds, labels, T.name) : UniTensor(RTYPE, bonds, labels, T.name);
+  if(complex)
+    copyRange(T.c_elem, S.c_elem, outer, dim, inner, lo, hi);
+  else
+    copyRange(T.elem, S.elem, outer, dim, inner, lo, hi);
+  S.status |= S.HAVEELEM;
+  return S;
+}
+
+UniTensor Network::mergeGiven(Node* nd, const std::map<Node*, const UniTensor*>& given){
+  std::map<Node*, const UniTensor*>::const_iterator it = given.find(nd);
+  if(it != given.end())
+    return *(it->second);
+  const UniTensor lftT = mergeGiven(nd->left, given);
+  const UniTensor rhtT = mergeGiven(nd->right, given);
+  return contract(lftT, rhtT);
+}
+
+UniTensor Network::launchSlices(){
+  std::vector<int> labels, pieces;
+  for(std::map<int, int>::const_iterator it = slices.begin(); it != slices.end(); ++it){
+    labels.push_back(it->first);
+    pieces.push_back(it->second);
+  }
+  size_t num = sliceNum();
+  size_t conc = sliceConcurrency();
+  int blasNum = std::max(1, getThreadNum() / (int)conc);
+  BlasThreads blas(blasNum);
+  // conc slices at a time, summed in the order of their index so that the rounding does not depend on the schedule.
+  UniTensor sum;
+  std::vector<UniTensor> results(conc);
+  for(size_t start = 0; start < num; start += conc){
+    size_t batch = std::min(conc, num - start);
+    parallelFor(batch, [&](size_t i){
+      BlasThreads local(blasNum);
+      // The s-th combination of the pieces, the first label varying fastest.
+      size_t s = start + i;
+      std::vector<UniTensor> parts(leafs.size());
+      std::map<Node*, const UniTensor*> given;
+      for(size_t t = 0; t < leafs.size(); t++){
+        parts[t] = *(tensors[t]);
+        size_t rem = s;
+        for(size_t l = 0; l < labels.size(); l++){
+          size_t pc = rem % pieces[l];
+          rem /= pieces[l];
+          std::vector<int>::const_iterator pos = std::find(parts[t].labels.begin(), parts[t].labels.end(), labels[l]);
+          if(pos == parts[t].labels.end())
+            continue;
+          int b = pos - parts[t].labels.begin();
+          size_t dim = parts[t].bonds[b].dim();
+          parts[t] = sliceBond(parts[t], b, pc * dim / pieces[l], (pc + 1) * dim / pieces[l]);
+        }
+        given[leafs[t]] = &parts[t];
+      }
+      results[i] = mergeGiven(root, given);
+    });
+    for(size_t i = 0; i < batch; i++){
+      if(start + i == 0)
+        sum = results[i];
+      else
+        sum += results[i];
+      results[i] = UniTensor();
+    }
+  }
+  return sum;
+}
+
+void Network::setParallel(int num, size_t memBudget){
+  try{
+    if(num < 0){
+      std::ostringstream err;
+      err<<"The number of concurrent contractions cannot be negative, got "<<num<<".";
+      throw std::runtime_error(exception_msg(err.str()));
+    }
+    parallelNum = num;
+    parallelBudget = memBudget;
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function Network::setParallel(int, size_t):");
+  }
+}
+
+UniTensor Network::mergeParallel(){
+  const UniTensor* kept = cacheFind(root);
+  if(kept != NULL)
+    return *kept;
+  // The pair-wise contractions children first, a contraction is ready once its operands are. The given operands
+  // are the tensors put into the network and the intermediate tensors kept from the previous launch.
+  std::map<Node*, const UniTensor*> given;  //read only while the contractions run
+  for(size_t i = 0; i < leafs.size(); i++)
+    given[leafs[i]] = leafs[i]->T;
+  std::vector<Node*> tasks;
+  std::vector<Node*> stack(1, root);
+  while(stack.size()){
+    Node* nd = stack.back();
+    stack.pop_back();
+    if(given.find(nd) == given.end() && (kept = cacheFind(nd)) != NULL)
+      given[nd] = kept;
+    else if(nd->T == NULL){
+      tasks.push_back(nd);
+      stack.push_back(nd->left);
+      stack.push_back(nd->right);
+    }
+  }
+  std::reverse(tasks.begin(), tasks.end());
+  // At most as many contractions run at once as there are contractions of two given tensors.
+  int width = 0;
+  size_t elemNum = 0;
+  for(size_t i = 0; i < tasks.size(); i++){
+    if(given.count(tasks[i]->left) && given.count(tasks[i]->right))
+      width++;
+    elemNum += tasks[i]->elemNum;
+  }
+  int workers = std::min(parallelNum ? parallelNum : getThreadNum(), width);
+  if(workers < 2 || elemNum < PARALLEL_MERGE_MIN)
+    return merge(root);
+
+  std::map<Node*, size_t> ids;   //read only while the contractions run
+  for(size_t i = 0; i < tasks.size(); i++)
+    ids[tasks[i]] = i;
+  // Bytes of each intermediate tensor, complex once one of its operands is.
+  std::vector<bool> complex(tasks.size(), false);
+  std::vector<size_t> bytes(tasks.size(), 0);
+  for(size_t i = 0; i < tasks.size(); i++){
+    Node* opds[2] = {tasks[i]->left, tasks[i]->right};
+    for(int o = 0; o < 2; o++){
+      std::map<Node*, const UniTensor*>::const_iterator it = given.find(opds[o]);
+      if(it != given.end() ? it->second->typeID() == 2 : complex[ids.find(opds[o])->second])
+        complex[i] = true;
+    }
+    bytes[i] = tasks[i]->elemNum * (complex[i] ? sizeof(Complex) : sizeof(Real));
+  }
+  // Results which fit into the cache are handed to it once all the contractions are done, until then they stay
+  // held and count against the budget.
+  std::vector<bool> keep(tasks.size(), false);
+  for(size_t i = 0; i < tasks.size(); i++)
+    keep[i] = cacheCap && bytes[i] <= cacheCap;
+  std::vector<int> pending(tasks.size(), 0);
+  std::deque<size_t> ready;
+  for(size_t i = 0; i < tasks.size(); i++){
+    pending[i] = !given.count(tasks[i]->left) + !given.count(tasks[i]->right);
+    if(pending[i] == 0)
+      ready.push_back(i);
+  }
+  std::vector<UniTensor> results(tasks.size());
+  std::mutex lock;
+  std::condition_variable cv;
+  size_t left = tasks.size();
+  int running = 0;
+  size_t live = 0;  //bytes of the intermediate tensors held, kept or being computed
+  bool failed = false;
+  int blasNum = std::max(1, getThreadNum() / workers);
+  BlasThreads blas(blasNum);
+  parallelFor(workers, [&](size_t){
+    BlasThreads local(blasNum);
+    std::unique_lock<std::mutex> lk(lock);
+    while(left && !failed){
+      if(ready.empty() || (running && parallelBudget && live + bytes[ready.front()] > parallelBudget)){
+        cv.wait(lk);
+        continue;
+      }
+      size_t id = ready.front();
+      ready.pop_front();
+      Node* nd = tasks[id];
+      running++;
+      live += bytes[id];
+      lk.unlock();
+      try{
+        // The const contract() packs its operands, the tensors held by the network keep their layout.
+        std::map<Node*, const UniTensor*>::const_iterator lft = given.find(nd->left), rht = given.find(nd->right);
+        const UniTensor& lftT = lft != given.end() ? *(lft->second) : results[ids.find(nd->left)->second];
+        const UniTensor& rhtT = rht != given.end() ? *(rht->second) : results[ids.find(nd->right)->second];
+        results[id] = contract(lftT, rhtT);
+        if(lft == given.end() && !keep[ids.find(nd->left)->second])
+          results[ids.find(nd->left)->second] = UniTensor();
+        if(rht == given.end() && !keep[ids.find(nd->right)->second])
+          results[ids.find(nd->right)->second] = UniTensor();
+      }
+      catch(...){
+        lk.lock();
+        failed = true;
+        cv.notify_all();
+        throw;
+      }
+      lk.lock();
+      running--;
+      left--;
+      if(!given.count(nd->left) && !keep[ids.find(nd->left)->second])
+        live -= bytes[ids.find(nd->left)->second];
+      if(!given.count(nd->right) && !keep[ids.find(nd->right)->second])
+        live -= bytes[ids.find(nd->right)->second];
+      if(nd->parent != NULL && --pending[ids.find(nd->parent)->second] == 0)
+        ready.push_back(ids.find(nd->parent)->second);
+      cv.notify_all();
+    }
+  });
+  for(size_t i = 0; i < tasks.size(); i++)
+    cacheKeep(tasks[i], results[i]);
+  return results.back();
 }
 
 Network::~Network(){
@@ -807,6 +1593,24 @@ size_t Network::max_tensor_elemNum(){
   return max_num;
 }
 
+void Network::_contract_cost(Node* nd, _ContractCost& total, double& dense) const{
+  if(nd == NULL || nd->left == NULL)
+    return;
+  _contract_cost(nd->left, total, dense);
+  _contract_cost(nd->right, total, dense);
+  _ContractCost c = nd->left->cost(nd->right);
+  total.flops += c.flops;
+  total.traffic += c.traffic;
+  total.elemNum += c.elemNum;
+  double flops = 1;
+  for(size_t a = 0; a < nd->left->labels.size(); a++)
+    flops *= nd->left->bonds[a].dim();
+  for(size_t b = 0; b < nd->right->labels.size(); b++)
+    if(std::find(nd->left->labels.begin(), nd->left->labels.end(), nd->right->labels[b]) == nd->left->labels.end())
+      flops *= nd->right->bonds[b].dim();
+  dense += flops;
+}
+
 void Network::_max_tensor_elemNum(Node* nd, size_t& max_num, Node& max_nd) const{
   if(nd == NULL)
     return;
@@ -833,6 +1637,18 @@ std::string Network::profile(bool print){
     os<<"\n===== Network profile =====\n";
     os<<"Memory Requirement: "<<memory_requirement()<<std::endl;
     //os<<"Sum of memory usage: "<<sum_of_memory_usage()<<std::endl;
+    _ContractCost cost = {0, 0, 0};
+    double dense = 0;
+    _contract_cost(root, cost, dense);
+    os<<"Multiply-adds: "<<cost.flops<<" (dense bonds: "<<dense<<")"<<std::endl;
+    os<<"Permutation traffic: "<<cost.traffic<<std::endl;
+    if(sliceTarget){
+      chooseSlices();
+      os<<"Sliced bonds:";
+      for(std::map<int, int>::const_iterator it = slices.begin(); it != slices.end(); ++it)
+        os<<(it == slices.begin() ? " " : ", ")<<it->first<<" in "<<it->second<<" pieces";
+      os<<std::endl;
+    }
     size_t max_num = 0;
     Node max_nd;
     _max_tensor_elemNum(root, max_num, max_nd);
@@ -0,0 +1,452 @@
+/****************************************************************************
+*  @file NetworkOrder.cpp
+*  @license
+*    Universal Tensor Network Library
+*    Copyright (c) 2013-2016
+*    National Taiwan University
+*    National Tsing-Hua University
+*
+*    This file is part of Uni10, the Universal Tensor Network Library.
+*
+*    Uni10 is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU Lesser General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    Uni10 is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public License
+*    along with Uni10.  If not, see <http://www.gnu.org/licenses/>.
+*  @endlicense
+*  @brief Search for the pair-wise contraction order of Network
+*  @author Ying-Jer Kao
+*  @date 2016-06-06
+*  @since 1.0.0
+*
+*****************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <uni10/tools/uni10_tools.h>
+#include <uni10/tensor-network/UniTensor.h>
+#include <uni10/tensor-network/Network.h>
+
+namespace uni10{
+
+namespace {
+
+// Networks up to this many tensors are searched exhaustively, 3^n pairs of subsets are visited.
+const int ORDER_DP_MAX = 14;
+// Same for networks with symmetric bonds, whose pairs are costed sector by sector.
+const int ORDER_DP_SECTOR_MAX = 10;
+// The branch and bound search keeps the tensors merged so far as bit masks.
+const int ORDER_BRANCH_MAX = 64;
+// Visited states remembered by the branch and bound search.
+const size_t ORDER_MEMO_MAX = 1 << 20;
+
+typedef std::vector<int> Legs;  // sorted legs of the open labels of a tensor, leg 2 * label + i is on the i-th tensor of label
+typedef std::vector< std::pair<int, int> > Path;
+
+struct OrderCost{
+  OrderCost(double _flops = 0, double _peak = 0, int _over = 0): flops(_flops), peak(_peak), over(_over){}
+  double flops;   // multiply-adds of the pair-wise contractions
+  double peak;    // elements of the largest intermediate tensor
+  int over;       // intermediate tensors above the size cap, fewer is cheaper whatever the multiply-adds
+  bool operator<(const OrderCost& c)const{
+    return over < c.over || (over == c.over && (flops < c.flops || (flops == c.flops && peak < c.peak)));
+  }
+};
+
+// Cost of the pair-wise contractions, see Node::cost().
+struct LegModel{
+  std::vector<double> dims;   // dimension of each label
+  std::vector<Bond> bonds;    // bond of each leg as given in its tensor
+  bool dense;                 // single sector bonds, the cost is the product of the dimensions
+  double sizeCap;             // elements of an intermediate tensor within the memory limit, 0 for no limit
+
+  int over(double size)const{
+    return sizeCap > 0 && size > sizeCap;
+  }
+
+  // Contracts the open legs of two tensors, returns the number of multiply-adds and the size of the result.
+  double merge(const Legs& a, const Legs& b, Legs& c, double& size)const{
+    double flops = 1;
+    size = 1;
+    c.clear();
+    std::map<Qnum, double> rows, inner, cols;
+    if(!dense){
+      rows[Qnum()] = 1;
+      inner[Qnum()] = 1;
+      cols[Qnum()] = 1;
+    }
+    size_t i = 0, j = 0;
+    while(i < a.size() || j < b.size()){
+      if(j == b.size() || (i < a.size() && a[i] / 2 < b[j] / 2)){
+        if(dense){
+          flops *= dims[a[i] / 2];
+          size *= dims[a[i] / 2];
+        }
+        else
+          Node::addSectors(rows, bonds[a[i]], BD_IN);
+        c.push_back(a[i++]);
+      }
+      else if(i == a.size() || b[j] / 2 < a[i] / 2){
+        if(dense){
+          flops *= dims[b[j] / 2];
+          size *= dims[b[j] / 2];
+        }
+        else
+          Node::addSectors(cols, bonds[b[j]], BD_OUT);
+        c.push_back(b[j++]);
+      }
+      else{
+        if(dense)
+          flops *= dims[a[i] / 2];
+        else
+          Node::addSectors(inner, bonds[a[i]], BD_OUT);
+        i++;
+        j++;
+      }
+    }
+    if(!dense)
+      flops = Node::sectorCost(rows, inner, cols, size);
+    return flops;
+  }
+};
+
+bool connected(const Legs& a, const Legs& b){
+  size_t i = 0, j = 0;
+  while(i < a.size() && j < b.size()){
+    if(a[i] / 2 == b[j] / 2)
+      return true;
+    a[i] / 2 < b[j] / 2 ? i++ : j++;
+  }
+  return false;
+}
+
+OrderCost searchDP(const LegModel& model, const std::vector<Legs>& legs, Path& path){
+  int n = legs.size();
+  size_t full = ((size_t)1 << n) - 1;
+  std::vector<Legs> open(full + 1);
+  std::vector<double> size(full + 1, 1);
+  std::vector<OrderCost> best(full + 1);
+  std::vector<size_t> split(full + 1, 0);
+  Legs c;
+  for(size_t S = 1; S <= full; S++){
+    size_t low = S & (~S + 1);
+    if(S == low){
+      int t = 0;
+      while(((size_t)1 << t) != S)
+        t++;
+      open[S] = legs[t];
+      continue;
+    }
+    model.merge(open[low], open[S ^ low], open[S], size[S]);
+    bool found = false;
+    // A holds the lowest tensor of S, so that each pair of subsets is visited once.
+    for(size_t A = (S - 1) & S; A; A = (A - 1) & S){
+      if(!(A & low))
+        continue;
+      size_t B = S ^ A;
+      double csize;
+      double flops = model.merge(open[A], open[B], c, csize);
+      OrderCost cost(best[A].flops + best[B].flops + flops, std::max(std::max(best[A].peak, best[B].peak), size[S]), best[A].over + best[B].over + model.over(size[S]));
+      if(!found || cost < best[S]){
+        best[S] = cost;
+        split[S] = A;
+        found = true;
+      }
+    }
+  }
+  // Rebuild the pair-wise contractions from the best splits.
+  std::vector<size_t> stack(1, full);
+  std::vector<size_t> post;
+  while(stack.size()){
+    size_t S = stack.back();
+    stack.pop_back();
+    post.push_back(S);
+    if(split[S]){
+      stack.push_back(split[S]);
+      stack.push_back(S ^ split[S]);
+    }
+  }
+  std::map<size_t, int> ids;
+  for(int t = 0; t < n; t++)
+    ids[(size_t)1 << t] = t;
+  path.clear();
+  for(size_t i = post.size(); i-- > 0;){
+    size_t S = post[i];
+    if(split[S]){
+      path.push_back(std::make_pair(ids[split[S]], ids[S ^ split[S]]));
+      ids[S] = n + path.size() - 1;
+    }
+  }
+  return best[full];
+}
+
+OrderCost searchGreedy(const LegModel& model, const std::vector<Legs>& legs, Path& path){
+  std::vector<Legs> cur(legs);
+  std::vector<int> ids(legs.size());
+  for(size_t t = 0; t < ids.size(); t++)
+    ids[t] = t;
+  path.clear();
+  OrderCost cost;
+  Legs c;
+  while(cur.size() > 1){
+    bool any = false;
+    for(size_t i = 0; i < cur.size() && !any; i++)
+      for(size_t j = i + 1; j < cur.size() && !any; j++)
+        any = connected(cur[i], cur[j]);
+    size_t bi = 0, bj = 1;
+    OrderCost bestPair;
+    bool found = false;
+    for(size_t i = 0; i < cur.size(); i++)
+      for(size_t j = i + 1; j < cur.size(); j++){
+        if(any && !connected(cur[i], cur[j]))
+          continue;
+        double size;
+        double flops = model.merge(cur[i], cur[j], c, size);
+        OrderCost pair(flops, size, model.over(size));
+        if(!found || pair < bestPair){
+          bestPair = pair;
+          bi = i;
+          bj = j;
+          found = true;
+        }
+      }
+    double size;
+    model.merge(cur[bi], cur[bj], c, size);
+    cost.flops += bestPair.flops;
+    cost.peak = std::max(cost.peak, size);
+    cost.over += bestPair.over;
+    path.push_back(std::make_pair(ids[bi], ids[bj]));
+    cur[bi] = c;
+    ids[bi] = legs.size() + path.size() - 1;
+    cur.erase(cur.begin() + bj);
+    ids.erase(ids.begin() + bj);
+  }
+  return cost;
+}
+
+struct BranchSearch{
+  BranchSearch(const LegModel& _model, size_t _leafNum, double timeLimit): model(_model), leafNum(_leafNum), limit(timeLimit), start(std::chrono::steady_clock::now()){}
+  const LegModel& model;
+  size_t leafNum;
+  double limit;
+  std::chrono::steady_clock::time_point start;
+  OrderCost best;
+  Path bestPath;
+  std::map<std::vector<uint64_t>, OrderCost> memo;
+  bool expired(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > limit;
+  }
+  void search(std::vector<Legs>& cur, std::vector<uint64_t>& masks, std::vector<int>& ids, const OrderCost& cost, Path& path){
+    if(cur.size() == 1){
+      if(cost < best){
+        best = cost;
+        bestPath = path;
+      }
+      return;
+    }
+    if(expired())
+      return;
+    std::vector<uint64_t> key(masks);
+    std::sort(key.begin(), key.end());
+    std::map<std::vector<uint64_t>, OrderCost>::iterator it = memo.find(key);
+    if(it != memo.end()){
+      if(!(cost < it->second))
+        return;
+      it->second = cost;
+    }
+    else if(memo.size() < ORDER_MEMO_MAX)
+      memo[key] = cost;
+
+    bool any = false;
+    for(size_t i = 0; i < cur.size() && !any; i++)
+      for(size_t j = i + 1; j < cur.size() && !any; j++)
+        any = connected(cur[i], cur[j]);
+    // Cheaper pairs first, so that good orders tighten the bound early.
+    std::vector< std::pair<OrderCost, std::pair<size_t, size_t> > > pairs;
+    Legs c;
+    for(size_t i = 0; i < cur.size(); i++)
+      for(size_t j = i + 1; j < cur.size(); j++){
+        if(any && !connected(cur[i], cur[j]))
+          continue;
+        double size;
+        double flops = model.merge(cur[i], cur[j], c, size);
+        pairs.push_back(std::make_pair(OrderCost(flops, size, model.over(size)), std::make_pair(i, j)));
+      }
+    std::stable_sort(pairs.begin(), pairs.end(), pairLess);
+    for(size_t p = 0; p < pairs.size(); p++){
+      size_t i = pairs[p].second.first, j = pairs[p].second.second;
+      OrderCost next(cost.flops + pairs[p].first.flops, std::max(cost.peak, pairs[p].first.peak), cost.over + pairs[p].first.over);
+      // Costs only grow with further contractions.
+      if(!(next < best))
+        continue;
+      double size;
+      Legs li = cur[i], lj = cur[j];
+      uint64_t mi = masks[i], mj = masks[j];
+      int idi = ids[i], idj = ids[j];
+      model.merge(li, lj, cur[i], size);
+      masks[i] = mi | mj;
+      path.push_back(std::make_pair(idi, idj));
+      ids[i] = leafNum + path.size() - 1;
+      cur.erase(cur.begin() + j);
+      masks.erase(masks.begin() + j);
+      ids.erase(ids.begin() + j);
+      search(cur, masks, ids, next, path);
+      path.pop_back();
+      cur.insert(cur.begin() + j, lj);
+      masks.insert(masks.begin() + j, mj);
+      ids.insert(ids.begin() + j, idj);
+      cur[i] = li;
+      masks[i] = mi;
+      ids[i] = idi;
+      if(expired())
+        return;
+    }
+  }
+  static bool pairLess(const std::pair<OrderCost, std::pair<size_t, size_t> >& a, const std::pair<OrderCost, std::pair<size_t, size_t> >& b){
+    return a.first < b.first;
+  }
+};
+
+OrderCost searchBranch(const LegModel& model, const std::vector<Legs>& legs, double timeLimit, Path& path){
+  BranchSearch bnb(model, legs.size(), timeLimit);
+  // The greedy order is the first bound, and the answer when no cheaper order is found in time.
+  bnb.best = searchGreedy(model, legs, bnb.bestPath);
+  std::vector<Legs> cur(legs);
+  std::vector<uint64_t> masks(legs.size());
+  std::vector<int> ids(legs.size());
+  for(size_t t = 0; t < legs.size(); t++){
+    masks[t] = (uint64_t)1 << t;
+    ids[t] = t;
+  }
+  Path tmp;
+  bnb.search(cur, masks, ids, OrderCost(), tmp);
+  path = bnb.bestPath;
+  return bnb.best;
+}
+
+}
+
+std::vector< std::pair<int, int> > Network::searchOrder(orderMethod method, double timeLimit){
+  int Tnum = leafs.size();
+  for(int t = 0; t < Tnum; t++)
+    if(leafs[t] == NULL){
+      std::ostringstream err;
+      err<<"Tensor '"<<names[t]<<"' has not yet been given.\n  Hint: Use putTensor() to add a tensor to a network.\n";
+      throw std::runtime_error(exception_msg(err.str()));
+    }
+  std::map<int, int> label2idx;
+  LegModel model;
+  model.dense = true;
+  model.sizeCap = 0;
+  if(memLimit){
+    // An intermediate tensor fits next to the tensors put and the kept ones.
+    size_t given = cacheCap;
+    bool complex = false;
+    for(int t = 0; t < Tnum; t++){
+      given += tensors[t]->elemNum() * (tensors[t]->typeID() == 2 ? sizeof(Complex) : sizeof(Real));
+      complex = complex || tensors[t]->typeID() == 2;
+    }
+    model.sizeCap = given < memLimit ? (double)(memLimit - given) / (complex ? sizeof(Complex) : sizeof(Real)) : 1;
+  }
+  std::vector<Legs> legs(Tnum);
+  for(int t = 0; t < Tnum; t++){
+    for(size_t l = 0; l < leafs[t]->labels.size(); l++){
+      const Bond& bd = leafs[t]->bonds[l];
+      std::map<int, int>::iterator it = label2idx.find(leafs[t]->labels[l]);
+      if(it == label2idx.end()){
+        it = label2idx.insert(std::make_pair(leafs[t]->labels[l], (int)model.dims.size())).first;
+        model.dims.push_back(bd.dim());
+        model.bonds.push_back(bd);
+        model.bonds.push_back(bd);
+        legs[t].push_back(2 * it->second);
+      }
+      else{
+        model.bonds[2 * it->second + 1] = bd;
+        legs[t].push_back(2 * it->second + 1);
+      }
+      if(bd.degeneracy().size() > 1)
+        model.dense = false;
+    }
+    std::sort(legs[t].begin(), legs[t].end());
+  }
+  if(method == ORD_DP && Tnum > ORDER_DP_MAX){
+    std::ostringstream err;
+    err<<"The dynamic programming search is limited to networks of "<<ORDER_DP_MAX<<" tensors.\n  Hint: Use ORD_BRANCH with a time limit.";
+    throw std::runtime_error(exception_msg(err.str()));
+  }
+  if(method == ORD_AUTO)
+    method = Tnum <= (model.dense ? ORDER_DP_MAX : ORDER_DP_SECTOR_MAX) ? ORD_DP : ORD_BRANCH;
+  if(method == ORD_BRANCH && Tnum > ORDER_BRANCH_MAX)
+    method = ORD_GREEDY;
+  Path path;
+  if(method == ORD_DP)
+    searchDP(model, legs, path);
+  else if(method == ORD_BRANCH)
+    searchBranch(model, legs, timeLimit, path);
+  else
+    searchGreedy(model, legs, path);
+  return path;
+}
+
+void Network::setOrder(const std::vector< std::pair<int, int> >& path){
+  // Written as an ORDER line with brackets, each pair-wise contraction is one pair of brackets.
+  int Tnum = leafs.size();
+  std::vector< std::vector<int> > seq(Tnum + path.size());
+  order.clear();
+  brakets.clear();
+  for(int t = 0; t < Tnum; t++)
+    seq[t].push_back(-t - 1);
+  for(size_t p = 0; p < path.size(); p++){
+    std::vector<int>& s = seq[Tnum + p];
+    s.push_back(0);
+    s.insert(s.end(), seq[path[p].first].begin(), seq[path[p].first].end());
+    s.insert(s.end(), seq[path[p].second].begin(), seq[path[p].second].end());
+    s.push_back(Tnum + 1);
+  }
+  const std::vector<int>& all = seq.back();
+  for(size_t i = 0; i < all.size(); i++){
+    if(all[i] < 0){
+      order.push_back(-all[i] - 1);
+      brakets.push_back(0);
+    }
+    else if(all[i] == 0)
+      brakets.push_back(1);
+    else
+      brakets.push_back(-1);
+  }
+}
+
+std::string Network::optimizeOrder(orderMethod method, double timeLimit){
+  try{
+    std::vector< std::pair<int, int> > path = searchOrder(method, timeLimit);
+    if(load)
+      destruct();
+    autoOrder = false;
+    setOrder(path);
+    std::ostringstream os;
+    for(size_t i = 0, cnt = 0; i < brakets.size(); i++){
+      if(brakets[i] > 0)
+        os<<(i && brakets[i-1] <= 0 ? " (" : "(");
+      else if(brakets[i] < 0)
+        os<<")";
+      else{
+        if(i && brakets[i-1] <= 0)
+          os<<" ";
+        os<<names[order[cnt++]];
+      }
+    }
+    return os.str();
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function Network::optimizeOrder(uni10::orderMethod, double):");
+    return "";
+  }
+}
+
+}; /* namespace uni10 */
@@ -0,0 +1,379 @@
+/****************************************************************************
+*  @file NetworkPlan.cpp
+*  @license
+*    Universal Tensor Network Library
+*    Copyright (c) 2013-2016
+*    National Taiwan University
+*    National Tsing-Hua University
+*
+*    This file is part of Uni10, the Universal Tensor Network Library.
+*
+*    Uni10 is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU Lesser General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    Uni10 is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public License
+*    along with Uni10.  If not, see <http://www.gnu.org/licenses/>.
+*  @endlicense
+*  @brief Compiled contractions of Network
+*  @author Ying-Jer Kao
+*  @date 2016-06-06
+*  @since 1.0.0
+*
+*****************************************************************************/
+#include <algorithm>
+#include <uni10/tools/uni10_tools.h>
+#include <uni10/tensor-network/UniTensor.h>
+#include <uni10/tensor-network/Network.h>
+
+namespace uni10{
+
+/// @brief One pair-wise contraction of a compiled Network
+struct _PlanStep{
+  int left;     // operands, a step index or -(t+1) for the t-th tensor of the network
+  int right;
+  bool complex; // the result is CTYPE
+  _ContractLayout lay;
+  std::shared_ptr<const _PermutePlan> packA;  // NULL when the operand is multiplied in place
+  std::shared_ptr<const _PermutePlan> packB;
+  std::vector<_ContractSector> sectors;
+  std::vector< std::pair<size_t, size_t> > zeros; // offset and size of the blocks of the product no GEMM writes
+  std::shared_ptr<const _PermutePlan> post;   // an outer product is permuted after the multiplication
+  size_t rawNum;    // elements of the product
+  size_t elemNum;   // elements of the result
+  int slot;         // buffer of the result in the pool, -1 for the result of the network
+};
+
+/// @brief Element buffer of a compiled Network, taken from the memory pool as network memory
+struct _PlanBuffer{
+  _PlanBuffer(): elem(NULL), bytes(0){}
+  _PlanBuffer(_PlanBuffer&& buf): elem(buf.elem), bytes(buf.bytes){
+    buf.elem = NULL;
+    buf.bytes = 0;
+  }
+  ~_PlanBuffer(){
+    poolFree(elem);
+  }
+  void alloc(size_t _bytes){
+    poolFree(elem);
+    elem = NULL;
+    bytes = 0;
+    if(_bytes)
+      elem = poolAlloc(_bytes, MEM_NETWORK);
+    bytes = _bytes;
+  }
+  void* elem;
+  size_t bytes;
+private:
+  _PlanBuffer(const _PlanBuffer&);
+  _PlanBuffer& operator=(const _PlanBuffer&);
+};
+
+struct _NetworkPlan{
+  std::vector<_PlanStep> steps;   // children before parents
+  UniTensor out;                  // layout of the result of the network
+  std::shared_ptr<const _PermutePlan> outPlan;  // permutes the last step to TOUT, NULL when it is in place
+  // Buffer pool, step results share the slots when their lifetimes do not overlap.
+  std::vector<_PlanBuffer> slots;
+  std::vector<_PlanBuffer> c_slots;
+  _PlanBuffer scratch[3];     // packed A, packed B, product of an outer product
+  _PlanBuffer c_scratch[5];   // same, then the real operands of a complex step cast to complex
+};
+
+namespace {
+
+void reserve(size_t& elemNum, size_t need){
+  elemNum = std::max(elemNum, need);
+}
+
+Real* slotElem(_NetworkPlan& plan, int slot, const Real*){
+  return (Real*)plan.slots[slot].elem;
+}
+
+Complex* slotElem(_NetworkPlan& plan, int slot, const Complex*){
+  return (Complex*)plan.c_slots[slot].elem;
+}
+
+Real* scratchElem(_NetworkPlan& plan, int idx, const Real*){
+  return (Real*)plan.scratch[idx].elem;
+}
+
+Complex* scratchElem(_NetworkPlan& plan, int idx, const Complex*){
+  return (Complex*)plan.c_scratch[idx].elem;
+}
+
+// Picks a free slot for elemNum elements, the smallest one large enough or else the largest one.
+int takeSlot(std::vector<size_t>& caps, std::vector<int>& freeSlots, size_t elemNum){
+  int best = -1;
+  for(size_t i = 0; i < freeSlots.size(); i++){
+    size_t cap = caps[freeSlots[i]];
+    if(best < 0)
+      best = i;
+    else{
+      size_t bcap = caps[freeSlots[best]];
+      if(cap >= elemNum ? (bcap < elemNum || cap < bcap) : (bcap < elemNum && cap > bcap))
+        best = i;
+    }
+  }
+  if(best < 0){
+    caps.push_back(elemNum);
+    return caps.size() - 1;
+  }
+  int slot = freeSlots[best];
+  freeSlots.erase(freeSlots.begin() + best);
+  caps[slot] = std::max(caps[slot], elemNum);
+  return slot;
+}
+
+}
+
+int Network::compileStep(Node* nd, _NetworkPlan& plan, UniTensor& T){
+  if(nd->T){
+    T = *(nd->T);
+    for(size_t t = 0; t < leafs.size(); t++)
+      if(leafs[t] == nd)
+        return -(int)t - 1;
+  }
+  UniTensor Ta, Tb;
+  _PlanStep st;
+  st.left = compileStep(nd->left, plan, Ta);
+  st.right = compileStep(nd->right, plan, Tb);
+  st.complex = Ta.typeID() == 2 || Tb.typeID() == 2;
+  st.lay = UniTensor::contractLayout(Ta, Tb);
+  const std::map<Qnum, Block>* blocksA = &Ta.blocks;
+  const std::map<Qnum, Block>* blocksB = &Tb.blocks;
+  if(st.lay.permA){
+    st.packA = Ta.packPlan(st.lay.labelA, Ta.bonds.size() - st.lay.conBond);
+    blocksA = &st.packA->blocks;
+  }
+  if(st.lay.permB){
+    st.packB = Tb.packPlan(st.lay.labelB, st.lay.conBond);
+    blocksB = &st.packB->blocks;
+  }
+  UniTensor Tc = st.complex ? UniTensor(CTYPE, st.lay.cBonds) : UniTensor(RTYPE, st.lay.cBonds);
+  if(st.lay.cBonds.size())
+    Tc.setLabel(st.lay.labelC);
+  st.sectors = UniTensor::contractSectors(*blocksA, *blocksB, Tc, st.lay);
+  std::set<size_t> covered;
+  for(size_t s = 0; s < st.sectors.size(); s++)
+    covered.insert(st.sectors[s].offC);
+  size_t offset = 0;
+  for(std::map<Qnum, Block>::const_iterator it = Tc.blocks.begin(); it != Tc.blocks.end(); it++){
+    size_t elemNum = it->second.row() * it->second.col();
+    if(elemNum && covered.find(offset) == covered.end())
+      st.zeros.push_back(std::make_pair(offset, elemNum));
+    offset += elemNum;
+  }
+  st.rawNum = Tc.m_elemNum;
+  if(st.lay.conBond == 0){	//Outer product, laid out as by contract()
+    std::vector<int> newLabelC;
+    newLabelC.insert(newLabelC.end(), Ta.labels.begin(), Ta.labels.begin() + Ta.RBondNum);
+    newLabelC.insert(newLabelC.end(), Tb.labels.begin(), Tb.labels.begin() + Tb.RBondNum);
+    newLabelC.insert(newLabelC.end(), Ta.labels.begin() + Ta.RBondNum, Ta.labels.end());
+    newLabelC.insert(newLabelC.end(), Tb.labels.begin() + Tb.RBondNum, Tb.labels.end());
+    st.post = Tc.packPlan(newLabelC, Ta.RBondNum + Tb.RBondNum);
+    T = st.complex ? UniTensor(CTYPE, *st.post, "", false) : UniTensor(RTYPE, *st.post, "", false);
+    T.setLabel(newLabelC);
+  }
+  else
+    T = Tc;
+  st.elemNum = T.m_elemNum;
+  st.slot = -1;
+  plan.steps.push_back(st);
+  return plan.steps.size() - 1;
+}
+
+void Network::compile(){
+  try{
+    MemoryScope scope("Network::compile", MEM_NETWORK);
+    if(!load)
+      construct();
+    compiled = true;
+    plan.reset();
+    for(size_t t = 0; t < tensors.size(); t++){
+      if(tensors[t]->ongpu)
+        return;
+      if(!(tensors[t]->status & tensors[t]->HAVEELEM)){
+        std::ostringstream err;
+        err<<"Cannot compile a network before setting the elements of tensor '"<<names[t]<<"'.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+    }
+    std::shared_ptr<_NetworkPlan> pl(new _NetworkPlan);
+    UniTensor T;
+    compileStep(root, *pl, T);
+    if(pl->steps.empty()){
+      std::ostringstream err;
+      err<<"Cannot compile a network of a single tensor.";
+      throw std::runtime_error(exception_msg(err.str()));
+    }
+    int idx = label_arr.size() - 1;
+    if(label_arr[idx].size() > 1 && !(T.labels == label_arr[idx] && T.RBondNum == Rnums[idx]))
+      pl->outPlan = T.packPlan(label_arr[idx], Rnums[idx]);
+    if(pl->outPlan){
+      pl->out = pl->steps.back().complex ? UniTensor(CTYPE, *pl->outPlan, "", false) : UniTensor(RTYPE, *pl->outPlan, "", false);
+      pl->out.setLabel(label_arr[idx]);
+    }
+    else
+      pl->out = T;
+    pl->out.TelemFree();  //each launch allocates the elements of its result
+    pl->out.status &= ~pl->out.HAVEELEM;
+
+    std::vector<size_t> caps, c_caps;
+    std::vector<int> freeSlots, c_freeSlots;
+    size_t scratchNum[3] = {0, 0, 0};
+    size_t c_scratchNum[5] = {0, 0, 0, 0, 0};
+    for(size_t s = 0; s < pl->steps.size(); s++){
+      _PlanStep& st = pl->steps[s];
+      bool last = s + 1 == pl->steps.size();
+      if(!last || pl->outPlan)
+        st.slot = st.complex ? takeSlot(c_caps, c_freeSlots, st.elemNum) : takeSlot(caps, freeSlots, st.elemNum);
+      int opds[2] = {st.left, st.right};
+      for(int o = 0; o < 2; o++){
+        size_t elemNum;
+        bool complex;
+        if(opds[o] >= 0){
+          const _PlanStep& child = pl->steps[opds[o]];
+          elemNum = child.elemNum;
+          complex = child.complex;
+          //The operand is consumed, its slot is free for the following steps.
+          (complex ? c_freeSlots : freeSlots).push_back(child.slot);
+        }
+        else{
+          elemNum = tensors[-opds[o] - 1]->m_elemNum;
+          complex = tensors[-opds[o] - 1]->typeID() == 2;
+        }
+        if(st.complex && !complex)
+          reserve(c_scratchNum[3 + o], elemNum);
+      }
+      if(st.complex){
+        if(st.packA)
+          reserve(c_scratchNum[0], st.packA->elemNum);
+        if(st.packB)
+          reserve(c_scratchNum[1], st.packB->elemNum);
+        if(st.post)
+          reserve(c_scratchNum[2], st.rawNum);
+      }
+      else{
+        if(st.packA)
+          reserve(scratchNum[0], st.packA->elemNum);
+        if(st.packB)
+          reserve(scratchNum[1], st.packB->elemNum);
+        if(st.post)
+          reserve(scratchNum[2], st.rawNum);
+      }
+    }
+    pl->slots.resize(caps.size());
+    for(size_t i = 0; i < caps.size(); i++)
+      pl->slots[i].alloc(caps[i] * sizeof(Real));
+    pl->c_slots.resize(c_caps.size());
+    for(size_t i = 0; i < c_caps.size(); i++)
+      pl->c_slots[i].alloc(c_caps[i] * sizeof(Complex));
+    for(int i = 0; i < 3; i++)
+      pl->scratch[i].alloc(scratchNum[i] * sizeof(Real));
+    for(int i = 0; i < 5; i++)
+      pl->c_scratch[i].alloc(c_scratchNum[i] * sizeof(Complex));
+    plan = pl;
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function Network::compile():");
+  }
+}
+
+size_t Network::planBytes() const{
+  // The buffer pool, the scratch buffers and the result allocated by each launch.
+  size_t bytes = 0;
+  for(size_t i = 0; i < plan->slots.size(); i++)
+    bytes += plan->slots[i].bytes;
+  for(size_t i = 0; i < plan->c_slots.size(); i++)
+    bytes += plan->c_slots[i].bytes;
+  for(int i = 0; i < 3; i++)
+    bytes += plan->scratch[i].bytes;
+  for(int i = 0; i < 5; i++)
+    bytes += plan->c_scratch[i].bytes;
+  return bytes + plan->out.elemNum() * (plan->out.typeID() == 2 ? sizeof(Complex) : sizeof(Real));
+}
+
+const Real* Network::planOperand(int opd, int, const Real* tp){
+  if(opd >= 0)
+    return slotElem(*plan, plan->steps[opd].slot, tp);
+  return tensors[-opd - 1]->elem;
+}
+
+const Complex* Network::planOperand(int opd, int idx, const Complex* tp){
+  // A real operand of a complex step is cast first.
+  Complex* cast = scratchElem(*plan, 3 + idx, tp);
+  if(opd >= 0){
+    const _PlanStep& child = plan->steps[opd];
+    if(child.complex)
+      return slotElem(*plan, child.slot, tp);
+    elemCast(cast, slotElem(*plan, child.slot, (const Real*)NULL), child.elemNum, false, false);
+    return cast;
+  }
+  const UniTensor* ten = tensors[-opd - 1];
+  if(ten->typeID() == 2)
+    return ten->c_elem;
+  elemCast(cast, ten->elem, ten->m_elemNum, false, false);
+  return cast;
+}
+
+template<typename T>
+void Network::runStep(const _PlanStep& st, T* elemC){
+  const T* elemA = planOperand(st.left, 0, elemC);
+  const T* elemB = planOperand(st.right, 1, elemC);
+  T* pack;
+  if(st.packA){
+    pack = scratchElem(*plan, 0, elemC);
+    st.packA->run(elemA, pack);
+    elemA = pack;
+  }
+  if(st.packB){
+    pack = scratchElem(*plan, 1, elemC);
+    st.packB->run(elemB, pack);
+    elemB = pack;
+  }
+  T* raw = st.post ? scratchElem(*plan, 2, elemC) : elemC;
+  for(size_t z = 0; z < st.zeros.size(); z++)
+    elemBzero(raw + st.zeros[z].first, st.zeros[z].second * sizeof(T), false);
+  UniTensor::multiplySectors(st.sectors, st.lay, elemA, elemB, raw, false, false, false);
+  if(st.post)
+    st.post->run(raw, elemC);
+}
+
+UniTensor Network::replay(){
+  _NetworkPlan& pl = *plan;
+  UniTensor out = pl.out;
+  bool complex = pl.steps.back().complex;
+  // The result gets its own elements, the layout is the one of the plan.
+  if(complex){
+    out.TelemAlloc(CTYPE);
+    out.initBlocks(CTYPE);
+  }
+  else{
+    out.TelemAlloc(RTYPE);
+    out.initBlocks(RTYPE);
+  }
+  for(size_t s = 0; s < pl.steps.size(); s++){
+    const _PlanStep& st = pl.steps[s];
+    if(st.complex)
+      runStep(st, st.slot < 0 ? out.c_elem : slotElem(pl, st.slot, out.c_elem));
+    else
+      runStep(st, st.slot < 0 ? out.elem : slotElem(pl, st.slot, out.elem));
+  }
+  if(pl.outPlan){
+    if(complex)
+      pl.outPlan->run(slotElem(pl, pl.steps.back().slot, out.c_elem), out.c_elem);
+    else
+      pl.outPlan->run(slotElem(pl, pl.steps.back().slot, out.elem), out.elem);
+  }
+  out.status |= out.HAVEELEM;
+  return out;
+}
+
+}; /* namespace uni10 */
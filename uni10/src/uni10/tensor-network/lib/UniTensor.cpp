@@ -44,10 +44,19 @@
 
 namespace uni10{
 
-int64_t UniTensor::ELEMNUM = 0;
-int UniTensor::COUNTER = 0;
-size_t UniTensor::MAXELEMNUM = 0;
-size_t UniTensor::MAXELEMTEN = 0;
+std::atomic<int64_t> UniTensor::ELEMNUM(0);
+std::atomic<int> UniTensor::COUNTER(0);
+std::atomic<size_t> UniTensor::MAXELEMNUM(0);
+std::atomic<size_t> UniTensor::MAXELEMTEN(0);
+
+/* Tensors are created from several threads at once, the peaks are raised with compare-and-swap. */
+void UniTensor::addElemNum(size_t elemNum){
+  size_t total = ELEMNUM += elemNum;
+  size_t peak = MAXELEMNUM;
+  while(total > peak && !MAXELEMNUM.compare_exchange_weak(peak, total));
+  peak = MAXELEMTEN;
+  while(elemNum > peak && !MAXELEMTEN.compare_exchange_weak(peak, elemNum));
+}
 
 /*********************  DEVELOP **************************/
 
@@ -162,8 +171,11 @@ UniTensor& UniTensor::operator*= (Real a){
       err<<"Cannot perform scalar multiplication on a tensor before setting its elements.";
       throw std::runtime_error(exception_msg(err.str()));
     }
-    *this = *this * a;
-    //vectorScal(a, elem, m_elemNum, ongpu);
+    TelemDetach();
+    if(typeID() == 1)
+      vectorScal(a, elem, m_elemNum, ongpu);
+    else if(typeID() == 2)
+      vectorScal(a, c_elem, m_elemNum, ongpu);
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function UniTensor::operator*=(Real):");
@@ -178,8 +190,12 @@ UniTensor& UniTensor::operator*= (Complex a){
       err<<"Cannot perform scalar multiplication on a tensor before setting its elements.";
       throw std::runtime_error(exception_msg(err.str()));
     }
-    *this = *this * a;
-    //vectorScal(a, c_elem, m_elemNum, ongpu);
+    if(a.imag() == 0)
+      return *this *= a.real();
+    if(typeID() == 1)
+      RtoC(*this);
+    TelemDetach();
+    vectorScal(a, c_elem, m_elemNum, ongpu);
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function UniTensor::operator*=(Complex):");
@@ -199,6 +215,7 @@ UniTensor operator*(const Complex& a, const UniTensor& Ta){
     UniTensor Tb(Ta);
     if(Tb.typeID() == 1)
       RtoC(Tb);
+    Tb.TelemDetach();
     vectorScal(a, Tb.c_elem, Tb.m_elemNum, Tb.ongpu);
     return Tb;
   }
@@ -218,6 +235,7 @@ UniTensor operator*(const UniTensor& Ta, Real a){
       throw std::runtime_error(exception_msg(err.str()));
     }
     UniTensor Tb(Ta);
+    Tb.TelemDetach();
     if(Tb.typeID() == 1)
       vectorScal(a, Tb.elem, Tb.m_elemNum, Tb.ongpu);
     else if(Tb.typeID() == 2)
@@ -234,9 +252,7 @@ UniTensor operator*(Real a, const UniTensor& Ta){return Ta * a;};
 
 UniTensor operator*(const UniTensor& Ta, const UniTensor& Tb){
   try{
-    UniTensor cTa = Ta;
-    UniTensor cTb = Tb;
-    return contract(cTa, cTb, true);
+    return contract(Ta, Tb);
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function operator*(uni10::UniTensor&, uni10::UniTensor&):");
@@ -256,59 +272,16 @@ UniTensor& UniTensor::operator=(const UniTensor& UniT){ //GPU
     RBondNum = UniT.RBondNum;
     RQdim = UniT.RQdim;
     CQdim = UniT.CQdim;
-    QidxEnc = UniT.QidxEnc;
-    RQidx2Off = UniT.RQidx2Off;
-    CQidx2Off = UniT.CQidx2Off;
-    RQidx2Dim = UniT.RQidx2Dim;
-    CQidx2Dim = UniT.CQidx2Dim;
-    RQidx2Blk = UniT.RQidx2Blk;
-
-    ELEMNUM -= m_elemNum;	//free original memory
-
+    m_qidx = UniT.m_qidx;
 
-    TelemFree();
-
-    elem = NULL;
-    c_elem = NULL;
+    // The blocks point into the elements of UniT, which are shared until one of the tensors writes.
+    m_store = UniT.m_store;
+    elem = UniT.elem;
+    c_elem = UniT.c_elem;
+    ongpu = UniT.ongpu;
     status = UniT.status;
     m_elemNum = UniT.m_elemNum;
-
-
-    std::map<Qnum, Block>::const_iterator it2;
-    std::map< const Block* , Block*> blkmap;
-
-    if(typeID() == 1){
-      TelemAlloc(RTYPE);
-      for (std::map<Qnum, Block>::iterator it = blocks.begin(); it != blocks.end(); it++ ){ // blocks here is UniT.blocks
-        it->second.m_elem = &(elem[it->second.m_elem - UniT.elem]);
-        it2 = UniT.blocks.find(it->first);
-        blkmap[&(it2->second)] = &(it->second);
-      }
-    }else if(typeID() == 2){
-      TelemAlloc(CTYPE);
-      for (std::map<Qnum, Block>::iterator it = blocks.begin(); it != blocks.end(); it++ ){ // blocks here is UniT.blocks
-        it->second.cm_elem = &(c_elem[it->second.cm_elem - UniT.c_elem]);
-        it2 = UniT.blocks.find(it->first);
-        blkmap[&(it2->second)] = &(it->second);
-      }
-    }
-
-    if(UniT.status & HAVEBOND){
-      for(std::map<int, Block*>::iterator it = RQidx2Blk.begin(); it != RQidx2Blk.end(); it++)
-        it->second = blkmap[it->second];
-    }
-
-    ELEMNUM += m_elemNum;
-    if(ELEMNUM > MAXELEMNUM)
-      MAXELEMNUM = ELEMNUM;
-    if(m_elemNum > MAXELEMTEN)
-      MAXELEMTEN = m_elemNum;
-
-    if(typeID() == 1)
-      elemCopy(elem, UniT.elem, sizeof(Real) * UniT.m_elemNum, ongpu, UniT.ongpu);
-    else if(typeID() == 2)
-      elemCopy(c_elem, UniT.c_elem, sizeof(Complex) * UniT.m_elemNum, ongpu, UniT.ongpu);
-
+    bindBlocks();
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function UniTensor::operator=(uni10::UniTensor&):");
@@ -337,6 +310,7 @@ UniTensor operator+(const UniTensor& _Ta, const UniTensor& _Tb){
     }
 
     UniTensor Tc(Ta);
+    Tc.TelemDetach();
     Tc.typeID() == 1 ? vectorAdd(Tc.elem, Tb.elem, Tc.m_elemNum, Tc.ongpu, Tb.ongpu) :vectorAdd(Tc.c_elem, Tb.c_elem, Tc.m_elemNum, Tc.ongpu, Tb.ongpu);
     return Tc;
   }
@@ -346,6 +320,49 @@ UniTensor operator+(const UniTensor& _Ta, const UniTensor& _Tb){
   }
 }
 
+UniTensor& UniTensor::operator=(UniTensor&& UniT){
+  try{
+    if(this == &UniT)
+      return *this;
+    r_flag = UniT.r_flag;
+    c_flag = UniT.c_flag;
+    name.swap(UniT.name);
+    bonds.swap(UniT.bonds);
+    labels.swap(UniT.labels);
+    RBondNum = UniT.RBondNum;
+    RQdim = UniT.RQdim;
+    CQdim = UniT.CQdim;
+    // Swapping maps keeps their nodes, so RQidx2Blk still points to the blocks it was built for.
+    blocks.swap(UniT.blocks);
+    RQidx2Blk.swap(UniT.RQidx2Blk);
+    m_qidx.swap(UniT.m_qidx);
+    m_store.swap(UniT.m_store);
+    elem = UniT.elem;
+    c_elem = UniT.c_elem;
+    ongpu = UniT.ongpu;
+    status = UniT.status;
+    m_elemNum = UniT.m_elemNum;
+
+    // UniT is left empty, the old contents of this tensor are released here.
+    UniT.name.clear();
+    UniT.bonds.clear();
+    UniT.labels.clear();
+    UniT.blocks.clear();
+    UniT.RQidx2Blk.clear();
+    UniT.m_qidx.reset();
+    UniT.TelemFree();
+    UniT.status = 0;
+    UniT.RBondNum = 0;
+    UniT.RQdim = 0;
+    UniT.CQdim = 0;
+    UniT.m_elemNum = 0;
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In function UniTensor::operator=(uni10::UniTensor&&):");
+  }
+  return *this;
+}
+
 UniTensor& UniTensor::operator+= (const UniTensor& _Tb){
   try{
 
@@ -366,6 +383,7 @@ UniTensor& UniTensor::operator+= (const UniTensor& _Tb){
       throw std::runtime_error(exception_msg(err.str()));
     }
 
+    TelemDetach();
     typeID() == 1 ? vectorAdd(elem, Tb.elem, m_elemNum, ongpu, Tb.ongpu) : vectorAdd(c_elem, Tb.c_elem, m_elemNum, ongpu, Tb.ongpu);
   }
   catch(const std::exception& e){
@@ -438,55 +456,30 @@ UniTensor::UniTensor(const std::vector<Bond>& _bonds, int* _labels, const std::s
 }
 
 UniTensor::UniTensor(const UniTensor& UniT): //GPU
-  r_flag(UniT.r_flag), c_flag(UniT.c_flag),name(UniT.name), elem(NULL), c_elem(NULL), status(UniT.status),
+  r_flag(UniT.r_flag), c_flag(UniT.c_flag),name(UniT.name), elem(UniT.elem), c_elem(UniT.c_elem), m_store(UniT.m_store), status(UniT.status),
 bonds(UniT.bonds), blocks(UniT.blocks), labels(UniT.labels), \
-    RBondNum(UniT.RBondNum), RQdim(UniT.RQdim), CQdim(UniT.CQdim), m_elemNum(UniT.m_elemNum), RQidx2Blk(UniT.RQidx2Blk), QidxEnc(UniT.QidxEnc),  RQidx2Off(UniT.RQidx2Off), CQidx2Off(UniT.CQidx2Off), RQidx2Dim(UniT.RQidx2Dim), CQidx2Dim(UniT.CQidx2Dim){
+    RBondNum(UniT.RBondNum), RQdim(UniT.RQdim), CQdim(UniT.CQdim), m_elemNum(UniT.m_elemNum), m_qidx(UniT.m_qidx), ongpu(UniT.ongpu){
     try{
 
-      std::map<Qnum, Block>::const_iterator it2;
-      std::map<const Block* , Block*> blkmap;
-
-      if(typeID() == 1){
-        TelemAlloc(RTYPE);
-        for (std::map<Qnum, Block>::iterator it = blocks.begin() ; it != blocks.end(); it++ ){
-          it->second.m_elem = &(elem[(it->second.m_elem - UniT.elem)]);
-          it2 = UniT.blocks.find(it->first);
-          blkmap[(&(it2->second))] = &(it->second);
-        }
-      }
-
-      if(typeID() == 2){
-        TelemAlloc(CTYPE);
-        for (std::map<Qnum, Block>::iterator it = blocks.begin() ; it != blocks.end(); it++ ){
-          it->second.cm_elem = &(c_elem[(it->second.cm_elem - UniT.c_elem)]);
-
-          it2 = UniT.blocks.find(it->first);
-          blkmap[(&(it2->second))] = &(it->second);
-        }
-      }
-
-      if(UniT.status & HAVEBOND){
-        for(std::map<int, Block*>::iterator it = RQidx2Blk.begin(); it != RQidx2Blk.end(); it++)
-          it->second = blkmap[it->second];
-      }
-
-      ELEMNUM += m_elemNum;
+      // The elements are shared with UniT, the blocks keep pointing into them.
+      bindBlocks();
       COUNTER++;
-      if(ELEMNUM > MAXELEMNUM)
-        MAXELEMNUM = ELEMNUM;
-      if(m_elemNum > MAXELEMTEN)
-        MAXELEMTEN = m_elemNum;
-
-      if(typeID() == 1)
-        elemCopy(elem, UniT.elem, sizeof(Real) * UniT.m_elemNum, ongpu, UniT.ongpu);
-      if(typeID() == 2)
-        elemCopy(c_elem, UniT.c_elem, sizeof(Complex) * UniT.m_elemNum, ongpu, UniT.ongpu);
     }
     catch(const std::exception& e){
       propogate_exception(e, "In copy constructor UniTensor::UniTensor(uni10::UniTensor&):");
     }
   }
 
+UniTensor::UniTensor(UniTensor&& UniT): r_flag(RTYPE), c_flag(CNULL), elem(NULL), c_elem(NULL), status(0), RBondNum(0), RQdim(0), CQdim(0), m_elemNum(0), ongpu(false){
+  try{
+    *this = std::move(UniT);
+    COUNTER++;
+  }
+  catch(const std::exception& e){
+    propogate_exception(e, "In move constructor UniTensor::UniTensor(uni10::UniTensor&&):");
+  }
+}
+
 UniTensor::UniTensor(const Block& blk): status(0){
   try{
     Bond bdi(BD_IN, blk.Rnum);
@@ -503,7 +496,6 @@ UniTensor::UniTensor(const Block& blk): status(0){
 
 UniTensor::~UniTensor(){
   TelemFree();
-  ELEMNUM -= m_elemNum;
   COUNTER--;
 }
 
@@ -1254,6 +1246,15 @@ std::string UniTensor::profile(bool print){
 	os<<"Allocated Elements: " << ELEMNUM << std::endl;
 	os<<"Max Allocated Elements: " << MAXELEMNUM << std::endl;
 	os<<"Max Allocated Elements for a Tensor: " << MAXELEMTEN << std::endl;
+  MemoryUsage usage = getMemoryUsage();
+  const char* subsystems[MEM_TAG_NUM] = {"Tensor", "Matrix", "Lapack", "Network", "Contract"};
+  os<<"Host Memory (current / peak bytes):\n";
+  for(int t = 0; t < MEM_TAG_NUM; t++)
+    os<<"  "<<subsystems[t]<<": "<<usage.current[t]<<" / "<<usage.peak[t]<<std::endl;
+  os<<"  Total: "<<usage.total<<" / "<<usage.peakTotal;
+  if(usage.peakSite.size())
+    os<<", peak in "<<usage.peakSite;
+  os<<std::endl;
   os<<"============================\n\n";
   if(print){
     std::cout<<os.str();
@@ -1545,6 +1546,7 @@ Real* UniTensor::getElem(){
       err<<"This Tensor is COMPLEX. Please use UniTensor::getElem(uni10::cflag ) instead";
       throw std::runtime_error(exception_msg(err.str()));
     }
+    TelemDetach();
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function UniTensor::getElem():");
@@ -1561,11 +1563,62 @@ void UniTensor::initUniT(int typeID){
     initUniT(CTYPE);
 }
 
+const _QidxTable& UniTensor::qidxTable()const{
+  static const _QidxTable empty;
+  return m_qidx ? *m_qidx : empty;
+}
+
+// The table records blocks by position, RQidx2Blk turns them into pointers to the blocks of this tensor.
+void UniTensor::bindBlocks(){
+  const std::vector<int>& RQidx2Bidx = qidxTable().RQidx2Bidx;
+  std::vector<Block*> blkptrs;
+  blkptrs.reserve(blocks.size());
+  for(std::map<Qnum, Block>::iterator it = blocks.begin(); it != blocks.end(); it++)
+    blkptrs.push_back(&(it->second));
+  RQidx2Blk.assign(RQidx2Bidx.size(), NULL);
+  for(size_t r = 0; r < RQidx2Bidx.size(); r++)
+    if(RQidx2Bidx[r] >= 0)
+      RQidx2Blk[r] = blkptrs[RQidx2Bidx[r]];
+}
+
 void UniTensor::TelemFree(){
-  if(elem != NULL)
-    elemFree(elem, sizeof(Real) * m_elemNum, ongpu);
-  else if(c_elem != NULL)
-    elemFree(c_elem, sizeof(Complex) * m_elemNum, ongpu);
+  m_store.reset();
+  elem = NULL;
+  c_elem = NULL;
+}
+
+void UniTensor::TelemOwn(void* buf, size_t memsize){
+  // ELEMNUM counts the buffers, tensors sharing one count it once.
+  size_t elemNum = m_elemNum;
+  addElemNum(elemNum);
+  m_store.reset(new _ElemStore(buf, memsize, ongpu), [elemNum](_ElemStore* store){
+    ELEMNUM -= elemNum;
+    delete store;
+  });
+}
+
+void UniTensor::TelemDetach(){
+  if(m_store.use_count() < 2)
+    return;
+  bool src_ongpu = ongpu;
+  if(typeID() == 1){
+    Real* src = elem;
+    TelemAlloc(RTYPE);
+    elemCopy(elem, src, sizeof(Real) * m_elemNum, ongpu, src_ongpu);
+    for(std::map<Qnum, Block>::iterator it = blocks.begin(); it != blocks.end(); it++){
+      it->second.m_elem = elem + (it->second.m_elem - src);
+      it->second.ongpu = ongpu;
+    }
+  }
+  else if(typeID() == 2){
+    Complex* src = c_elem;
+    TelemAlloc(CTYPE);
+    elemCopy(c_elem, src, sizeof(Complex) * m_elemNum, ongpu, src_ongpu);
+    for(std::map<Qnum, Block>::iterator it = blocks.begin(); it != blocks.end(); it++){
+      it->second.cm_elem = c_elem + (it->second.cm_elem - src);
+      it->second.ongpu = ongpu;
+    }
+  }
 }
 
 /************* developping *************/
@@ -1912,7 +1965,7 @@ std::vector<UniTensor> UniTensor::_hosvd(size_t modeNum, size_t fixedNum, std::v
     S *= UT.transpose();
   }
   S.permute(out_labels, fixedNum);
-  Us.push_back(S);
+  Us.push_back(std::move(S));
   return Us;
 }
 
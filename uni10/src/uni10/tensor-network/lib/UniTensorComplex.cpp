@@ -88,6 +88,15 @@ void UniTensor::setRawElem(const std::vector<Complex>& rawElem){
   }
 }
 
+UniTensor::UniTensor(cflag, const _PermutePlan& plan, const std::string& _name, bool zero): r_flag(RNULL), c_flag(CTYPE), name(_name), elem(NULL), c_elem(NULL), status(0){
+  initLayout(plan);
+  COUNTER++;
+  TelemAlloc(CTYPE);
+  initBlocks(CTYPE);
+  if(zero)
+    TelemBzero(CTYPE);
+}
+
 void UniTensor::setRawElem(cflag tp, const Block& blk){
   try{
     throwTypeError(tp);
@@ -126,12 +135,14 @@ void UniTensor::setRawElem(const Complex* rawElem){
     size_t B_cDim;
     size_t E_off;
     int R_off;
+    TelemDetach();
     Complex* work = c_elem;
     if(ongpu){
       work = (Complex*)malloc(m_elemNum * sizeof(Complex));
     }
-    for(std::map<int, size_t>::iterator it = QidxEnc.begin(); it != QidxEnc.end(); it++){
-      Q_off = it->first;
+    const _QidxTable& qt = qidxTable();
+    for(size_t n = 0; n < qt.Qidxs.size(); n++){
+      Q_off = qt.Qidxs[n];
       tmp = Q_off;
       for(int b = bondNum - 1; b >= 0; b--){
         Q_idxs[b] = tmp % Q_Bdims[b];
@@ -145,9 +156,9 @@ void UniTensor::setRawElem(const Complex* rawElem){
       RQoff = Q_off / CQdim;
       CQoff = Q_off % CQdim;
       B_cDim = RQidx2Blk[RQoff]->Cnum;
-      E_off = (RQidx2Blk[RQoff]->cm_elem - c_elem) + (RQidx2Off[RQoff] * B_cDim) + CQidx2Off[CQoff];
-      sB_rDim = RQidx2Dim[RQoff];
-      sB_cDim = CQidx2Dim[CQoff];
+      E_off = (RQidx2Blk[RQoff]->cm_elem - c_elem) + (qt.RQidx2Off[RQoff] * B_cDim) + qt.CQidx2Off[CQoff];
+      sB_rDim = qt.RQidx2Dim[RQoff];
+      sB_cDim = qt.CQidx2Dim[CQoff];
       sB_idxs.assign(bondNum, 0);
       for(sB_r = 0; sB_r < sB_rDim; sB_r++)
         for(sB_c = 0; sB_c < sB_cDim; sB_c++){
@@ -180,6 +191,7 @@ void UniTensor::setElem(const Complex* _elem, bool _ongpu){
   try{
     if(typeID() == 1)
       this->assign(CTYPE, this->bond());
+    TelemDetach();
     elemCopy(c_elem, _elem, m_elemNum * sizeof(Complex), ongpu, _ongpu);
     status |= HAVEELEM;
   }
@@ -248,6 +260,7 @@ void UniTensor::putBlock(cflag uni10_tp, const Qnum& qnum, const Block& mat, boo
     if( force && mat.typeID() == 1)
       RtoC(tmp);
       
+    TelemDetach();
     if(tmp.cm_elem != it->second.cm_elem){
 
       if(tmp.isDiag()){
@@ -319,6 +332,7 @@ Complex* UniTensor::getElem(cflag tp){
       err<<"This Tensor is REAL. Please use UniTensor::getElem(uni10::rflag ) instead";
       throw std::runtime_error(exception_msg(err.str()));
     }
+    TelemDetach();
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function UniTensor::getElem(uni10::cflag ):");
@@ -378,6 +392,7 @@ Matrix UniTensor::getBlock(cflag tp, const Qnum& qnum, bool diag)const{
 void UniTensor::set_zero(cflag tp){
   try{
     throwTypeError(tp);
+    TelemDetach();
     elemBzero(c_elem, m_elemNum * sizeof(Complex), ongpu);
     status |= HAVEELEM;
   }
@@ -389,6 +404,7 @@ void UniTensor::set_zero(cflag tp){
 void UniTensor::set_zero(cflag tp, const Qnum& qnum){
   try{
     throwTypeError(tp);
+    TelemDetach();
     std::map<Qnum, Block>::iterator it = blocks.find(qnum);
     if(it == blocks.end()){
       std::ostringstream err;
@@ -407,6 +423,7 @@ void UniTensor::set_zero(cflag tp, const Qnum& qnum){
 void UniTensor::identity(cflag tp){
   try{
     throwTypeError(tp);
+    TelemDetach();
     std::map<Qnum, Block>::iterator it;
     for ( it = blocks.begin() ; it != blocks.end(); it++ )
       setIdentity(it->second.cm_elem, it->second.Rnum, it->second.Cnum, ongpu);
@@ -420,6 +437,7 @@ void UniTensor::identity(cflag tp){
 void UniTensor::identity(cflag tp, const Qnum& qnum){
   try{
     throwTypeError(tp);
+    TelemDetach();
     std::map<Qnum, Block>::iterator it = blocks.find(qnum);
     if(it == blocks.end()){
       std::ostringstream err;
@@ -438,6 +456,7 @@ void UniTensor::identity(cflag tp, const Qnum& qnum){
 void UniTensor::randomize(cflag tp){
   try{
     throwTypeError(tp);
+    TelemDetach();
     elemRand(c_elem, m_elemNum, ongpu);
     status |= HAVEELEM;
   }
@@ -449,6 +468,7 @@ void UniTensor::randomize(cflag tp){
 void UniTensor::orthoRand(cflag tp){
   try{
     throwTypeError(tp);
+    TelemDetach();
     std::map<Qnum, Block>::iterator it;
     for ( it = blocks.begin() ; it != blocks.end(); it++ )
       orthoRandomize(it->second.cm_elem, it->second.Rnum, it->second.Cnum, ongpu);
@@ -462,6 +482,7 @@ void UniTensor::orthoRand(cflag tp){
 void UniTensor::orthoRand(cflag tp, const Qnum& qnum){
   try{
     throwTypeError(tp);
+    TelemDetach();
     std::map<Qnum, Block>::iterator it = blocks.find(qnum);
     if(it == blocks.end()){
       std::ostringstream err;
@@ -529,7 +550,7 @@ UniTensor& UniTensor::transpose(cflag tp){
       }
       UniTout.status |= HAVEELEM;
     }
-    *this = UniTout;
+    *this = std::move(UniTout);
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function UniTensor::transpose(uni10::cflag ):");
@@ -589,7 +610,7 @@ UniTensor& UniTensor::cTranspose(cflag tp){
       }
       UniTout.status |= HAVEELEM;
     }
-    *this = UniTout;
+    *this = std::move(UniTout);
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function UniTensor::cTranspose(uni10::cflag ):");
@@ -658,199 +679,44 @@ UniTensor& UniTensor::permute(cflag tp, const std::vector<int>& newLabels, int r
     if(inorder && RBondNum == rowBondNum)	//do nothing
       return *this;
     else{
-      std::vector<Bond> outBonds;
-      bool withoutSymmetry = true;
-      for(size_t b = 0; b < bonds.size(); b++){
-        outBonds.push_back(bonds[rsp_outin[b]]);
-        if(bonds[b].Qnums.size() != 1)
-          withoutSymmetry = false;
-      }
-      for(size_t b = 0; b < bonds.size(); b++){
-        if(b < rowBondNum)
-          outBonds[b].change(BD_IN);
-        else
-          outBonds[b].change(BD_OUT);
-      }
-      UniTensor UniTout(CTYPE, outBonds, name);
+      std::shared_ptr<const _PermutePlan> plan = permutePlan(rsp_outin, rowBondNum);
+      UniTensor UniTout(CTYPE, *plan, name, !(status & HAVEELEM));
       if(status & HAVEELEM){
-        if(withoutSymmetry){
-          if(!inorder){
-            if(ongpu && UniTout.ongpu){
-              size_t* perInfo = (size_t*)malloc(bondNum * 2 * sizeof(size_t));
-              std::vector<size_t> newAcc(bondNum);
-              newAcc[bondNum - 1] = 1;
-              perInfo[bondNum - 1] = 1;
-              for(int b = bondNum - 1; b > 0; b--){
-                newAcc[b - 1] = newAcc[b] * UniTout.bonds[b].Qdegs[0];
-                perInfo[b - 1] = perInfo[b] * bonds[b].Qdegs[0];
-              }
-              for(int b = 0; b < bondNum; b++)
-                perInfo[bondNum + rsp_outin[b]] = newAcc[b];
-              Complex* des_elem = UniTout.c_elem;
-              Complex* src_elem = c_elem;
-              reshapeElem(src_elem, bondNum, m_elemNum, perInfo, des_elem);
-              free(perInfo);
-            }
-            else{
-              Complex* des_elem = UniTout.c_elem;
-              Complex* src_elem = c_elem;
-              size_t memsize = m_elemNum * sizeof(Complex);
-              if(ongpu){
-                src_elem = (Complex*)elemAllocForce(memsize, false);
-                elemCopy(src_elem, c_elem, memsize, false, ongpu);
-              }
-              if(UniTout.ongpu)
-                des_elem = (Complex*)elemAllocForce(memsize, false);
-
-              std::vector<size_t> transAcc(bondNum);
-              std::vector<size_t> newAcc(bondNum);
-              transAcc[bondNum - 1] = 1;
-              newAcc[bondNum - 1] = 1;
-              for(int b = bondNum - 1; b > 0; b--)
-                newAcc[b - 1] = newAcc[b] * UniTout.bonds[b].Qdegs[0];
-              std::vector<int> bondDims(bondNum);
-              std::vector<int> idxs(bondNum);
-              for(int b = 0; b < bondNum; b++){
-                transAcc[rsp_outin[b]] = newAcc[b];
-                bondDims[b] = bonds[b].Qdegs[0];
-                idxs[b] = 0;
-              }
-              size_t cnt_ot = 0;
-              for(size_t i = 0; i < m_elemNum; i++){
-                des_elem[cnt_ot] = src_elem[i];
-                for(int bend = bondNum - 1; bend >= 0; bend--){
-                  idxs[bend]++;
-                  if(idxs[bend] < bondDims[bend]){
-                    cnt_ot += transAcc[bend];
-                    break;
-                  }
-                  else{
-                    cnt_ot -= transAcc[bend] * (idxs[bend] - 1);
-                    idxs[bend] = 0;
-                  }
-                }
-              }
-              if(ongpu)
-                elemFree(src_elem, memsize, false);
-              if(UniTout.ongpu){
-                elemCopy(UniTout.c_elem, des_elem, memsize, UniTout.ongpu, false);
-                elemFree(des_elem, memsize, false);
-              }
-            }
-          }
-          else{  //non-symmetry inorder
-            size_t memsize = m_elemNum * sizeof(Complex);
-            elemCopy(UniTout.c_elem, c_elem, memsize, UniTout.ongpu, ongpu);
+        if(plan->withoutSymmetry && ongpu && UniTout.ongpu){
+          size_t* perInfo = (size_t*)malloc(bondNum * 2 * sizeof(size_t));
+          std::vector<size_t> newAcc(bondNum);
+          newAcc[bondNum - 1] = 1;
+          perInfo[bondNum - 1] = 1;
+          for(int b = bondNum - 1; b > 0; b--){
+            newAcc[b - 1] = newAcc[b] * UniTout.bonds[b].Qdegs[0];
+            perInfo[b - 1] = perInfo[b] * bonds[b].Qdegs[0];
           }
+          for(int b = 0; b < bondNum; b++)
+            perInfo[bondNum + rsp_outin[b]] = newAcc[b];
+          reshapeElem(c_elem, bondNum, m_elemNum, perInfo, UniTout.c_elem);
+          free(perInfo);
         }
         else{
-          Real sign = 1.0;
-          //For Fermionic system
-          std::vector<_Swap> swaps;
-          if(Qnum::isFermionic()){
-            std::vector<int> inLabelF(bondNum);
-            std::vector<int> outLabelF(bondNum);
-            std::vector<int> ordF(bondNum);
-
-            for(int b = 0; b < RBondNum; b++){
-              inLabelF[b] = labels[b];
-              ordF[b] = b;
-            }
-            for(int b = 0; b < UniTout.RBondNum; b++)
-              outLabelF[b] = newLabels[b];
-            for(int b = bondNum - 1; b >= RBondNum; b--){
-              ordF[b] = bondNum - b + RBondNum - 1;
-              inLabelF[ordF[b]] = labels[b];
-            }
-            for(int b = bondNum - 1; b >= UniTout.RBondNum; b--)
-              outLabelF[bondNum - b + UniTout.RBondNum - 1] = newLabels[b];
-
-            std::vector<int> rspF_outin(bondNum);
-            for(int i = 0; i < bondNum; i++)
-              for(int j = 0; j < bondNum; j++)
-                if(inLabelF[i] == outLabelF[j])
-                  rspF_outin[j] = i;
-            swaps = recSwap(rspF_outin, ordF);
+          Complex* des_elem = UniTout.c_elem;
+          Complex* src_elem = c_elem;
+          size_t memsize = m_elemNum * sizeof(Complex);
+          if(ongpu){
+            src_elem = (Complex*)elemAllocForce(memsize, false);
+            elemCopy(src_elem, c_elem, memsize, false, ongpu);
           }
-          //End Fermionic system
-          std::vector<int> Qin_idxs(bondNum, 0);
-          std::vector<int> Qot_idxs(bondNum, 0);
-          int Qin_off, Qot_off;
-          int tmp;
-          int Qin_RQoff, Qin_CQoff;
-          int Qot_CQoff, Qot_RQoff;
-          size_t sBin_r, sBin_c;	//sub-block of a Qidx
-          size_t sBin_rDim, sBin_cDim;	//sub-block of a Qidx
-          size_t sBot_cDim;	//sub-block of a Qidx
-          size_t sBot_r, sBot_c;
-          size_t Bin_cDim, Bot_cDim;
-          Complex* Ein_ptr;
-          Complex* Eot_ptr;
-          std::vector<int> sBin_idxs(bondNum, 0);
-          std::vector<int> sBin_sBdims(bondNum, 0);
-          std::vector<int> Qot_acc(bondNum, 1);
-          std::vector<int> sBot_acc(bondNum, 1);
-          for(int b = bondNum	- 1; b > 0; b--)
-            Qot_acc[b - 1] = Qot_acc[b] * UniTout.bonds[b].Qnums.size();
-
-          for(std::map<int, size_t>::iterator it = QidxEnc.begin(); it != QidxEnc.end(); it++){
-            Qin_off = it->first;
-            tmp = Qin_off;
-            int qdim;
-            for(int b = bondNum - 1; b >= 0; b--){
-              qdim = bonds[b].Qnums.size();
-              Qin_idxs[b] = tmp % qdim;
-              sBin_sBdims[b] = bonds[b].Qdegs[Qin_idxs[b]];
-              tmp /= qdim;
-            }
-            Qot_off = 0;
-            for(int b = 0; b < bondNum; b++){
-              Qot_idxs[b] = Qin_idxs[rsp_outin[b]];
-              Qot_off += Qot_idxs[b] * Qot_acc[b];
-            }
-            for(int b = bondNum - 1; b > 0; b--)
-              sBot_acc[rsp_outin[b-1]] = sBot_acc[rsp_outin[b]] * bonds[rsp_outin[b]].Qdegs[Qot_idxs[b]];
-            Qin_RQoff = Qin_off / CQdim;
-            Qin_CQoff = Qin_off % CQdim;
-            Qot_RQoff = Qot_off / UniTout.CQdim;
-            Qot_CQoff = Qot_off % UniTout.CQdim;
-            Bin_cDim = RQidx2Blk[Qin_RQoff]->Cnum;
-            Bot_cDim = UniTout.RQidx2Blk[Qot_RQoff]->Cnum;
-            Ein_ptr = RQidx2Blk[Qin_RQoff]->cm_elem + (RQidx2Off[Qin_RQoff] * Bin_cDim) + CQidx2Off[Qin_CQoff];
-            Eot_ptr = UniTout.RQidx2Blk[Qot_RQoff]->cm_elem + (UniTout.RQidx2Off[Qot_RQoff] * Bot_cDim) + UniTout.CQidx2Off[Qot_CQoff];
-            sBin_rDim = RQidx2Dim[Qin_RQoff];
-            sBin_cDim = CQidx2Dim[Qin_CQoff];
-            sBot_cDim = UniTout.CQidx2Dim[Qot_CQoff];
-            int cnt_ot = 0;
-            sBin_idxs.assign(bondNum, 0);
-            if(Qnum::isFermionic()){
-              int sign01 = 0;
-              for(size_t i = 0; i < swaps.size(); i++)
-                sign01 ^= (bonds[swaps[i].b1].Qnums[Qin_idxs[swaps[i].b1]].prtF() & bonds[swaps[i].b2].Qnums[Qin_idxs[swaps[i].b2]].prtF());
-              sign = sign01 ? -1.0 : 1.0;
-            }
-            for(sBin_r = 0; sBin_r < sBin_rDim; sBin_r++)
-              for(sBin_c = 0; sBin_c < sBin_cDim; sBin_c++){
-                sBot_r = cnt_ot / sBot_cDim;
-                sBot_c = cnt_ot % sBot_cDim;
-                Eot_ptr[(sBot_r * Bot_cDim) + sBot_c] = sign * Ein_ptr[(sBin_r * Bin_cDim) + sBin_c];
-                for(int bend = bondNum - 1; bend >= 0; bend--){
-                  sBin_idxs[bend]++;
-                  if(sBin_idxs[bend] < sBin_sBdims[bend]){
-                    cnt_ot += sBot_acc[bend];
-                    break;
-                  }
-                  else{
-                    cnt_ot -= sBot_acc[bend] * (sBin_idxs[bend] - 1);
-                    sBin_idxs[bend] = 0;
-                  }
-                }
-              }
+          if(UniTout.ongpu)
+            des_elem = (Complex*)elemAllocForce(memsize, false);
+          plan->run(src_elem, des_elem);
+          if(ongpu)
+            elemFree(src_elem, memsize, false);
+          if(UniTout.ongpu){
+            elemCopy(UniTout.c_elem, des_elem, memsize, UniTout.ongpu, false);
+            elemFree(des_elem, memsize, false);
           }
         }
         UniTout.status |= HAVEELEM;
       }
-      *this = UniTout;
+      *this = std::move(UniTout);
       this->setLabel(newLabels);
     }
   }
@@ -949,7 +815,7 @@ UniTensor& UniTensor::combineBond(cflag tp, const std::vector<int>&cmbLabels){
     if(status & HAVEELEM)
       Tout.setElem(c_elem, ongpu);
 
-    *this = Tout;
+    *this = std::move(Tout);
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function UniTensor::combineBond(uni10::cflag, std::vector<int>&):");
@@ -970,6 +836,9 @@ void UniTensor::addGate(cflag tp, const std::vector<_Swap>& swaps){
       err<<"Cannot add swap gates to a tensor before setting its elements.";
       throw std::runtime_error(exception_msg(err.str()));
     }
+    if(swaps.empty())
+      return;
+    TelemDetach();
     int sign = 1;
     int bondNum = bonds.size();
     std::vector<int> Q_idxs(bondNum, 0);
@@ -983,8 +852,9 @@ void UniTensor::addGate(cflag tp, const std::vector<_Swap>& swaps){
     size_t sB_rDim, sB_cDim;	//sub-block of a Qidx
     size_t B_cDim;
     Complex* Eptr;
-    for(std::map<int, size_t>::iterator it = QidxEnc.begin(); it != QidxEnc.end(); it++){
-      Q_off = it->first;
+    const _QidxTable& qt = qidxTable();
+    for(size_t n = 0; n < qt.Qidxs.size(); n++){
+      Q_off = qt.Qidxs[n];
       tmp = Q_off;
       for(int b = bondNum - 1; b >= 0; b--){
         Q_idxs[b] = tmp % Q_Bdims[b];
@@ -993,9 +863,9 @@ void UniTensor::addGate(cflag tp, const std::vector<_Swap>& swaps){
       RQoff = Q_off / CQdim;
       CQoff = Q_off % CQdim;
       B_cDim = RQidx2Blk[RQoff]->Cnum;
-      Eptr = RQidx2Blk[RQoff]->cm_elem + (RQidx2Off[RQoff] * B_cDim) + CQidx2Off[CQoff];
-      sB_rDim = RQidx2Dim[RQoff];
-      sB_cDim = CQidx2Dim[CQoff];
+      Eptr = RQidx2Blk[RQoff]->cm_elem + (qt.RQidx2Off[RQoff] * B_cDim) + qt.CQidx2Off[CQoff];
+      sB_rDim = qt.RQidx2Dim[RQoff];
+      sB_cDim = qt.CQidx2Dim[CQoff];
 
       int sign01 = 0;
       for(size_t i = 0; i < swaps.size(); i++)
@@ -1121,21 +991,23 @@ UniTensor& UniTensor::partialTrace(cflag tp, int la, int lb){
     std::vector<size_t> B_cDims(tQdim);
     int tQdim2 = tQdim * tQdim;
     int Qenc = Q_acc[ia] + Q_acc[ib];
-    for(std::map<int, size_t>::iterator it = Tt.QidxEnc.begin(); it != Tt.QidxEnc.end(); it++){
-      Qt_off = it->first;
+    const _QidxTable& qt = qidxTable();
+    const _QidxTable& qtt = Tt.qidxTable();
+    for(size_t n = 0; n < qtt.Qidxs.size(); n++){
+      Qt_off = qtt.Qidxs[n];
       Qt_RQoff = Qt_off / Tt.CQdim;
       Qt_CQoff = Qt_off % Tt.CQdim;
       Bt_cDim = Tt.RQidx2Blk[Qt_RQoff]->Cnum;
-      Et_ptr = Tt.RQidx2Blk[Qt_RQoff]->cm_elem + (Tt.RQidx2Off[Qt_RQoff] * Bt_cDim) + Tt.CQidx2Off[Qt_CQoff];
-      sBt_rDim = Tt.RQidx2Dim[Qt_RQoff];
-      sBt_cDim = Tt.CQidx2Dim[Qt_CQoff];
+      Et_ptr = Tt.RQidx2Blk[Qt_RQoff]->cm_elem + (qtt.RQidx2Off[Qt_RQoff] * Bt_cDim) + qtt.CQidx2Off[Qt_CQoff];
+      sBt_rDim = qtt.RQidx2Dim[Qt_RQoff];
+      sBt_cDim = qtt.CQidx2Dim[Qt_CQoff];
 
       for(int q = 0; q < tQdim; q++){
         Q_off = Qt_off * tQdim2 + q * Qenc;
         Q_RQoff = Q_off / CQdim;
         Q_CQoff = Q_off % CQdim;
         B_cDims[q] = RQidx2Blk[Q_RQoff]->Cnum;
-        E_offs[q] = RQidx2Blk[Q_RQoff]->cm_elem + (RQidx2Off[Q_RQoff] * B_cDims[q]) + CQidx2Off[Q_CQoff];
+        E_offs[q] = RQidx2Blk[Q_RQoff]->cm_elem + (qt.RQidx2Off[Q_RQoff] * B_cDims[q]) + qt.CQidx2Off[Q_CQoff];
       }
       int tQdeg, sB_c_off;
       Complex trVal;
@@ -1153,7 +1025,7 @@ UniTensor& UniTensor::partialTrace(cflag tp, int la, int lb){
         }
       Tt.status |= HAVEELEM;
     }
-    *this = Tt;
+    *this = std::move(Tt);
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function UniTensor::partialTrace(uni10::cflag, int, int):");
@@ -1165,7 +1037,7 @@ UniTensor& UniTensor::assign(cflag tp, const std::vector<Bond>& _bond){
   try{
     throwTypeError(tp);
     UniTensor T(CTYPE, _bond);
-    *this = T;
+    *this = std::move(T);
   }
   catch(const std::exception& e){
     propogate_exception(e, "In function UniTensor::assign(uni10::cflag, std::vector<Bond>&):");
@@ -1233,14 +1105,15 @@ Complex UniTensor::at(cflag tp, const std::vector<size_t>& idxs)const{
     for(int b = 0; b < bondNum; b++)
       Qoff += Q_acc[b] * Qidxs[b];
 
-    if(QidxEnc.find(Qoff) != QidxEnc.end()){
-      int Q_RQoff = Qoff / CQdim;
-      int Q_CQoff = Qoff % CQdim;
-      Block* blk = RQidx2Blk.find(Q_RQoff)->second;
+    int Q_RQoff = Qoff / CQdim;
+    int Q_CQoff = Qoff % CQdim;
+    const _QidxTable& qt = qidxTable();
+    if(qt.RQidx2Bidx[Q_RQoff] >= 0 && qt.RQidx2Bidx[Q_RQoff] == qt.CQidx2Bidx[Q_CQoff]){
+      Block* blk = RQidx2Blk[Q_RQoff];
       size_t B_cDim = blk->Cnum;
-      size_t sB_cDim = CQidx2Dim.find(Q_CQoff)->second;
-      size_t blkRoff = RQidx2Off.find(Q_RQoff)->second;
-      size_t blkCoff = CQidx2Off.find(Q_CQoff)->second;
+      size_t sB_cDim = qt.CQidx2Dim[Q_CQoff];
+      size_t blkRoff = qt.RQidx2Off[Q_RQoff];
+      size_t blkCoff = qt.CQidx2Off[Q_CQoff];
       Complex* boff = blk->cm_elem + (blkRoff * B_cDim) + blkCoff;
       int cnt = 0;
       std::vector<int> D_acc(bondNum, 1);
@@ -1291,12 +1164,7 @@ void UniTensor::initUniT(cflag tp){ //GPU
   elem = NULL;
   c_elem = NULL;
 
-  ELEMNUM += m_elemNum;
   COUNTER++;
-  if(ELEMNUM > MAXELEMNUM)
-    MAXELEMNUM = ELEMNUM;
-  if(m_elemNum > MAXELEMTEN)
-    MAXELEMTEN = m_elemNum;
 
   TelemAlloc(CTYPE);
   initBlocks(CTYPE);
@@ -1422,38 +1290,39 @@ size_t UniTensor::grouping(cflag tp){
 
   std::map<Qnum,size_t>::iterator it;
   std::map<Qnum,size_t>::iterator it2;
-  std::set<int> Qidx;
-  int qidx;
+  std::shared_ptr<_QidxTable> table = std::make_shared<_QidxTable>();
+  table->RQidx2Bidx.assign(RQdim, -1);
+  table->CQidx2Bidx.assign(CQdim, -1);
+  std::vector<const std::vector<int>*> blkCQidx;
   size_t off = 0;
   for ( it2 = col_QnumMdim.begin() ; it2 != col_QnumMdim.end(); it2++ ){
     it = row_QnumMdim.find(it2->first);
     Block blk(CTYPE, it->second, it2->second); // blk(Rnum, Cnum);
     off += blk.Rnum * blk.Cnum;
     blocks[it->first] = blk;
-    Block* blkptr = &(blocks[it->first]);
+    // Blocks are inserted in the order of their Qnums, so the position in blocks is the insertion count.
+    int bidx = blkCQidx.size();
     std::vector<int>& tmpRQidx = row_Qnum2Qidx[it->first];
     std::vector<int>& tmpCQidx = col_Qnum2Qidx[it->first];
-    for(size_t i = 0; i < tmpRQidx.size(); i++){
-      RQidx2Blk[tmpRQidx[i]] = blkptr;
-      for(size_t j = 0; j < tmpCQidx.size(); j++){
-        RQidx2Dim[tmpRQidx[i]] = tmpRQidx2Dim[tmpRQidx[i]];
-        RQidx2Off[tmpRQidx[i]] = tmpRQidx2Off[tmpRQidx[i]];
-        CQidx2Dim[tmpCQidx[j]] = tmpCQidx2Dim[tmpCQidx[j]];
-        CQidx2Off[tmpCQidx[j]] = tmpCQidx2Off[tmpCQidx[j]];
-        qidx = tmpRQidx[i] * CQdim + tmpCQidx[j];
-        Qidx.insert(qidx);
-      }
-    }
-  }
-  size_t elemEnc = 0;
-  for(std::map<int, size_t>::iterator itr = RQidx2Dim.begin(); itr != RQidx2Dim.end(); itr++)
-    for(std::map<int, size_t>::iterator itc = CQidx2Dim.begin(); itc != CQidx2Dim.end(); itc++){
-      qidx = itr->first * CQdim + itc->first;
-      if(Qidx.find(qidx) != Qidx.end()){
-        QidxEnc[qidx] = elemEnc;
-        elemEnc += RQidx2Dim[itr->first] * CQidx2Dim[itc->first];
-      }
-    }
+    for(size_t i = 0; i < tmpRQidx.size(); i++)
+      table->RQidx2Bidx[tmpRQidx[i]] = bidx;
+    for(size_t j = 0; j < tmpCQidx.size(); j++)
+      table->CQidx2Bidx[tmpCQidx[j]] = bidx;
+    blkCQidx.push_back(&tmpCQidx);
+  }
+  for(int r = 0; r < RQdim; r++){
+    if(table->RQidx2Bidx[r] < 0)
+      continue;
+    const std::vector<int>& tmpCQidx = *blkCQidx[table->RQidx2Bidx[r]];
+    for(size_t j = 0; j < tmpCQidx.size(); j++)
+      table->Qidxs.push_back(r * CQdim + tmpCQidx[j]);
+  }
+  table->RQidx2Off.swap(tmpRQidx2Off);
+  table->CQidx2Off.swap(tmpCQidx2Off);
+  table->RQidx2Dim.swap(tmpRQidx2Dim);
+  table->CQidx2Dim.swap(tmpCQidx2Dim);
+  m_qidx = table;
+  bindBlocks();
   return off;
 }
 
@@ -1470,6 +1339,7 @@ void UniTensor::initBlocks(cflag tp){
 
 void UniTensor::TelemAlloc(cflag tp){
   c_elem = (Complex*)elemAlloc(sizeof(Complex) * m_elemNum, ongpu);
+  TelemOwn(c_elem, sizeof(Complex) * m_elemNum);
 }
 
 void UniTensor::TelemBzero(cflag tp){
@@ -1492,6 +1362,7 @@ Real UniTensor::norm(cflag tp) const{
 UniTensor& UniTensor::normalize(cflag tp){
   try{
     throwTypeError(tp);
+    TelemDetach();
     Real norm = vectorNorm(c_elem, elemNum(), 1, ongpu);
     vectorScal((1./norm), c_elem, elemNum(), ongpu);
   }
@@ -1613,7 +1484,7 @@ std::vector<UniTensor> UniTensor::hosvd(cflag tp, std::vector<int>& group_labels
       S *= UT.cTranspose(CTYPE);
       lrsp_labels = rsp_labels;
     } 
-    Us.push_back(S);
+    Us.push_back(std::move(S));
     return Us;
   }
   catch(const std::exception& e){
@@ -0,0 +1,358 @@
+/****************************************************************************
+*  @file UniTensorContract.cpp
+*  @license
+*    Universal Tensor Network Library
+*    Copyright (c) 2013-2016
+*    National Taiwan University
+*    National Tsing-Hua University
+*
+*    This file is part of Uni10, the Universal Tensor Network Library.
+*
+*    Uni10 is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU Lesser General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    Uni10 is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public License
+*    along with Uni10.  If not, see <http://www.gnu.org/licenses/>.
+*  @endlicense
+*  @brief Operand layouts and GEMM sectors of tensor contractions
+*  @author Ying-Jer Kao
+*  @date 2016-06-06
+*  @since 1.0.0
+*
+*****************************************************************************/
+#include <uni10/tools/uni10_tools.h>
+#include <uni10/data-structure/uni10_struct.h>
+#include <uni10/data-structure/Bond.h>
+#include <uni10/tensor-network/UniTensor.h>
+#include <uni10/numeric/lapack/uni10_lapack.h>
+#include <set>
+
+namespace uni10{
+
+namespace {
+
+/* A packed contraction operand, taken from the memory pool and given back when the contraction ends. */
+class PackBuffer{
+public:
+  PackBuffer(): buf(NULL){}
+  ~PackBuffer(){
+    poolFree(buf);
+  }
+  template<typename T>
+  T* alloc(size_t elemNum){
+    buf = poolAlloc(elemNum * sizeof(T), MEM_CONTRACT);
+    return (T*)buf;
+  }
+private:
+  PackBuffer(const PackBuffer&);
+  PackBuffer& operator=(const PackBuffer&);
+  void* buf;
+};
+
+/* Sectors with at least this many multiply-adds are given the whole thread budget inside BLAS. */
+const size_t LARGE_SECTOR_FLOPS = 1 << 21;
+/* Below this many multiply-adds in total the small sectors are not worth waking the thread pool. */
+const size_t PARALLEL_SECTOR_FLOPS = 1 << 16;
+
+size_t sectorFlops(const _ContractSector& sec){
+  return (size_t)sec.M * sec.N * sec.K;
+}
+
+bool largerSector(const _ContractSector& a, const _ContractSector& b){
+  return sectorFlops(a) > sectorFlops(b);
+}
+
+template<typename T>
+void multiply(const _ContractSector& sec, const _ContractLayout& lay, const T* elemA, const T* elemB, T* elemC, bool ongpuA, bool ongpuB, bool ongpuC, T alpha, T beta){
+  if(lay.transA || lay.transB || alpha != T(1) || beta != T(0))
+    matrixMul(lay.transA, lay.transB, elemA + sec.offA, elemB + sec.offB, sec.M, sec.N, sec.K, alpha, beta, elemC + sec.offC, ongpuA, ongpuB, ongpuC);
+  else  // also takes operands which are split between host and device
+    matrixMul(const_cast<T*>(elemA) + sec.offA, const_cast<T*>(elemB) + sec.offB, sec.M, sec.N, sec.K, elemC + sec.offC, ongpuA, ongpuB, ongpuC);
+}
+
+template<typename T>
+void runSectors(const std::vector<_ContractSector>& _sectors, const _ContractLayout& lay, const T* elemA, const T* elemB, T* elemC, bool ongpuA, bool ongpuB, bool ongpuC, T alpha, T beta){
+  if(ongpuA || ongpuB || ongpuC){
+    for(size_t s = 0; s < _sectors.size(); s++)
+      multiply(_sectors[s], lay, elemA, elemB, elemC, ongpuA, ongpuB, ongpuC, alpha, beta);
+    return;
+  }
+  // Tiny sectors are dominated by the BLAS call overhead, they go to the batched kernels at once.
+  std::vector<_ContractSector> sectors;
+  std::vector<const T*> batchA, batchB;
+  std::vector<T*> batchC;
+  std::vector<int> batchM, batchN, batchK;
+  for(size_t s = 0; s < _sectors.size(); s++){
+    const _ContractSector& sec = _sectors[s];
+    if(smallGemm(sec.M, sec.N, sec.K)){
+      batchA.push_back(elemA + sec.offA);
+      batchB.push_back(elemB + sec.offB);
+      batchC.push_back(elemC + sec.offC);
+      batchM.push_back(sec.M);
+      batchN.push_back(sec.N);
+      batchK.push_back(sec.K);
+    }
+    else
+      sectors.push_back(sec);
+  }
+  if(batchC.size())
+    matrixMulBatch(lay.transA, lay.transB, batchC.size(), &batchA[0], &batchB[0], &batchM[0], &batchN[0], &batchK[0], alpha, beta, &batchC[0], false);
+  int threadNum = getThreadNum();
+  if(threadNum < 2 || sectors.size() < 2){
+    for(size_t s = 0; s < sectors.size(); s++)
+      multiply(sectors[s], lay, elemA, elemB, elemC, ongpuA, ongpuB, ongpuC, alpha, beta);
+    return;
+  }
+  std::stable_sort(sectors.begin(), sectors.end(), largerSector);
+  // Large sectors one after another, each with a multithreaded BLAS.
+  size_t large = 0;
+  {
+    BlasThreads blas(threadNum);
+    for(; large < sectors.size() && sectorFlops(sectors[large]) >= LARGE_SECTOR_FLOPS; large++)
+      multiply(sectors[large], lay, elemA, elemB, elemC, ongpuA, ongpuB, ongpuC, alpha, beta);
+  }
+  // The remaining ones side by side, each with a single-threaded BLAS, largest first.
+  size_t flops = 0;
+  for(size_t s = large; s < sectors.size(); s++)
+    flops += sectorFlops(sectors[s]);
+  if(sectors.size() - large < 2 || flops < PARALLEL_SECTOR_FLOPS){
+    for(size_t s = large; s < sectors.size(); s++)
+      multiply(sectors[s], lay, elemA, elemB, elemC, ongpuA, ongpuB, ongpuC, alpha, beta);
+    return;
+  }
+  BlasThreads blas(1);
+  parallelFor(sectors.size() - large, [&](size_t s){
+    BlasThreads local(1);
+    multiply(sectors[large + s], lay, elemA, elemB, elemC, ongpuA, ongpuB, ongpuC, alpha, beta);
+  });
+}
+
+
+/* Blocks of C which no sector writes to still get C = beta * C. */
+template<typename T>
+void scaleUncovered(const std::vector<_ContractSector>& sectors, const std::map<Qnum, Block>& blocksC, T* elemC, bool ongpuC, T beta){
+  std::set<size_t> covered;
+  for(size_t s = 0; s < sectors.size(); s++)
+    covered.insert(sectors[s].offC);
+  size_t offset = 0;
+  for(std::map<Qnum, Block>::const_iterator it = blocksC.begin(); it != blocksC.end(); it++){
+    size_t elemNum = it->second.row() * it->second.col();
+    if(elemNum && covered.find(offset) == covered.end()){
+      if(beta == T(0))
+        elemBzero(elemC + offset, elemNum * sizeof(T), ongpuC);
+      else if(beta != T(1))
+        vectorScal(beta, elemC + offset, elemNum, ongpuC);
+    }
+    offset += elemNum;
+  }
+}
+
+};  /* namespace */
+
+_ContractLayout UniTensor::contractLayout(const UniTensor& Ta, const UniTensor& Tb){
+  _ContractLayout lay;
+  lay.conDim = 1;
+  std::vector<int> freeA, conA, freeB, conB;
+  std::vector<int> posA(Ta.labels.size()), posB(Tb.labels.size());
+  for(size_t a = 0; a < Ta.labels.size(); a++){
+    bool match = false;
+    for(size_t b = 0; b < Tb.labels.size(); b++)
+      if(Ta.labels[a] == Tb.labels[b]){
+        if(!(Ta.bonds[a].dim() == Tb.bonds[b].dim())){
+          std::ostringstream err;
+          err<<"Cannot contract two bonds having different dimensions";
+          throw std::runtime_error(exception_msg(err.str()));
+        }
+        match = true;
+        lay.conDim *= Ta.bonds[a].dim();
+        break;
+      }
+    if(match)
+      conA.push_back(Ta.labels[a]);
+    else{
+      freeA.push_back(Ta.labels[a]);
+      posA[freeA.size() - 1] = a;
+    }
+  }
+  for(size_t b = 0; b < Tb.labels.size(); b++){
+    if(std::find(conA.begin(), conA.end(), Tb.labels[b]) != conA.end())
+      conB.push_back(Tb.labels[b]);
+    else{
+      freeB.push_back(Tb.labels[b]);
+      posB[freeB.size() - 1] = b;
+    }
+  }
+  lay.conBond = conA.size();
+  bool fermionic = Qnum::isFermionic();
+  // Reading a block through its transpose reorders the sub-blocks but never flips a fermionic sign.
+  bool transposable = !fermionic && !Ta.ongpu && !Tb.ongpu;
+  lay.trivial = !fermionic && trivialBonds(Ta.bonds) && trivialBonds(Tb.bonds);
+  int freeANum = freeA.size();
+  int freeBNum = freeB.size();
+
+  // The contracted bonds may follow the order of either operand, pick the one which moves fewer elements.
+  size_t best = 0;
+  for(int cand = 0; cand < 2; cand++){
+    const std::vector<int>& con = cand == 0 ? conA : conB;
+    std::vector<int> labelA = concat(freeA, con);
+    std::vector<int> labelB = concat(con, freeB);
+    bool nA = Ta.labels == labelA && (Ta.RBondNum == freeANum || lay.trivial);
+    bool tA = transposable && Ta.labels == concat(con, freeA) && (Ta.RBondNum == lay.conBond || lay.trivial);
+    bool nB = Tb.labels == labelB && (Tb.RBondNum == lay.conBond || lay.trivial);
+    bool tB = transposable && Tb.labels == concat(freeB, con) && (Tb.RBondNum == freeBNum || lay.trivial);
+    size_t cost = (nA || tA ? 0 : Ta.m_elemNum) + (nB || tB ? 0 : Tb.m_elemNum);
+    if(cand == 0 || cost < best){
+      best = cost;
+      lay.labelA = labelA;
+      lay.labelB = labelB;
+      lay.permA = !(nA || tA);
+      lay.permB = !(nB || tB);
+      lay.transA = !nA && tA;
+      lay.transB = !nB && tB;
+    }
+  }
+  lay.labelC = concat(freeA, freeB);
+  for(int a = 0; a < freeANum; a++){
+    lay.cBonds.push_back(Ta.bonds[posA[a]]);
+    lay.cBonds.back().change(BD_IN);
+  }
+  for(int b = 0; b < freeBNum; b++){
+    lay.cBonds.push_back(Tb.bonds[posB[b]]);
+    lay.cBonds.back().change(BD_OUT);
+  }
+  return lay;
+}
+
+std::vector<_ContractSector> UniTensor::contractSectors(const std::map<Qnum, Block>& blocksA, const std::map<Qnum, Block>& blocksB, const UniTensor& Tc, const _ContractLayout& lay){
+  std::vector<_ContractSector> sectors;
+  if(lay.trivial){
+    _ContractSector sec;
+    sec.offA = 0;
+    sec.offB = 0;
+    sec.offC = 0;
+    sec.M = blocksA.begin()->second.Rnum * blocksA.begin()->second.Cnum / lay.conDim;
+    sec.N = blocksB.begin()->second.Rnum * blocksB.begin()->second.Cnum / lay.conDim;
+    sec.K = lay.conDim;
+    sectors.push_back(sec);
+    return sectors;
+  }
+  std::map<Qnum, size_t> offB, offC;
+  size_t offset = 0;
+  for(std::map<Qnum, Block>::const_iterator it = blocksB.begin(); it != blocksB.end(); it++){
+    offB[it->first] = offset;
+    offset += it->second.Rnum * it->second.Cnum;
+  }
+  offset = 0;
+  for(std::map<Qnum, Block>::const_iterator it = Tc.blocks.begin(); it != Tc.blocks.end(); it++){
+    offC[it->first] = offset;
+    offset += it->second.Rnum * it->second.Cnum;
+  }
+  offset = 0;
+  for(std::map<Qnum, Block>::const_iterator it = blocksA.begin(); it != blocksA.end(); offset += it->second.Rnum * it->second.Cnum, it++){
+    // A transposed block is keyed by the quantum number of its columns, the inverse of the row one.
+    Qnum qnum = lay.transA ? -it->first : it->first;
+    std::map<Qnum, Block>::const_iterator itB = blocksB.find(lay.transB ? -qnum : qnum);
+    if(itB == blocksB.end())
+      continue;
+    std::map<Qnum, Block>::const_iterator itC = Tc.blocks.find(qnum);
+    const Block& blockA = it->second;
+    const Block& blockB = itB->second;
+    _ContractSector sec;
+    sec.M = lay.transA ? blockA.Cnum : blockA.Rnum;
+    sec.K = lay.transA ? blockA.Rnum : blockA.Cnum;
+    sec.N = lay.transB ? blockB.Rnum : blockB.Cnum;
+    size_t KB = lay.transB ? blockB.Cnum : blockB.Rnum;
+    if(!(itC != Tc.blocks.end() && itC->second.Rnum == (size_t)sec.M && itC->second.Cnum == (size_t)sec.N && (size_t)sec.K == KB)){
+      std::ostringstream err;
+      err<<"The dimensions the bonds to be contracted out are different.";
+      throw std::runtime_error(exception_msg(err.str()));
+    }
+    sec.offA = offset;
+    sec.offB = offB[itB->first];
+    sec.offC = offC[qnum];
+    sectors.push_back(sec);
+  }
+  return sectors;
+}
+
+void UniTensor::multiplySectors(const std::vector<_ContractSector>& sectors, const _ContractLayout& lay, const Real* elemA, const Real* elemB, Real* elemC, bool ongpuA, bool ongpuB, bool ongpuC, Real alpha, Real beta){
+  runSectors(sectors, lay, elemA, elemB, elemC, ongpuA, ongpuB, ongpuC, alpha, beta);
+}
+
+void UniTensor::multiplySectors(const std::vector<_ContractSector>& sectors, const _ContractLayout& lay, const Complex* elemA, const Complex* elemB, Complex* elemC, bool ongpuA, bool ongpuB, bool ongpuC, Complex alpha, Complex beta){
+  runSectors(sectors, lay, elemA, elemB, elemC, ongpuA, ongpuB, ongpuC, alpha, beta);
+}
+
+void UniTensor::contractPacked(rflag, const UniTensor& Ta, const UniTensor& Tb, const _ContractLayout& lay, UniTensor& Tc, Real alpha, Real beta){
+  const Real* elemA = Ta.elem;
+  const Real* elemB = Tb.elem;
+  const std::map<Qnum, Block>* blocksA = &Ta.blocks;
+  const std::map<Qnum, Block>* blocksB = &Tb.blocks;
+  std::shared_ptr<const _PermutePlan> planA, planB;
+  PackBuffer bufA, bufB;
+  if(lay.permA){
+    planA = Ta.packPlan(lay.labelA, Ta.bonds.size() - lay.conBond);
+    Real* packA = bufA.alloc<Real>(planA->elemNum);
+    planA->run(Ta.elem, packA);
+    elemA = packA;
+    blocksA = &planA->blocks;
+  }
+  if(lay.permB){
+    planB = Tb.packPlan(lay.labelB, lay.conBond);
+    Real* packB = bufB.alloc<Real>(planB->elemNum);
+    planB->run(Tb.elem, packB);
+    elemB = packB;
+    blocksB = &planB->blocks;
+  }
+  std::vector<_ContractSector> sectors = contractSectors(*blocksA, *blocksB, Tc, lay);
+  multiplySectors(sectors, lay, elemA, elemB, Tc.elem, false, false, Tc.ongpu, alpha, beta);
+  scaleUncovered(sectors, Tc.blocks, Tc.elem, Tc.ongpu, beta);
+}
+
+void UniTensor::contractPacked(cflag, const UniTensor& Ta, const UniTensor& Tb, const _ContractLayout& lay, UniTensor& Tc, Complex alpha, Complex beta){
+  const Complex* elemA = Ta.c_elem;
+  const Complex* elemB = Tb.c_elem;
+  const std::map<Qnum, Block>* blocksA = &Ta.blocks;
+  const std::map<Qnum, Block>* blocksB = &Tb.blocks;
+  std::shared_ptr<const _PermutePlan> planA, planB;
+  PackBuffer bufA, bufB;
+  if(lay.permA){
+    planA = Ta.packPlan(lay.labelA, Ta.bonds.size() - lay.conBond);
+    Complex* packA = bufA.alloc<Complex>(planA->elemNum);
+    planA->run(Ta.c_elem, packA);
+    elemA = packA;
+    blocksA = &planA->blocks;
+  }
+  if(lay.permB){
+    planB = Tb.packPlan(lay.labelB, lay.conBond);
+    Complex* packB = bufB.alloc<Complex>(planB->elemNum);
+    planB->run(Tb.c_elem, packB);
+    elemB = packB;
+    blocksB = &planB->blocks;
+  }
+  std::vector<_ContractSector> sectors = contractSectors(*blocksA, *blocksB, Tc, lay);
+  multiplySectors(sectors, lay, elemA, elemB, Tc.c_elem, false, false, Tc.ongpu, alpha, beta);
+  scaleUncovered(sectors, Tc.blocks, Tc.c_elem, Tc.ongpu, beta);
+}
+
+std::shared_ptr<const _PermutePlan> UniTensor::packPlan(const std::vector<int>& newLabels, int rowBondNum)const{
+  std::vector<int> rsp_outin(labels.size());
+  for(size_t i = 0; i < labels.size(); i++)
+    for(size_t j = 0; j < newLabels.size(); j++)
+      if(labels[i] == newLabels[j])
+        rsp_outin[j] = i;
+  return permutePlan(rsp_outin, rowBondNum);
+}
+
+void UniTensor::clearContractWorkspace(){
+  releasePool(MEM_CONTRACT);
+}
+
+};	/* namespace uni10 */
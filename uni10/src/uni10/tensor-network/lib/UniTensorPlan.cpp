@@ -0,0 +1,341 @@
+/****************************************************************************
+*  @file UniTensorPlan.cpp
+*  @license
+*    Universal Tensor Network Library
+*    Copyright (c) 2013-2016
+*    National Taiwan University
+*    National Tsing-Hua University
+*
+*    This file is part of Uni10, the Universal Tensor Network Library.
+*
+*    Uni10 is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU Lesser General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    Uni10 is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public License
+*    along with Uni10.  If not, see <http://www.gnu.org/licenses/>.
+*  @endlicense
+*  @brief Permutation plans of UniTensor and their process-wide cache
+*  @author Ying-Jer Kao
+*  @date 2016-06-06
+*  @since 1.0.0
+*
+*****************************************************************************/
+#include <uni10/tools/uni10_tools.h>
+#include <uni10/data-structure/uni10_struct.h>
+#include <uni10/data-structure/Bond.h>
+#include <uni10/tensor-network/UniTensor.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace uni10{
+
+namespace {
+
+typedef std::shared_ptr<const _PermutePlan> PlanPtr;
+typedef std::list<std::pair<std::string, PlanPtr> > PlanList;
+
+struct PermutePlanCache{
+  PermutePlanCache(): capacity(256), hits(0), misses(0){}
+  std::mutex lock;
+  size_t capacity;
+  size_t hits;
+  size_t misses;
+  PlanList lru;   //most recently used first
+  std::unordered_map<std::string, PlanList::iterator> index;
+  void shrink(){
+    while(lru.size() > capacity){
+      index.erase(lru.back().first);
+      lru.pop_back();
+    }
+  }
+};
+
+PermutePlanCache& permuteCache(){
+  static PermutePlanCache cache;
+  return cache;
+}
+
+void appendKey(std::string& key, int val){
+  key.append((const char*)&val, sizeof(val));
+}
+
+/* Below this many elements a permutation is copied by the calling thread only. */
+const size_t PARALLEL_PERMUTE_MIN = 1 << 15;
+
+size_t copySize(const _PermutePlan::Copy& cp){
+  size_t size = 1;
+  for(size_t b = 0; b < cp.dims.size(); b++)
+    size *= cp.dims[b];
+  return size;
+}
+
+bool largerCopy(const _PermutePlan::Copy& a, const _PermutePlan::Copy& b){
+  return copySize(a) > copySize(b);
+}
+
+template<typename T>
+void runCopies(const _PermutePlan& plan, const T* src, T* des){
+  const std::vector<_PermutePlan::Copy>& copies = plan.copies;
+  if(copies.size() > 1 && plan.elemNum >= PARALLEL_PERMUTE_MIN && getThreadNum() > 1){
+    // Destination sub-blocks never overlap, the copies are independent.
+    parallelFor(copies.size(), [&](size_t i){
+      const _PermutePlan::Copy& cp = copies[i];
+      permuteElem(src + cp.srcOff, des + cp.desOff, cp.dims, cp.srcAcc, cp.desAcc, T(cp.sign));
+    });
+    return;
+  }
+  for(size_t i = 0; i < copies.size(); i++){
+    const _PermutePlan::Copy& cp = copies[i];
+    permuteElem(src + cp.srcOff, des + cp.desOff, cp.dims, cp.srcAcc, cp.desAcc, T(cp.sign));
+  }
+}
+
+};  /* namespace */
+
+void _PermutePlan::run(const Real* src, Real* des)const{
+  runCopies(*this, src, des);
+}
+
+void _PermutePlan::run(const Complex* src, Complex* des)const{
+  runCopies(*this, src, des);
+}
+
+size_t UniTensor::permutePlanHits(){
+  PermutePlanCache& cache = permuteCache();
+  std::lock_guard<std::mutex> guard(cache.lock);
+  return cache.hits;
+}
+
+size_t UniTensor::permutePlanMisses(){
+  PermutePlanCache& cache = permuteCache();
+  std::lock_guard<std::mutex> guard(cache.lock);
+  return cache.misses;
+}
+
+void UniTensor::setPermutePlanCacheSize(size_t size){
+  PermutePlanCache& cache = permuteCache();
+  std::lock_guard<std::mutex> guard(cache.lock);
+  cache.capacity = size;
+  cache.shrink();
+}
+
+void UniTensor::clearPermutePlanCache(){
+  PermutePlanCache& cache = permuteCache();
+  std::lock_guard<std::mutex> guard(cache.lock);
+  cache.lru.clear();
+  cache.index.clear();
+  cache.hits = 0;
+  cache.misses = 0;
+}
+
+void UniTensor::initLayout(const _PermutePlan& plan){
+  bonds = plan.bonds;
+  blocks = plan.blocks;
+  RBondNum = plan.RBondNum;
+  RQdim = plan.RQdim;
+  CQdim = plan.CQdim;
+  m_elemNum = plan.elemNum;
+  m_qidx = plan.qidx;
+  bindBlocks();
+  labels.assign(bonds.size(), 0);
+  for(size_t b = 0; b < bonds.size(); b++)
+    labels[b] = b;
+  status |= HAVEBOND;
+}
+
+std::shared_ptr<const _PermutePlan> UniTensor::permutePlan(const std::vector<int>& rsp_outin, int rowBondNum)const{
+  std::string key;
+  appendKey(key, Qnum::isFermionic());
+  appendKey(key, rowBondNum);
+  for(size_t b = 0; b < bonds.size(); b++){
+    appendKey(key, rsp_outin[b]);
+    appendKey(key, bonds[b].type());
+    appendKey(key, bonds[b].Qnums.size());
+    for(size_t q = 0; q < bonds[b].Qnums.size(); q++){
+      appendKey(key, bonds[b].Qnums[q].U1());
+      appendKey(key, bonds[b].Qnums[q].prt());
+      appendKey(key, bonds[b].Qnums[q].prtF());
+      appendKey(key, bonds[b].Qdegs[q]);
+    }
+  }
+  PermutePlanCache& cache = permuteCache();
+  {
+    std::lock_guard<std::mutex> guard(cache.lock);
+    std::unordered_map<std::string, PlanList::iterator>::iterator it = cache.index.find(key);
+    if(it != cache.index.end()){
+      cache.hits++;
+      cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+      return it->second->second;
+    }
+    cache.misses++;
+  }
+  PlanPtr plan = buildPermutePlan(rsp_outin, rowBondNum);
+  std::lock_guard<std::mutex> guard(cache.lock);
+  if(cache.capacity && cache.index.find(key) == cache.index.end()){
+    cache.lru.push_front(std::make_pair(key, plan));
+    cache.index[key] = cache.lru.begin();
+    cache.shrink();
+  }
+  return plan;
+}
+
+std::shared_ptr<const _PermutePlan> UniTensor::buildPermutePlan(const std::vector<int>& rsp_outin, int rowBondNum)const{
+  int bondNum = bonds.size();
+  std::shared_ptr<_PermutePlan> plan(new _PermutePlan);
+  plan->withoutSymmetry = true;
+  for(int b = 0; b < bondNum; b++){
+    plan->bonds.push_back(bonds[rsp_outin[b]]);
+    if(bonds[b].Qnums.size() != 1)
+      plan->withoutSymmetry = false;
+  }
+  for(int b = 0; b < bondNum; b++){
+    if(b < rowBondNum)
+      plan->bonds[b].change(BD_IN);
+    else
+      plan->bonds[b].change(BD_OUT);
+  }
+
+  // Group the permuted bonds on a rank-0 tensor, so that no element of the target is allocated.
+  UniTensor UniTout;
+  UniTout.bonds = plan->bonds;
+  plan->elemNum = UniTout.grouping(RTYPE);
+  plan->blocks = UniTout.blocks;
+  plan->RBondNum = UniTout.RBondNum;
+  plan->RQdim = UniTout.RQdim;
+  plan->CQdim = UniTout.CQdim;
+  plan->qidx = UniTout.m_qidx;
+
+  // Element offsets of the blocks, in the order initBlocks() lays them out.
+  std::map<const Block*, size_t> inBlkOff;
+  std::map<const Block*, size_t> otBlkOff;
+  size_t offset = 0;
+  for(std::map<Qnum, Block>::const_iterator it = blocks.begin(); it != blocks.end(); it++){
+    inBlkOff[&(it->second)] = offset;
+    offset += it->second.Rnum * it->second.Cnum;
+  }
+  offset = 0;
+  for(std::map<Qnum, Block>::const_iterator it = UniTout.blocks.begin(); it != UniTout.blocks.end(); it++){
+    otBlkOff[&(it->second)] = offset;
+    offset += it->second.Rnum * it->second.Cnum;
+  }
+
+  if(plan->withoutSymmetry){
+    _PermutePlan::Copy cp;
+    cp.srcOff = 0;
+    cp.desOff = 0;
+    cp.sign = 1.0;
+    cp.dims.assign(bondNum, 1);
+    cp.srcAcc.assign(bondNum, 1);
+    cp.desAcc.assign(bondNum, 1);
+    std::vector<size_t> newAcc(bondNum, 1);
+    for(int b = bondNum - 1; b > 0; b--){
+      cp.srcAcc[b - 1] = cp.srcAcc[b] * bonds[b].Qdegs[0];
+      newAcc[b - 1] = newAcc[b] * plan->bonds[b].Qdegs[0];
+    }
+    for(int b = 0; b < bondNum; b++){
+      cp.desAcc[rsp_outin[b]] = newAcc[b];
+      cp.dims[b] = bonds[b].Qdegs[0];
+    }
+    plan->copies.push_back(cp);
+    return plan;
+  }
+
+  //For Fermionic system
+  std::vector<_Swap> swaps;
+  if(Qnum::isFermionic()){
+    std::vector<int> inLabelF(bondNum);
+    std::vector<int> outLabelF(bondNum);
+    std::vector<int> ordF(bondNum);
+
+    for(int b = 0; b < RBondNum; b++){
+      inLabelF[b] = b;
+      ordF[b] = b;
+    }
+    for(int b = 0; b < rowBondNum; b++)
+      outLabelF[b] = rsp_outin[b];
+    for(int b = bondNum - 1; b >= RBondNum; b--){
+      ordF[b] = bondNum - b + RBondNum - 1;
+      inLabelF[ordF[b]] = b;
+    }
+    for(int b = bondNum - 1; b >= rowBondNum; b--)
+      outLabelF[bondNum - b + rowBondNum - 1] = rsp_outin[b];
+
+    std::vector<int> rspF_outin(bondNum);
+    for(int i = 0; i < bondNum; i++)
+      for(int j = 0; j < bondNum; j++)
+        if(inLabelF[i] == outLabelF[j])
+          rspF_outin[j] = i;
+    swaps = recSwap(rspF_outin, ordF);
+  }
+  //End Fermionic system
+  std::vector<int> Qin_idxs(bondNum, 0);
+  std::vector<int> Qot_acc(bondNum, 1);
+  std::vector<size_t> sBot_acc(bondNum, 1);
+  for(int b = bondNum - 1; b > 0; b--)
+    Qot_acc[b - 1] = Qot_acc[b] * plan->bonds[b].Qnums.size();
+
+  const _QidxTable& qin = qidxTable();
+  const _QidxTable& qot = *plan->qidx;
+  for(size_t q = 0; q < qin.Qidxs.size(); q++){
+    _PermutePlan::Copy cp;
+    cp.dims.assign(bondNum, 1);
+    cp.srcAcc.assign(bondNum, 1);
+    cp.desAcc.assign(bondNum, 1);
+    int Qin_off = qin.Qidxs[q];
+    int tmp = Qin_off;
+    for(int b = bondNum - 1; b >= 0; b--){
+      int qdim = bonds[b].Qnums.size();
+      Qin_idxs[b] = tmp % qdim;
+      cp.dims[b] = bonds[b].Qdegs[Qin_idxs[b]];
+      tmp /= qdim;
+    }
+    int Qot_off = 0;
+    for(int b = 0; b < bondNum; b++)
+      Qot_off += Qin_idxs[rsp_outin[b]] * Qot_acc[b];
+    int Qin_RQoff = Qin_off / CQdim;
+    int Qin_CQoff = Qin_off % CQdim;
+    int Qot_RQoff = Qot_off / plan->CQdim;
+    int Qot_CQoff = Qot_off % plan->CQdim;
+    const Block* Bin = RQidx2Blk[Qin_RQoff];
+    const Block* Bot = UniTout.RQidx2Blk[Qot_RQoff];
+    cp.srcOff = inBlkOff[Bin] + qin.RQidx2Off[Qin_RQoff] * Bin->Cnum + qin.CQidx2Off[Qin_CQoff];
+    cp.desOff = otBlkOff[Bot] + qot.RQidx2Off[Qot_RQoff] * Bot->Cnum + qot.CQidx2Off[Qot_CQoff];
+    // A sub-block spans rows of its block for the incoming bonds and columns for the outgoing ones.
+    size_t acc = 1;
+    for(int b = bondNum - 1; b >= 0; b--){
+      if(b == RBondNum - 1)
+        acc = Bin->Cnum;
+      cp.srcAcc[b] = acc;
+      acc *= cp.dims[b];
+    }
+    acc = 1;
+    for(int b = bondNum - 1; b >= 0; b--){
+      if(b == rowBondNum - 1)
+        acc = Bot->Cnum;
+      sBot_acc[b] = acc;
+      acc *= cp.dims[rsp_outin[b]];
+    }
+    for(int b = 0; b < bondNum; b++)
+      cp.desAcc[rsp_outin[b]] = sBot_acc[b];
+    cp.sign = 1.0;
+    if(Qnum::isFermionic()){
+      int sign01 = 0;
+      for(size_t i = 0; i < swaps.size(); i++)
+        sign01 ^= (bonds[swaps[i].b1].Qnums[Qin_idxs[swaps[i].b1]].prtF() & bonds[swaps[i].b2].Qnums[Qin_idxs[swaps[i].b2]].prtF());
+      cp.sign = sign01 ? -1.0 : 1.0;
+    }
+    plan->copies.push_back(cp);
+  }
+  std::stable_sort(plan->copies.begin(), plan->copies.end(), largerCopy);
+  return plan;
+}
+
+};	/* namespace uni10 */
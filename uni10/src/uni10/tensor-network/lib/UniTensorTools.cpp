@@ -43,10 +43,13 @@ namespace uni10{
   void RtoC(UniTensor& UniT){
     try{
       if(UniT.typeID() == 1){
+        std::shared_ptr<_ElemStore> real = UniT.m_store;  // Holds the real elements until they are cast
+        Real* src = UniT.elem;
+        bool src_ongpu = UniT.ongpu;
         UniT.r_flag = RNULL;
         UniT.c_flag = CTYPE;
-        UniT.c_elem = (Complex*)elemAlloc( UniT.m_elemNum * sizeof(Complex), UniT.ongpu);
-        elemCast(UniT.c_elem, UniT.elem, UniT.m_elemNum, UniT.ongpu, UniT.ongpu);
+        UniT.TelemAlloc(CTYPE);
+        elemCast(UniT.c_elem, src, UniT.m_elemNum, UniT.ongpu, src_ongpu);
         UniT.initBlocks(CTYPE);
         UniT.elem = NULL;
       }
@@ -82,6 +85,56 @@ namespace uni10{
     }
   }
 
+  UniTensor contract(const UniTensor& _Ta, const UniTensor& _Tb){
+    try{
+      if(_Ta.typeID() == 0 || _Tb.typeID() == 0){
+        std::ostringstream err;
+        err<<"This tensor is EMPTY ";
+        throw std::runtime_error(exception_msg(err.str()));
+      }else if(_Ta.typeID() == 1 && _Tb.typeID() == 1)
+        return contract(RTYPE, _Ta, _Tb);
+      else if(_Ta.typeID() == 2 && _Tb.typeID() == 2)
+        return contract(CTYPE, _Ta, _Tb);
+      else if(_Ta.typeID() == 1 && _Tb.typeID() == 2){
+        UniTensor Ta(_Ta);
+        RtoC(Ta);
+        return contract(CTYPE, static_cast<const UniTensor&>(Ta), _Tb);
+      }else{
+        UniTensor Tb(_Tb);
+        RtoC(Tb);
+        return contract(CTYPE, _Ta, static_cast<const UniTensor&>(Tb));
+      }
+    }
+    catch(const std::exception& e){
+      propogate_exception(e, "In function contract(const uni10::UniTensor&, const uni10::UniTensor&):");
+      return UniTensor();
+    }
+  }
+
+  UniTensor& contract(const UniTensor& _Ta, const UniTensor& _Tb, UniTensor& Tc, Real alpha, Real beta){
+    try{
+      if(_Ta.typeID() == 0 || _Tb.typeID() == 0 || Tc.typeID() == 0){
+        std::ostringstream err;
+        err<<"This tensor is EMPTY ";
+        throw std::runtime_error(exception_msg(err.str()));
+      }else if(Tc.typeID() == 1)
+        return contract(RTYPE, _Ta, _Tb, Tc, alpha, beta);
+      else if(_Ta.typeID() == 2 && _Tb.typeID() == 2)
+        return contract(CTYPE, _Ta, _Tb, Tc, Complex(alpha), Complex(beta));
+      else{
+        UniTensor Ta(_Ta);
+        UniTensor Tb(_Tb);
+        RtoC(Ta);
+        RtoC(Tb);
+        return contract(CTYPE, Ta, Tb, Tc, Complex(alpha), Complex(beta));
+      }
+    }
+    catch(const std::exception& e){
+      propogate_exception(e, "In function contract(const uni10::UniTensor&, const uni10::UniTensor&, uni10::UniTensor&, double, double):");
+    }
+    return Tc;
+  }
+
   UniTensor otimes(const UniTensor & Ta, const UniTensor& Tb){
     try{
       UniTensor T1 = Ta;
@@ -113,6 +166,9 @@ namespace uni10{
   UniTensor contract(rflag tp, UniTensor& Ta, UniTensor& Tb, bool fast){
     try{
       throwTypeError(tp);
+      // Packing leaves the operands as they are, which saves permuting them back.
+      if(!fast && !Ta.ongpu && !Tb.ongpu)
+        return contract(RTYPE, static_cast<const UniTensor&>(Ta), static_cast<const UniTensor&>(Tb));
       if(!(Ta.status & Tb.status & Ta.HAVEELEM)){
         std::ostringstream err;
         err<<"Cannot perform contraction of two tensors before setting their elements.";
@@ -130,66 +186,18 @@ namespace uni10{
         std::vector<int> oldLabelB = Tb.labels;
         int oldRnumA = Ta.RBondNum;
         int oldRnumB = Tb.RBondNum;
-        std::vector<int> newLabelA;
-        std::vector<int> interLabel;
-        std::vector<int> newLabelB;
-        std::vector<int> markB(BbondNum, 0);
-        std::vector<int> newLabelC;
-        bool match;
-        for(int a = 0; a < AbondNum; a++){
-          match = false;
-          for(int b = 0; b < BbondNum; b++)
-            if(Ta.labels[a] == Tb.labels[b]){
-              markB[b] = 1;
-              interLabel.push_back(Ta.labels[a]);
-              newLabelB.push_back(Tb.labels[b]);
-              if(!(Ta.bonds[a].dim() == Tb.bonds[b].dim())){
-                std::ostringstream err;
-                err<<"Cannot contract two bonds having different dimensions";
-                throw std::runtime_error(exception_msg(err.str()));
-              }
-              match = true;
-              break;
-            }
-          if(!match){
-            newLabelA.push_back(Ta.labels[a]);
-            newLabelC.push_back(Ta.labels[a]);
-          }
-        }
-        for(size_t a = 0; a < interLabel.size(); a++)
-          newLabelA.push_back(interLabel[a]);
-        for(int b = 0; b < BbondNum; b++)
-          if(markB[b] == 0){
-            newLabelB.push_back(Tb.labels[b]);
-            newLabelC.push_back(Tb.labels[b]);
-          }
-        int conBond = interLabel.size();
-        Ta.permute(RTYPE, newLabelA, AbondNum - conBond);
-        Tb.permute(RTYPE, newLabelB, conBond);
-        std::vector<Bond> cBonds;
-        for(int i = 0; i < AbondNum - conBond; i++)
-          cBonds.push_back(Ta.bonds[i]);
-        for(int i = conBond; i < BbondNum; i++)
-          cBonds.push_back(Tb.bonds[i]);
-        UniTensor Tc(RTYPE, cBonds);
-        if(cBonds.size())
+        _ContractLayout lay = UniTensor::contractLayout(Ta, Tb);
+        int conBond = lay.conBond;
+        std::vector<int> newLabelC = lay.labelC;
+        if(lay.permA)
+          Ta.permute(RTYPE, lay.labelA, AbondNum - conBond);
+        if(lay.permB)
+          Tb.permute(RTYPE, lay.labelB, conBond);
+        UniTensor Tc(RTYPE, lay.cBonds);
+        if(lay.cBonds.size())
           Tc.setLabel(newLabelC);
-        Block blockA, blockB, blockC;
-        std::map<Qnum, Block>::iterator it;
-        std::map<Qnum, Block>::iterator it2;
-        for(it = Ta.blocks.begin() ; it != Ta.blocks.end(); it++){
-          if((it2 = Tb.blocks.find(it->first)) != Tb.blocks.end()){
-            blockA = it->second;
-            blockB = it2->second;
-            blockC = Tc.blocks[it->first];
-            if(!(blockA.row() == blockC.row() && blockB.col() == blockC.col() && blockA.col() == blockB.row())){
-              std::ostringstream err;
-              err<<"The dimensions the bonds to be contracted out are different.";
-              throw std::runtime_error(exception_msg(err.str()));
-            }
-            matrixMul(blockA.getElem(RTYPE), blockB.getElem(RTYPE), blockA.row(), blockB.col(), blockA.col(), blockC.getElem(RTYPE), Ta.ongpu, Tb.ongpu, Tc.ongpu);
-          }
-        }
+        std::vector<_ContractSector> sectors = UniTensor::contractSectors(Ta.blocks, Tb.blocks, Tc, lay);
+        UniTensor::multiplySectors(sectors, lay, Ta.elem, Tb.elem, Tc.elem, Ta.ongpu, Tb.ongpu, Tc.ongpu);
         Tc.status |= Tc.HAVEELEM;
 
         if(conBond == 0){	//Outer product
@@ -214,8 +222,10 @@ namespace uni10{
         }
 
         if(!fast){
-          Ta.permute(RTYPE, oldLabelA, oldRnumA);
-          Tb.permute(RTYPE, oldLabelB, oldRnumB);
+          if(lay.permA)
+            Ta.permute(RTYPE, oldLabelA, oldRnumA);
+          if(lay.permB)
+            Tb.permute(RTYPE, oldLabelB, oldRnumB);
         }
         return Tc;
       }
@@ -232,6 +242,129 @@ namespace uni10{
     }
   }
 
+  UniTensor contract(rflag tp, const UniTensor& Ta, const UniTensor& Tb){
+    try{
+      throwTypeError(tp);
+      if(!(Ta.status & Tb.status & Ta.HAVEELEM)){
+        std::ostringstream err;
+        err<<"Cannot perform contraction of two tensors before setting their elements.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      if(Ta.ongpu || Tb.ongpu){
+        // Operands are only packed on the host, device tensors are contracted through copies.
+        UniTensor cTa = Ta;
+        UniTensor cTb = Tb;
+        return contract(RTYPE, cTa, cTb, true);
+      }
+
+      if(Ta.status & Ta.HAVEBOND && Tb.status & Ta.HAVEBOND){
+        int AbondNum = Ta.bonds.size();
+        int BbondNum = Tb.bonds.size();
+        _ContractLayout lay = UniTensor::contractLayout(Ta, Tb);
+        int conBond = lay.conBond;
+        std::vector<int> newLabelC = lay.labelC;
+        UniTensor Tc(RTYPE, lay.cBonds);
+        if(lay.cBonds.size())
+          Tc.setLabel(newLabelC);
+        UniTensor::contractPacked(RTYPE, Ta, Tb, lay, Tc, 1.0, 0.0);
+        Tc.status |= Tc.HAVEELEM;
+
+        if(conBond == 0){	//Outer product
+          int idx = 0;
+          for(int i = 0; i < Ta.RBondNum; i++){
+            newLabelC[idx] = Ta.labels[i];
+            idx++;
+          }
+          for(int i = 0; i < Tb.RBondNum; i++){
+            newLabelC[idx] = Tb.labels[i];
+            idx++;
+          }
+          for(int i = Ta.RBondNum; i < AbondNum; i++){
+            newLabelC[idx] = Ta.labels[i];
+            idx++;
+          }
+          for(int i = Tb.RBondNum; i < BbondNum; i++){
+            newLabelC[idx] = Tb.labels[i];
+            idx++;
+          }
+          Tc.permute(newLabelC, Ta.RBondNum + Tb.RBondNum);
+        }
+        return Tc;
+      }
+      else if(Ta.status & Ta.HAVEBOND)
+        return Ta * Tb.at(RTYPE, 0);
+      else if(Tb.status & Tb.HAVEBOND)
+        return Ta.at(RTYPE, 0) * Tb;
+      else
+        return UniTensor(Ta.at(RTYPE, 0) * Tb.at(RTYPE, 0));
+    }
+    catch(const std::exception& e){
+      propogate_exception(e, "In function contract(uni10::rflag, const uni10::UniTensor&, const uni10::UniTensor&):");
+      return UniTensor();
+    }
+  }
+
+  UniTensor& contract(rflag tp, const UniTensor& Ta, const UniTensor& Tb, UniTensor& Tc, Real alpha, Real beta){
+    try{
+      throwTypeError(tp);
+      if(!(Ta.status & Tb.status & Ta.HAVEELEM)){
+        std::ostringstream err;
+        err<<"Cannot perform contraction of two tensors before setting their elements.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      if(Ta.typeID() != 1 || Tb.typeID() != 1 || Tc.typeID() != 1){
+        std::ostringstream err;
+        err<<"The operands and the output tensor must all be Real(RTYPE) UniTensors.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      if(&Tc == &Ta || &Tc == &Tb){
+        std::ostringstream err;
+        err<<"The output tensor cannot be one of the tensors to be contracted.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      if(beta != 0.0 && !(Tc.status & Tc.HAVEELEM)){
+        std::ostringstream err;
+        err<<"Cannot accumulate into a tensor before setting its elements.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      Tc.TelemDetach();
+      if(Ta.status & Ta.HAVEBOND && Tb.status & Tb.HAVEBOND && !Ta.ongpu && !Tb.ongpu){
+        _ContractLayout lay = UniTensor::contractLayout(Ta, Tb);
+        if(lay.conBond > 0){
+          if(!(Tc.bonds == lay.cBonds && Tc.labels == lay.labelC)){
+            std::ostringstream err;
+            err<<"The bonds and labels of the output tensor do not match the result of the contraction.";
+            throw std::runtime_error(exception_msg(err.str()));
+          }
+          UniTensor::contractPacked(RTYPE, Ta, Tb, lay, Tc, alpha, beta);
+          Tc.status |= Tc.HAVEELEM;
+          return Tc;
+        }
+      }
+      // Outer products are reordered after the multiplication, they and the rest go through a new tensor.
+      UniTensor T = contract(RTYPE, Ta, Tb);
+      if(!(Tc.bonds == T.bonds && Tc.labels == T.labels)){
+        std::ostringstream err;
+        err<<"The bonds and labels of the output tensor do not match the result of the contraction.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      if(beta == 0.0){
+        elemCopy(Tc.elem, T.elem, T.m_elemNum * sizeof(Real), Tc.ongpu, T.ongpu);
+        vectorScal(alpha, Tc.elem, Tc.m_elemNum, Tc.ongpu);
+      }
+      else{
+        vectorScal(beta, Tc.elem, Tc.m_elemNum, Tc.ongpu);
+        vectorScal(alpha, T.elem, T.m_elemNum, T.ongpu);
+        vectorAdd(Tc.elem, T.elem, T.m_elemNum, Tc.ongpu, T.ongpu);
+      }
+      Tc.status |= Tc.HAVEELEM;
+    }
+    catch(const std::exception& e){
+      propogate_exception(e, "In function contract(uni10::rflag, const uni10::UniTensor&, const uni10::UniTensor&, uni10::UniTensor&, double, double):");
+    }
+    return Tc;
+  }
+
   UniTensor otimes(rflag tp, const UniTensor & Ta, const UniTensor& Tb){
     try{
       throwTypeError(tp);
@@ -264,6 +397,9 @@ namespace uni10{
   UniTensor contract(cflag tp, UniTensor& Ta, UniTensor& Tb, bool fast){
     try{
       throwTypeError(tp);
+      // Packing leaves the operands as they are, which saves permuting them back.
+      if(!fast && !Ta.ongpu && !Tb.ongpu)
+        return contract(CTYPE, static_cast<const UniTensor&>(Ta), static_cast<const UniTensor&>(Tb));
       if(!(Ta.status & Tb.status & Ta.HAVEELEM)){
         std::ostringstream err;
         err<<"Cannot perform contraction of two tensors before setting their elements.";
@@ -281,66 +417,18 @@ namespace uni10{
         std::vector<int> oldLabelB = Tb.labels;
         int oldRnumA = Ta.RBondNum;
         int oldRnumB = Tb.RBondNum;
-        std::vector<int> newLabelA;
-        std::vector<int> interLabel;
-        std::vector<int> newLabelB;
-        std::vector<int> markB(BbondNum, 0);
-        std::vector<int> newLabelC;
-        bool match;
-        for(int a = 0; a < AbondNum; a++){
-          match = false;
-          for(int b = 0; b < BbondNum; b++)
-            if(Ta.labels[a] == Tb.labels[b]){
-              markB[b] = 1;
-              interLabel.push_back(Ta.labels[a]);
-              newLabelB.push_back(Tb.labels[b]);
-              if(!(Ta.bonds[a].dim() == Tb.bonds[b].dim())){
-                std::ostringstream err;
-                err<<"Cannot contract two bonds having different dimensions";
-                throw std::runtime_error(exception_msg(err.str()));
-              }
-              match = true;
-              break;
-            }
-          if(!match){
-            newLabelA.push_back(Ta.labels[a]);
-            newLabelC.push_back(Ta.labels[a]);
-          }
-        }
-        for(size_t a = 0; a < interLabel.size(); a++)
-          newLabelA.push_back(interLabel[a]);
-        for(int b = 0; b < BbondNum; b++)
-          if(markB[b] == 0){
-            newLabelB.push_back(Tb.labels[b]);
-            newLabelC.push_back(Tb.labels[b]);
-          }
-        int conBond = interLabel.size();
-        Ta.permute(CTYPE, newLabelA, AbondNum - conBond);
-        Tb.permute(CTYPE, newLabelB, conBond);
-        std::vector<Bond> cBonds;
-        for(int i = 0; i < AbondNum - conBond; i++)
-          cBonds.push_back(Ta.bonds[i]);
-        for(int i = conBond; i < BbondNum; i++)
-          cBonds.push_back(Tb.bonds[i]);
-        UniTensor Tc(CTYPE, cBonds);
-        if(cBonds.size())
+        _ContractLayout lay = UniTensor::contractLayout(Ta, Tb);
+        int conBond = lay.conBond;
+        std::vector<int> newLabelC = lay.labelC;
+        if(lay.permA)
+          Ta.permute(CTYPE, lay.labelA, AbondNum - conBond);
+        if(lay.permB)
+          Tb.permute(CTYPE, lay.labelB, conBond);
+        UniTensor Tc(CTYPE, lay.cBonds);
+        if(lay.cBonds.size())
           Tc.setLabel(newLabelC);
-        Block blockA, blockB, blockC;
-        std::map<Qnum, Block>::iterator it;
-        std::map<Qnum, Block>::iterator it2;
-        for(it = Ta.blocks.begin() ; it != Ta.blocks.end(); it++){
-          if((it2 = Tb.blocks.find(it->first)) != Tb.blocks.end()){
-            blockA = it->second;
-            blockB = it2->second;
-            blockC = Tc.blocks[it->first];
-            if(!(blockA.row() == blockC.row() && blockB.col() == blockC.col() && blockA.col() == blockB.row())){
-              std::ostringstream err;
-              err<<"The dimensions the bonds to be contracted out are different.";
-              throw std::runtime_error(exception_msg(err.str()));
-            }
-            matrixMul(blockA.getElem(CTYPE), blockB.getElem(CTYPE), blockA.row(), blockB.col(), blockA.col(), blockC.getElem(CTYPE), Ta.ongpu, Tb.ongpu, Tc.ongpu);
-          }
-        }
+        std::vector<_ContractSector> sectors = UniTensor::contractSectors(Ta.blocks, Tb.blocks, Tc, lay);
+        UniTensor::multiplySectors(sectors, lay, Ta.c_elem, Tb.c_elem, Tc.c_elem, Ta.ongpu, Tb.ongpu, Tc.ongpu);
         Tc.status |= Tc.HAVEELEM;
 
         if(conBond == 0){	//Outer product
@@ -365,8 +453,10 @@ namespace uni10{
         }
 
         if(!fast){
-          Ta.permute(CTYPE, oldLabelA, oldRnumA);
-          Tb.permute(CTYPE, oldLabelB, oldRnumB);
+          if(lay.permA)
+            Ta.permute(CTYPE, oldLabelA, oldRnumA);
+          if(lay.permB)
+            Tb.permute(CTYPE, oldLabelB, oldRnumB);
         }
         return Tc;
       }
@@ -383,6 +473,129 @@ namespace uni10{
     }
   }
 
+  UniTensor contract(cflag tp, const UniTensor& Ta, const UniTensor& Tb){
+    try{
+      throwTypeError(tp);
+      if(!(Ta.status & Tb.status & Ta.HAVEELEM)){
+        std::ostringstream err;
+        err<<"Cannot perform contraction of two tensors before setting their elements.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      if(Ta.ongpu || Tb.ongpu){
+        // Operands are only packed on the host, device tensors are contracted through copies.
+        UniTensor cTa = Ta;
+        UniTensor cTb = Tb;
+        return contract(CTYPE, cTa, cTb, true);
+      }
+
+      if(Ta.status & Ta.HAVEBOND && Tb.status & Ta.HAVEBOND){
+        int AbondNum = Ta.bonds.size();
+        int BbondNum = Tb.bonds.size();
+        _ContractLayout lay = UniTensor::contractLayout(Ta, Tb);
+        int conBond = lay.conBond;
+        std::vector<int> newLabelC = lay.labelC;
+        UniTensor Tc(CTYPE, lay.cBonds);
+        if(lay.cBonds.size())
+          Tc.setLabel(newLabelC);
+        UniTensor::contractPacked(CTYPE, Ta, Tb, lay, Tc, 1.0, 0.0);
+        Tc.status |= Tc.HAVEELEM;
+
+        if(conBond == 0){	//Outer product
+          int idx = 0;
+          for(int i = 0; i < Ta.RBondNum; i++){
+            newLabelC[idx] = Ta.labels[i];
+            idx++;
+          }
+          for(int i = 0; i < Tb.RBondNum; i++){
+            newLabelC[idx] = Tb.labels[i];
+            idx++;
+          }
+          for(int i = Ta.RBondNum; i < AbondNum; i++){
+            newLabelC[idx] = Ta.labels[i];
+            idx++;
+          }
+          for(int i = Tb.RBondNum; i < BbondNum; i++){
+            newLabelC[idx] = Tb.labels[i];
+            idx++;
+          }
+          Tc.permute(newLabelC, Ta.RBondNum + Tb.RBondNum);
+        }
+        return Tc;
+      }
+      else if(Ta.status & Ta.HAVEBOND)
+        return Ta * Tb.at(CTYPE, 0);
+      else if(Tb.status & Tb.HAVEBOND)
+        return Ta.at(CTYPE, 0) * Tb;
+      else
+        return UniTensor(Ta.at(CTYPE, 0) * Tb.at(CTYPE, 0));
+    }
+    catch(const std::exception& e){
+      propogate_exception(e, "In function contract(uni10::cflag, const uni10::UniTensor&, const uni10::UniTensor&):");
+      return UniTensor();
+    }
+  }
+
+  UniTensor& contract(cflag tp, const UniTensor& Ta, const UniTensor& Tb, UniTensor& Tc, Complex alpha, Complex beta){
+    try{
+      throwTypeError(tp);
+      if(!(Ta.status & Tb.status & Ta.HAVEELEM)){
+        std::ostringstream err;
+        err<<"Cannot perform contraction of two tensors before setting their elements.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      if(Ta.typeID() != 2 || Tb.typeID() != 2 || Tc.typeID() != 2){
+        std::ostringstream err;
+        err<<"The operands and the output tensor must all be Complex(CTYPE) UniTensors.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      if(&Tc == &Ta || &Tc == &Tb){
+        std::ostringstream err;
+        err<<"The output tensor cannot be one of the tensors to be contracted.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      if(beta != Complex(0.0) && !(Tc.status & Tc.HAVEELEM)){
+        std::ostringstream err;
+        err<<"Cannot accumulate into a tensor before setting its elements.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      Tc.TelemDetach();
+      if(Ta.status & Ta.HAVEBOND && Tb.status & Tb.HAVEBOND && !Ta.ongpu && !Tb.ongpu){
+        _ContractLayout lay = UniTensor::contractLayout(Ta, Tb);
+        if(lay.conBond > 0){
+          if(!(Tc.bonds == lay.cBonds && Tc.labels == lay.labelC)){
+            std::ostringstream err;
+            err<<"The bonds and labels of the output tensor do not match the result of the contraction.";
+            throw std::runtime_error(exception_msg(err.str()));
+          }
+          UniTensor::contractPacked(CTYPE, Ta, Tb, lay, Tc, alpha, beta);
+          Tc.status |= Tc.HAVEELEM;
+          return Tc;
+        }
+      }
+      // Outer products are reordered after the multiplication, they and the rest go through a new tensor.
+      UniTensor T = contract(CTYPE, Ta, Tb);
+      if(!(Tc.bonds == T.bonds && Tc.labels == T.labels)){
+        std::ostringstream err;
+        err<<"The bonds and labels of the output tensor do not match the result of the contraction.";
+        throw std::runtime_error(exception_msg(err.str()));
+      }
+      if(beta == Complex(0.0)){
+        elemCopy(Tc.c_elem, T.c_elem, T.m_elemNum * sizeof(Complex), Tc.ongpu, T.ongpu);
+        vectorScal(alpha, Tc.c_elem, Tc.m_elemNum, Tc.ongpu);
+      }
+      else{
+        vectorScal(beta, Tc.c_elem, Tc.m_elemNum, Tc.ongpu);
+        vectorScal(alpha, T.c_elem, T.m_elemNum, T.ongpu);
+        vectorAdd(Tc.c_elem, T.c_elem, T.m_elemNum, Tc.ongpu, T.ongpu);
+      }
+      Tc.status |= Tc.HAVEELEM;
+    }
+    catch(const std::exception& e){
+      propogate_exception(e, "In function contract(uni10::cflag, const uni10::UniTensor&, const uni10::UniTensor&, uni10::UniTensor&, uni10::Complex, uni10::Complex):");
+    }
+    return Tc;
+  }
+
   UniTensor otimes(cflag tp, const UniTensor & Ta, const UniTensor& Tb){
     try{
       throwTypeError(tp);
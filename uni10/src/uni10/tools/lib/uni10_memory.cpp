@@ -0,0 +1,252 @@
+/****************************************************************************
+*  @file uni10_memory.cpp
+*  @license
+*    Universal Tensor Network Library
+*    Copyright (c) 2013-2016
+*    National Taiwan University
+*    National Tsing-Hua University
+
+*
+*    This file is part of Uni10, the Universal Tensor Network Library.
+*
+*    Uni10 is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU Lesser General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    Uni10 is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public License
+*    along with Uni10.  If not, see <http://www.gnu.org/licenses/>.
+*  @endlicense
+*  @brief Accounting, budget and trace of the host memory
+*  @author Ying-Jer Kao
+*  @date 2016-06-06
+*  @since 1.0.0
+*
+*****************************************************************************/
+#include <uni10/tools/uni10_tools.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+namespace uni10 {
+
+namespace {
+
+const char* TAG_NAMES[MEM_TAG_NUM] = {"tensor", "matrix", "lapack", "network", "contract"};
+
+thread_local const MemoryScope* CURRENT_SCOPE = NULL;
+
+struct TraceEvent {
+    size_t bytes;
+    memTag tag;
+    std::string site;
+    double allocTime;
+    double freeTime;
+};
+
+// Never destroyed, since buffers of static tensors are released after the end of main().
+struct Telemetry {
+    Telemetry(): total(0), peakTotal(0), budget(0), tracing(false), firstId(0) {
+        for(int t = 0; t < MEM_TAG_NUM; t++) {
+            current[t] = 0;
+            peak[t] = 0;
+        }
+    }
+    std::atomic<size_t> current[MEM_TAG_NUM];
+    std::atomic<size_t> peak[MEM_TAG_NUM];
+    std::atomic<size_t> total;
+    std::atomic<size_t> peakTotal;
+    std::atomic<size_t> budget;
+    std::atomic<bool> tracing;
+    std::mutex lock;    // guards peakSite and the trace
+    std::string peakSite;
+    std::vector<TraceEvent> events;
+    size_t firstId;     // trace ids keep counting across traces, so that late frees cannot hit a new trace
+    std::chrono::steady_clock::time_point start;
+    double now() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+Telemetry& telemetry() {
+    static Telemetry* tel = new Telemetry;
+    return *tel;
+}
+
+void raise(std::atomic<size_t>& peak, size_t value) {
+    size_t old = peak.load();
+    while(value > old && !peak.compare_exchange_weak(old, value));
+}
+
+void jsonString(std::ostream& os, const std::string& str) {
+    os << '"';
+    for(size_t i = 0; i < str.size(); i++) {
+        char c = str[i];
+        if(c == '"' || c == '\\')
+            os << '\\' << c;
+        else if((unsigned char)c < 0x20)
+            os << ' ';
+        else
+            os << c;
+    }
+    os << '"';
+}
+
+}  // namespace
+
+MemoryBudgetError::MemoryBudgetError(const std::string& msg, size_t requested, size_t usage, size_t budget):
+    std::runtime_error(msg), m_requested(requested), m_usage(usage), m_budget(budget) {}
+
+MemoryScope::MemoryScope(const std::string& _site, memTag _tag): prev(CURRENT_SCOPE), tag(_tag) {
+    if(tag == MEM_TAG_NUM && prev != NULL)
+        tag = prev->tag;
+    site = prev != NULL && prev->site.size() ? prev->site + "/" + _site : _site;
+    CURRENT_SCOPE = this;
+}
+
+MemoryScope::MemoryScope(const MemoryScope* adopt): prev(CURRENT_SCOPE), tag(MEM_TAG_NUM) {
+    if(adopt != NULL) {
+        tag = adopt->tag;
+        site = adopt->site;
+    }
+    CURRENT_SCOPE = this;
+}
+
+MemoryScope::~MemoryScope() {
+    CURRENT_SCOPE = prev;
+}
+
+const MemoryScope* MemoryScope::current() {
+    return CURRENT_SCOPE;
+}
+
+size_t memAcquire(size_t memsize, memTag& tag) {
+    Telemetry& tel = telemetry();
+    const MemoryScope* scope = CURRENT_SCOPE;
+    if(scope != NULL && scope->tag != MEM_TAG_NUM)
+        tag = scope->tag;
+    size_t total = (tel.total += memsize);
+    size_t budget = tel.budget.load(std::memory_order_relaxed);
+    if(budget && total > budget) {
+        tel.total -= memsize;
+        std::ostringstream err;
+        err<<"Allocating "<<memsize<<" bytes for "<<TAG_NAMES[tag];
+        if(scope != NULL && scope->site.size())
+            err<<" in "<<scope->site;
+        err<<" exceeds the memory budget of "<<budget<<" bytes, with "<<total - memsize<<" bytes in use.";
+        throw MemoryBudgetError(exception_msg(err.str()), memsize, total - memsize, budget);
+    }
+    raise(tel.peak[tag], tel.current[tag] += memsize);
+    if(total > tel.peakTotal.load(std::memory_order_relaxed)) {
+        size_t old = tel.peakTotal.load();
+        while(total > old && !tel.peakTotal.compare_exchange_weak(old, total));
+        if(total > old) {
+            std::lock_guard<std::mutex> lk(tel.lock);
+            tel.peakSite = scope != NULL ? scope->site : "";
+        }
+    }
+    if(!tel.tracing.load(std::memory_order_relaxed))
+        return 0;
+    std::lock_guard<std::mutex> lk(tel.lock);
+    if(!tel.tracing)
+        return 0;
+    TraceEvent ev = {memsize, tag, scope != NULL ? scope->site : "", tel.now(), -1};
+    tel.events.push_back(ev);
+    return tel.firstId + tel.events.size();
+}
+
+void memRelease(size_t memsize, memTag tag, size_t traceId) {
+    Telemetry& tel = telemetry();
+    tel.total -= memsize;
+    tel.current[tag] -= memsize;
+    if(traceId) {
+        std::lock_guard<std::mutex> lk(tel.lock);
+        if(traceId > tel.firstId && traceId - tel.firstId <= tel.events.size())
+            tel.events[traceId - tel.firstId - 1].freeTime = tel.now();
+    }
+}
+
+MemoryUsage getMemoryUsage() {
+    Telemetry& tel = telemetry();
+    MemoryUsage usage;
+    for(int t = 0; t < MEM_TAG_NUM; t++) {
+        usage.current[t] = tel.current[t];
+        usage.peak[t] = tel.peak[t];
+    }
+    usage.total = tel.total;
+    usage.peakTotal = tel.peakTotal;
+    usage.budget = tel.budget;
+    std::lock_guard<std::mutex> lk(tel.lock);
+    usage.peakSite = tel.peakSite;
+    return usage;
+}
+
+void resetMemoryPeaks() {
+    Telemetry& tel = telemetry();
+    for(int t = 0; t < MEM_TAG_NUM; t++)
+        tel.peak[t] = tel.current[t].load();
+    tel.peakTotal = tel.total.load();
+    std::lock_guard<std::mutex> lk(tel.lock);
+    tel.peakSite.clear();
+}
+
+void setMemoryBudget(size_t bytes) {
+    telemetry().budget = bytes;
+}
+
+void setMemoryTrace(bool on) {
+    Telemetry& tel = telemetry();
+    std::lock_guard<std::mutex> lk(tel.lock);
+    if(on && !tel.tracing) {
+        tel.firstId += tel.events.size();
+        tel.events.clear();
+        tel.start = std::chrono::steady_clock::now();
+    }
+    tel.tracing = on;
+}
+
+void dumpMemoryTrace(const std::string& fname) {
+    try {
+        std::ofstream os(fname.c_str());
+        if(!os) {
+            std::ostringstream err;
+            err<<"Error in opening file '"<<fname<<"'.";
+            throw std::runtime_error(exception_msg(err.str()));
+        }
+        MemoryUsage usage = getMemoryUsage();
+        os << "{\n  \"budget\": " << usage.budget << ",\n  \"current\": " << usage.total
+           << ",\n  \"peak\": " << usage.peakTotal << ",\n  \"peakSite\": ";
+        jsonString(os, usage.peakSite);
+        os << ",\n  \"subsystems\": {";
+        for(int t = 0; t < MEM_TAG_NUM; t++)
+            os << (t ? ", " : "") << "\"" << TAG_NAMES[t] << "\": {\"current\": " << usage.current[t]
+               << ", \"peak\": " << usage.peak[t] << "}";
+        os << "},\n  \"allocations\": [";
+        Telemetry& tel = telemetry();
+        std::lock_guard<std::mutex> lk(tel.lock);
+        for(size_t i = 0; i < tel.events.size(); i++) {
+            const TraceEvent& ev = tel.events[i];
+            os << (i ? ",\n" : "\n") << "    {\"id\": " << tel.firstId + i + 1 << ", \"bytes\": " << ev.bytes
+               << ", \"subsystem\": \"" << TAG_NAMES[ev.tag] << "\", \"site\": ";
+            jsonString(os, ev.site);
+            os << ", \"allocTime\": " << ev.allocTime << ", \"freeTime\": ";
+            if(ev.freeTime < 0)
+                os << "null";
+            else
+                os << ev.freeTime;
+            os << "}";
+        }
+        os << "\n  ]\n}\n";
+    }
+    catch(const std::exception& e) {
+        propogate_exception(e, "In function dumpMemoryTrace(std::string&):");
+    }
+}
+
+};  /* namespace uni10 */
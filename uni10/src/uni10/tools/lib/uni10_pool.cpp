@@ -0,0 +1,386 @@
+/****************************************************************************
+*  @file uni10_pool.cpp
+*  @license
+*    Universal Tensor Network Library
+*    Copyright (c) 2013-2016
+*    National Taiwan University
+*    National Tsing-Hua University
+
+*
+*    This file is part of Uni10, the Universal Tensor Network Library.
+*
+*    Uni10 is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU Lesser General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    Uni10 is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public License
+*    along with Uni10.  If not, see <http://www.gnu.org/licenses/>.
+*  @endlicense
+*  @brief Size-class memory pool behind the host element buffers
+*  @author Ying-Jer Kao
+*  @date 2016-06-06
+*  @since 1.0.0
+*
+*****************************************************************************/
+#include <uni10/tools/uni10_tools.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace uni10 {
+
+namespace {
+
+// Every block starts with a header recording its size class, so that poolFree() needs no size. Blocks and
+// headers are both UNI10_ALIGNMENT bytes, which keeps the returned buffers aligned.
+const size_t HEADER = UNI10_ALIGNMENT;
+// Classes step by a quarter of a power of two from 64 bytes, which bounds the rounding waste by 25%.
+const size_t CLASS_NUM = 1 + 4 * 40;
+const size_t UNPOOLED = CLASS_NUM;
+// Blocks above this size bypass the thread caches and are recycled through the shared lists.
+const size_t LARGE = ((size_t)1) << 18;
+const size_t THREAD_CAP = ((size_t)4) << 20;
+const size_t DEFAULT_LIMIT = ((size_t)256) << 20;
+
+size_t classOf(size_t bytes) {
+    if(bytes <= 64)
+        return 0;
+    int hb = 63 - __builtin_clzll((unsigned long long)(bytes - 1));
+    size_t q = (bytes - 1) >> (hb - 2);
+    size_t cls = 1 + 4 * (hb - 6) + (q - 4);
+    return cls < CLASS_NUM ? cls : UNPOOLED;
+}
+
+size_t classBytes(size_t cls) {
+    if(cls == 0)
+        return 64;
+    size_t hb = 6 + (cls - 1) / 4;
+    return (5 + (cls - 1) % 4) << (hb - 2);
+}
+
+// Also carries the accounting of the buffer, see memAcquire(), and the tag it was requested for, which
+// releasePool() selects on after the buffer is freed.
+struct Header {
+    size_t cls;
+    size_t memsize;
+    size_t traceId;
+    memTag tag;
+    memTag request;
+};
+
+bool requestedFor(void* blk, memTag tag) {
+    return tag == MEM_TAG_NUM || ((Header*)blk)->request == tag;
+}
+
+bool envEnabled() {
+    const char* env = getenv("UNI10_POOL");
+    return env == NULL || atoi(env) != 0;
+}
+
+numaPolicy envNumaPolicy() {
+    const char* env = getenv("UNI10_NUMA");
+    if(env == NULL)
+        return NUMA_DEFAULT;
+    std::string name(env);
+    if(name == "interleave")
+        return NUMA_INTERLEAVE;
+    if(name == "firsttouch")
+        return NUMA_FIRST_TOUCH;
+    return NUMA_DEFAULT;
+}
+
+std::atomic<int> NUMA_POLICY(envNumaPolicy());
+
+// Bit mask of the online NUMA nodes, parsed from a list like "0-1,4".
+unsigned long onlineNodes() {
+    std::ifstream file("/sys/devices/system/node/online");
+    unsigned long mask = 0;
+    int lo, hi;
+    char sep;
+    while(file >> lo) {
+        hi = lo;
+        if(file.peek() == '-')
+            file >> sep >> hi;
+        for(int n = lo; n <= hi && n < 64; n++)
+            mask |= 1UL << n;
+        if(file.peek() != ',')
+            break;
+        file >> sep;
+    }
+    return mask;
+}
+
+// Spreads the whole pages of a fresh block over all nodes. Placement is a hint, so failures are ignored.
+void interleave(void* blk, size_t bytes) {
+#ifdef __linux__
+    static const unsigned long nodes = onlineNodes();
+    if((nodes & (nodes - 1)) == 0)
+        return;
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t lo = ((size_t)blk + page - 1) / page * page;
+    size_t hi = ((size_t)blk + bytes) / page * page;
+    if(hi > lo)
+        syscall(SYS_mbind, (void*)lo, hi - lo, 3 /* MPOL_INTERLEAVE */, &nodes, 64, 0);
+#endif
+}
+
+void* sysAlloc(size_t bytes) {
+    void* blk = NULL;
+    if(posix_memalign(&blk, UNI10_ALIGNMENT, bytes) != 0)
+        return NULL;
+    if(bytes >= UNI10_NUMA_LARGE && NUMA_POLICY.load(std::memory_order_relaxed) == NUMA_INTERLEAVE)
+        interleave(blk, bytes);
+    return blk;
+}
+
+// The shared lists are never destroyed, since thread caches flush into them at thread exit.
+struct Central {
+    Central(): enabled(envEnabled()), limit(DEFAULT_LIMIT), allocs(0), hits(0), cached(0), peak(0) {}
+    std::mutex lock;
+    std::vector<void*> lists[CLASS_NUM];
+    std::atomic<bool> enabled;
+    std::atomic<size_t> limit;
+    std::atomic<size_t> allocs;
+    std::atomic<size_t> hits;
+    std::atomic<size_t> cached;
+    std::atomic<size_t> peak;
+    void grow(size_t bytes) {
+        size_t now = (cached += bytes);
+        size_t old = peak.load();
+        while(now > old && !peak.compare_exchange_weak(old, now));
+    }
+    // Keeps a block unless the pool is off or would pass its limit.
+    bool keep(void* blk, size_t cls) {
+        size_t bytes = classBytes(cls);
+        if(!enabled.load() || cached.load() + bytes > limit.load())
+            return false;
+        std::lock_guard<std::mutex> lk(lock);
+        lists[cls].push_back(blk);
+        grow(bytes);
+        return true;
+    }
+    void* take(size_t cls) {
+        std::lock_guard<std::mutex> lk(lock);
+        if(lists[cls].empty())
+            return NULL;
+        void* blk = lists[cls].back();
+        lists[cls].pop_back();
+        cached -= classBytes(cls);
+        return blk;
+    }
+    void release(memTag tag) {
+        std::lock_guard<std::mutex> lk(lock);
+        for(size_t c = 0; c < CLASS_NUM; c++)
+            cached -= drop(lists[c], tag) * classBytes(c);
+    }
+    // Frees the blocks of a list requested for tag, and returns how many.
+    static size_t drop(std::vector<void*>& list, memTag tag) {
+        size_t kept = 0;
+        for(size_t i = 0; i < list.size(); i++) {
+            if(requestedFor(list[i], tag))
+                free(list[i]);
+            else
+                list[kept++] = list[i];
+        }
+        size_t num = list.size() - kept;
+        list.resize(kept);
+        return num;
+    }
+};
+
+Central& central() {
+    static Central* pool = new Central;
+    return *pool;
+}
+
+thread_local bool CACHE_DEAD = false;
+
+// releasePool() cannot reach into the caches of other threads. It counts the requests per tag instead, and
+// each thread cache drops the blocks asked for on its next use.
+std::atomic<size_t> DRAINS(0);
+std::atomic<size_t> DRAIN_GEN[MEM_TAG_NUM + 1];
+
+struct ThreadCache {
+    ThreadCache(): bytes(0), drains(DRAINS.load()) {
+        for(int t = 0; t <= MEM_TAG_NUM; t++)
+            seen[t] = DRAIN_GEN[t].load();
+    }
+    ~ThreadCache() {
+        if(drains != DRAINS.load())
+            catchUp();
+        flush();
+        CACHE_DEAD = true;
+    }
+    std::vector<void*> lists[CLASS_NUM];
+    size_t bytes;
+    size_t drains;
+    size_t seen[MEM_TAG_NUM + 1];
+    void drop(memTag tag) {
+        Central& pool = central();
+        for(size_t c = 0; c < CLASS_NUM; c++) {
+            size_t freed = Central::drop(lists[c], tag) * classBytes(c);
+            bytes -= freed;
+            pool.cached -= freed;
+        }
+    }
+    void catchUp() {
+        drains = DRAINS.load();
+        for(int t = 0; t <= MEM_TAG_NUM; t++) {
+            size_t gen = DRAIN_GEN[t].load();
+            if(seen[t] != gen) {
+                seen[t] = gen;
+                drop((memTag)t);
+            }
+        }
+    }
+    void flush() {
+        Central& pool = central();
+        for(size_t c = 0; c < CLASS_NUM; c++) {
+            for(size_t i = 0; i < lists[c].size(); i++) {
+                pool.cached -= classBytes(c);
+                if(!pool.keep(lists[c][i], c))
+                    free(lists[c][i]);
+            }
+            lists[c].clear();
+        }
+        bytes = 0;
+    }
+};
+
+ThreadCache* threadCache() {
+    thread_local ThreadCache cache;
+    if(CACHE_DEAD)
+        return NULL;
+    if(cache.drains != DRAINS.load(std::memory_order_relaxed))
+        cache.catchUp();
+    return &cache;
+}
+
+}  // namespace
+
+void* poolAlloc(size_t memsize, memTag tag) {
+    memTag request = tag;
+    size_t traceId = memAcquire(memsize, tag);
+    Central& pool = central();
+    ThreadCache* cache = threadCache();
+    size_t cls = UNPOOLED;
+    void* blk = NULL;
+    if(pool.enabled.load(std::memory_order_relaxed)) {
+        cls = classOf(memsize + HEADER);
+        pool.allocs++;
+    }
+    if(cls != UNPOOLED) {
+        size_t bytes = classBytes(cls);
+        if(bytes > LARGE)
+            cache = NULL;
+        if(cache != NULL && cache->lists[cls].size()) {
+            blk = cache->lists[cls].back();
+            cache->lists[cls].pop_back();
+            cache->bytes -= bytes;
+            pool.cached -= bytes;
+        }
+        // A large request may also reuse a block one class up, since sweeps rarely repeat sizes exactly.
+        if(blk == NULL)
+            blk = pool.take(cls);
+        if(blk == NULL && bytes > LARGE && cls + 1 < CLASS_NUM && (blk = pool.take(cls + 1)) != NULL)
+            cls++;
+        if(blk != NULL)
+            pool.hits++;
+        else
+            blk = sysAlloc(bytes);
+    }
+    else
+        blk = sysAlloc(memsize + HEADER);
+    if(blk == NULL) {
+        memRelease(memsize, tag, traceId);
+        std::ostringstream err;
+        err<<"Fails in allocating memory.";
+        throw std::runtime_error(exception_msg(err.str()));
+    }
+    Header* head = (Header*)blk;
+    head->cls = cls;
+    head->memsize = memsize;
+    head->traceId = traceId;
+    head->tag = tag;
+    head->request = request;
+    return (char*)blk + HEADER;
+}
+
+void poolFree(void* ptr) {
+    if(ptr == NULL)
+        return;
+    void* blk = (char*)ptr - HEADER;
+    Header* head = (Header*)blk;
+    memRelease(head->memsize, head->tag, head->traceId);
+    size_t cls = head->cls;
+    Central& pool = central();
+    ThreadCache* cache = threadCache();
+    if(cls == UNPOOLED || !pool.enabled.load(std::memory_order_relaxed)) {
+        free(blk);
+        return;
+    }
+    size_t bytes = classBytes(cls);
+    if(bytes > LARGE)
+        cache = NULL;
+    if(cache != NULL && cache->bytes + bytes <= THREAD_CAP) {
+        cache->lists[cls].push_back(blk);
+        cache->bytes += bytes;
+        pool.grow(bytes);
+    }
+    else if(!pool.keep(blk, cls))
+        free(blk);
+}
+
+void setPoolEnabled(bool enabled) {
+    central().enabled = enabled;
+    if(!enabled)
+        releasePool();
+}
+
+void setPoolLimit(size_t bytes) {
+    central().limit = bytes;
+}
+
+void releasePool(memTag tag) {
+    DRAIN_GEN[tag]++;
+    DRAINS++;
+    // Catches up the cache of the calling thread.
+    threadCache();
+    central().release(tag);
+}
+
+void setNumaPolicy(numaPolicy policy) {
+    NUMA_POLICY = policy;
+    // Cached blocks were placed by the old policy.
+    releasePool();
+}
+
+numaPolicy getNumaPolicy() {
+    return (numaPolicy)NUMA_POLICY.load();
+}
+
+PoolStats getPoolStats() {
+    Central& pool = central();
+    PoolStats stats;
+    stats.enabled = pool.enabled;
+    stats.allocs = pool.allocs;
+    stats.hits = pool.hits;
+    stats.cachedBytes = pool.cached;
+    stats.peakCachedBytes = pool.peak;
+    stats.limit = pool.limit;
+    return stats;
+}
+
+};  /* namespace uni10 */
@@ -0,0 +1,209 @@
+/****************************************************************************
+*  @file uni10_threads.cpp
+*  @license
+*    Universal Tensor Network Library
+*    Copyright (c) 2013-2016
+*    National Taiwan University
+*    National Tsing-Hua University
+
+*
+*    This file is part of Uni10, the Universal Tensor Network Library.
+*
+*    Uni10 is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU Lesser General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    Uni10 is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public License
+*    along with Uni10.  If not, see <http://www.gnu.org/licenses/>.
+*  @endlicense
+*  @brief Thread pool for the multithreaded host kernels
+*  @author Ying-Jer Kao
+*  @date 2016-06-06
+*  @since 1.0.0
+*
+*****************************************************************************/
+#include <uni10/tools/uni10_tools.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace uni10 {
+
+namespace {
+
+thread_local bool IN_POOL = false;
+
+int defaultThreadNum() {
+    const char* env = getenv("UNI10_NUM_THREADS");
+    if(env != NULL && atoi(env) > 0)
+        return atoi(env);
+    int num = std::thread::hardware_concurrency();
+    return num > 0 ? num : 1;
+}
+
+class ThreadPool {
+public:
+    ThreadPool(): count(1), stop(false), generation(0), pending(0), job(NULL) {
+        resize(defaultThreadNum());
+    }
+    ~ThreadPool() {
+        resize(1);
+    }
+    int size() {
+        return count;
+    }
+    void resize(int num) {
+        std::lock_guard<std::mutex> guard(runLock);
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            stop = true;
+        }
+        wake.notify_all();
+        for(size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+        workers.clear();
+        stop = false;
+        for(int i = 1; i < num; i++)
+            workers.push_back(std::thread(&ThreadPool::loop, this, generation));
+        count = num;
+    }
+    void run(size_t n, const std::function<void(size_t)>& task) {
+        if(IN_POOL || n < 2 || !runLock.try_lock()) {
+            for(size_t i = 0; i < n; i++)
+                task(i);
+            return;
+        }
+        if(workers.empty()) {
+            runLock.unlock();
+            for(size_t i = 0; i < n; i++)
+                task(i);
+            return;
+        }
+        Job j(n, task);
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            job = &j;
+            pending = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        IN_POOL = true;
+        work(j);
+        IN_POOL = false;
+        {
+            std::unique_lock<std::mutex> lk(lock);
+            while(pending)
+                done.wait(lk);
+            job = NULL;
+        }
+        runLock.unlock();
+        if(j.error)
+            std::rethrow_exception(j.error);
+    }
+private:
+    struct Job {
+        Job(size_t _n, const std::function<void(size_t)>& _task): n(_n), task(_task), next(0) {}
+        size_t n;
+        const std::function<void(size_t)>& task;
+        std::atomic<size_t> next;
+        std::mutex errLock;
+        std::exception_ptr error;
+    };
+    void work(Job& j) {
+        size_t i;
+        while((i = j.next.fetch_add(1)) < j.n) {
+            try {
+                j.task(i);
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> guard(j.errLock);
+                if(!j.error)
+                    j.error = std::current_exception();
+                j.next = j.n;
+            }
+        }
+    }
+    void loop(unsigned long seen) {
+        IN_POOL = true;
+        while(true) {
+            Job* j;
+            {
+                std::unique_lock<std::mutex> lk(lock);
+                while(!stop && generation == seen)
+                    wake.wait(lk);
+                if(stop)
+                    return;
+                seen = generation;
+                j = job;
+            }
+            work(*j);
+            std::lock_guard<std::mutex> lk(lock);
+            if(--pending == 0)
+                done.notify_all();
+        }
+    }
+    std::vector<std::thread> workers;
+    std::atomic<int> count;
+    std::mutex runLock;     // one job at a time
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stop;
+    unsigned long generation;
+    size_t pending;
+    Job* job;
+};
+
+ThreadPool& threadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+};  /* namespace */
+
+void setThreadNum(int num) {
+    if(num < 1) {
+        std::ostringstream err;
+        err<<"The number of threads must be positive, got "<<num<<".";
+        throw std::runtime_error(exception_msg(err.str()));
+    }
+    // A task holds the pool for its job, resizing would wait for itself.
+    if(IN_POOL) {
+        std::ostringstream err;
+        err<<"Cannot set the number of threads from a task of parallelFor().";
+        throw std::runtime_error(exception_msg(err.str()));
+    }
+    threadPool().resize(num);
+}
+
+int getThreadNum() {
+    return threadPool().size();
+}
+
+bool inParallelFor() {
+    return IN_POOL;
+}
+
+void parallelFor(size_t n, const std::function<void(size_t)>& task) {
+    const MemoryScope* scope = MemoryScope::current();
+    if(scope == NULL) {
+        threadPool().run(n, task);
+        return;
+    }
+    // The workers charge their allocations to the scope of the caller.
+    threadPool().run(n, [&](size_t i) {
+        MemoryScope adopted(scope);
+        task(i);
+    });
+}
+
+};  /* namespace uni10 */
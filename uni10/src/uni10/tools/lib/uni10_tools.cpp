@@ -32,8 +32,127 @@
 #include <string.h>
 namespace uni10 {
 
-size_t MEM_USAGE = 0;
-size_t GPU_MEM_USAGE = 0;
+namespace {
+
+struct _PermAxis {
+    size_t dim;
+    size_t srcAcc;
+    size_t desAcc;
+};
+
+bool _srcSlower(const _PermAxis& a, const _PermAxis& b) {
+    return a.srcAcc > b.srcAcc;
+}
+
+/* Edge length of a transpose tile, chosen so that a pair of tiles stays well inside L1. */
+template<typename T>
+size_t _permTile() {
+    return sizeof(T) > 8 ? 16 : 32;
+}
+
+template<typename T>
+void _permuteElem(const T* src, T* des, const std::vector<size_t>& dims, const std::vector<size_t>& srcAcc, const std::vector<size_t>& desAcc, T scale) {
+    std::vector<_PermAxis> axes;
+    for(size_t i = 0; i < dims.size(); i++) {
+        if(dims[i] == 0)
+            return;
+        if(dims[i] > 1) {
+            _PermAxis ax = {dims[i], srcAcc[i], desAcc[i]};
+            axes.push_back(ax);
+        }
+    }
+    bool unit = (scale == T(1));
+    if(axes.empty()) {
+        des[0] = unit ? src[0] : scale * src[0];
+        return;
+    }
+    // Order the axes from slow to fast in the source and fuse neighbours which are contiguous on both sides.
+    std::stable_sort(axes.begin(), axes.end(), _srcSlower);
+    std::vector<_PermAxis> fused(1, axes[0]);
+    for(size_t i = 1; i < axes.size(); i++) {
+        _PermAxis& last = fused.back();
+        if(last.srcAcc == axes[i].srcAcc * axes[i].dim && last.desAcc == axes[i].desAcc * axes[i].dim) {
+            last.dim *= axes[i].dim;
+            last.srcAcc = axes[i].srcAcc;
+            last.desAcc = axes[i].desAcc;
+        }
+        else
+            fused.push_back(axes[i]);
+    }
+    int n = fused.size();
+    int a = n - 1;  // fastest axis of the source
+    int c = a;      // fastest axis of the destination
+    for(int i = 0; i < n; i++)
+        if(fused[i].desAcc < fused[c].desAcc)
+            c = i;
+    std::vector<int> outer;
+    for(int i = 0; i < n; i++)
+        if(i != a && i != c)
+            outer.push_back(i);
+    std::vector<size_t> idxs(outer.size(), 0);
+    const _PermAxis& A = fused[a];
+    const _PermAxis& C = fused[c];
+    const size_t tile = _permTile<T>();
+    size_t sOff = 0, dOff = 0;
+    while(true) {
+        const T* s = src + sOff;
+        T* d = des + dOff;
+        if(a == c) {
+            if(A.srcAcc == 1 && A.desAcc == 1 && unit)
+                memcpy(d, s, A.dim * sizeof(T));
+            else
+                for(size_t i = 0; i < A.dim; i++)
+                    d[i * A.desAcc] = scale * s[i * A.srcAcc];
+        }
+        else {
+            for(size_t c0 = 0; c0 < C.dim; c0 += tile) {
+                size_t c1 = std::min(c0 + tile, C.dim);
+                for(size_t a0 = 0; a0 < A.dim; a0 += tile) {
+                    size_t a1 = std::min(a0 + tile, A.dim);
+                    for(size_t ic = c0; ic < c1; ic++) {
+                        const T* sr = s + ic * C.srcAcc;
+                        T* dr = d + ic * C.desAcc;
+                        if(unit)
+                            for(size_t ia = a0; ia < a1; ia++)
+                                dr[ia * A.desAcc] = sr[ia * A.srcAcc];
+                        else
+                            for(size_t ia = a0; ia < a1; ia++)
+                                dr[ia * A.desAcc] = scale * sr[ia * A.srcAcc];
+                    }
+                }
+            }
+        }
+        int k = (int)outer.size() - 1;
+        for(; k >= 0; k--) {
+            const _PermAxis& O = fused[outer[k]];
+            idxs[k]++;
+            if(idxs[k] < O.dim) {
+                sOff += O.srcAcc;
+                dOff += O.desAcc;
+                break;
+            }
+            sOff -= O.srcAcc * (O.dim - 1);
+            dOff -= O.desAcc * (O.dim - 1);
+            idxs[k] = 0;
+        }
+        if(k < 0)
+            break;
+    }
+}
+
+};  /* namespace */
+
+void permuteElem(const double* src, double* des, const std::vector<size_t>& dims, const std::vector<size_t>& srcAcc, const std::vector<size_t>& desAcc, double scale) {
+    _permuteElem(src, des, dims, srcAcc, desAcc, scale);
+}
+
+void permuteElem(const std::complex<double>* src, std::complex<double>* des, const std::vector<size_t>& dims, const std::vector<size_t>& srcAcc, const std::vector<size_t>& desAcc, std::complex<double> scale) {
+    _permuteElem(src, des, dims, srcAcc, desAcc, scale);
+}
+
+std::atomic<size_t> MEM_USAGE(0);
+std::atomic<size_t> GPU_MEM_USAGE(0);
+std::atomic<size_t> ELEM_ALLOC_COUNT(0);
 
 std::vector<_Swap> recSwap(std::vector<int>& _ord) { //Given the reshape order out to in.
     //int ordF[n];
@@ -66,6 +185,10 @@ void propogate_exception(const std::exception& e, const std::string& msg) {
     std::string except_str("\n");
     except_str.append(msg);
     except_str.append(e.what());
+    // Keep the type of a budget overrun, which callers may recover from.
+    const MemoryBudgetError* budget = dynamic_cast<const MemoryBudgetError*>(&e);
+    if(budget != NULL)
+        throw MemoryBudgetError(except_str, budget->requested(), budget->usage(), budget->budget());
     throw std::logic_error(except_str);
 }
 
@@ -1,30 +1,54 @@
 #include <uni10/tools/uni10_tools.h>
 #include <string.h>
+#include <random>
+#include <mutex>
 
 namespace uni10{
 
-  void* elemAlloc(size_t memsize, bool& ongpu){
-    void* ptr = NULL;
-    ptr = malloc(memsize);
-    if(ptr == NULL){
-      std::ostringstream err;
-      err<<"Fails in allocating memory.";
-      throw std::runtime_error(exception_msg(err.str()));
+namespace{
+
+  std::mutex RAND_LOCK;
+  unsigned RAND_SEED = 0;
+  unsigned RAND_STREAMS = 0;
+  std::atomic<unsigned> RAND_GENERATION(0);
+
+  // One engine per thread, so that concurrent randomize() calls neither race nor serialize on a lock. A thread
+  // seeds its engine on its first draw and again after setRandomSeed(), with its own stream in the order of
+  // first use. Seeding is the only step under RAND_LOCK. Until setRandomSeed() is called, the seed is drawn
+  // from rand() once per thread, so that srand() still varies the numbers between runs.
+  std::mt19937_64& randEngine(){
+    thread_local std::mt19937_64 engine;
+    thread_local unsigned generation = ~0u;
+    if(generation != RAND_GENERATION.load()){
+      std::lock_guard<std::mutex> lock(RAND_LOCK);
+      generation = RAND_GENERATION.load();
+      std::seed_seq seq{generation == 0 ? (unsigned)rand() : RAND_SEED, RAND_STREAMS++};
+      engine.seed(seq);
     }
+    return engine;
+  }
+
+}
+
+  void setRandomSeed(unsigned seed){
+    std::lock_guard<std::mutex> lock(RAND_LOCK);
+    RAND_SEED = seed;
+    RAND_STREAMS = 0;
+    RAND_GENERATION++;
+  }
+
+  void* elemAlloc(size_t memsize, bool& ongpu, memTag tag){
+    void* ptr = poolAlloc(memsize, tag);
     MEM_USAGE += memsize;
+    ELEM_ALLOC_COUNT++;
     ongpu = false;
     return ptr;
   }
 
-  void* elemAllocForce(size_t memsize, bool ongpu){
-    void* ptr = NULL;
-    ptr = malloc(memsize);
-    if(ptr == NULL){
-      std::ostringstream err;
-      err<<"Fails in allocating memory.";
-      throw std::runtime_error(exception_msg(err.str()));
-    }
+  void* elemAllocForce(size_t memsize, bool, memTag tag){
+    void* ptr = poolAlloc(memsize, tag);
     MEM_USAGE += memsize;
+    ELEM_ALLOC_COUNT++;
     return ptr;
   }
 
@@ -33,18 +57,31 @@ namespace uni10{
   }
 
   void elemFree(void* ptr, size_t memsize, bool ongpu){
-    free(ptr);
+    poolFree(ptr);
     MEM_USAGE -= memsize;
     ptr = NULL;
   }
 
   void elemBzero(void* ptr, size_t memsize, bool ongpu){
-    memset(ptr, 0, memsize);
+    size_t num = getThreadNum();
+    if(memsize < UNI10_NUMA_LARGE || num < 2 || getNumaPolicy() != NUMA_FIRST_TOUCH){
+      memset(ptr, 0, memsize);
+      return;
+    }
+    // One contiguous chunk of whole pages per worker, the way parallel kernels split the buffer later.
+    size_t chunk = (memsize / num + 4095) / 4096 * 4096;
+    parallelFor(num, [&](size_t i){
+      size_t lo = std::min(i * chunk, memsize);
+      size_t hi = std::min(lo + chunk, memsize);
+      memset((char*)ptr + lo, 0, hi - lo);
+    });
   }
 
   void elemRand(double* elem, size_t N, bool ongpu){
+    std::mt19937_64& engine = randEngine();
+    std::uniform_real_distribution<double> uni01(0, 1);
     for(size_t i = 0; i < N; i++)
-      elem[i] = ((double)rand()) / RAND_MAX; //lapack_uni01_sampler();
+      elem[i] = uni01(engine);
   }
 
 void setDiag(double* elem, double* diag_elem, size_t m, size_t n, size_t diag_n, bool ongpu, bool diag_ongpu){
@@ -139,8 +176,12 @@ void setElemAt(size_t idx, std::complex<double> val, std::complex<double> *elem,
 }
 
 void elemRand(std::complex<double>* elem, size_t N, bool ongpu){
-	for(size_t i = 0; i < N; i++)
-		elem[i] = std::complex<double>(((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX); //lapack_uni01_sampler();
+	std::mt19937_64& engine = randEngine();
+	std::uniform_real_distribution<double> uni01(0, 1);
+	for(size_t i = 0; i < N; i++){
+		double re = uni01(engine);
+		elem[i] = std::complex<double>(re, uni01(engine));
+	}
 }
 
 void elemCast(std::complex<double>* des, double* src, size_t N, bool des_ongpu, bool src_ongpu){
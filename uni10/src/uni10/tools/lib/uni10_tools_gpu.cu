@@ -5,7 +5,7 @@ namespace uni10{
   
 const size_t GPU_MEM_MAX = UNI10_GPU_GLOBAL_MEM * 2 / 3;
 
-void* elemAlloc(size_t memsize, bool& ongpu){
+void* elemAlloc(size_t memsize, bool& ongpu, memTag tag){
   void* ptr = NULL;
   if(GPU_MEM_USAGE + memsize <= GPU_MEM_MAX){
     cudaError_t cuflag = cudaMalloc(&ptr, memsize);
@@ -19,10 +19,11 @@ void* elemAlloc(size_t memsize, bool& ongpu){
     ongpu = false;
   }
   //printf("ongpu = %d, GPU_MEM_USAGE = %u, allocate %u\n", ongpu, GPU_MEM_USAGE, memsize);
+  ELEM_ALLOC_COUNT++;
   return ptr;
 }
 
-void* elemAllocForce(size_t memsize, bool ongpu){
+void* elemAllocForce(size_t memsize, bool ongpu, memTag tag){
   void* ptr = NULL;
   if(ongpu){
     cudaError_t cuflag = cudaMalloc(&ptr, memsize);
@@ -34,6 +35,7 @@ void* elemAllocForce(size_t memsize, bool ongpu){
     assert(ptr != NULL);
     MEM_USAGE += memsize;
   }
+  ELEM_ALLOC_COUNT++;
   return ptr;
 }
 
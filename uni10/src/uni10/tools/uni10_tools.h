@@ -30,6 +30,8 @@
 #ifndef UNI10_TOOLS_H
 #define UNI10_TOOLS_H
 #include <cstdint>
+#include <atomic>
+#include <stdexcept>
 #include <string>
 #include <assert.h>
 #include <vector>
@@ -42,18 +44,185 @@
 #include <uni10/data-structure/uni10_struct.h>
 namespace uni10{
 
-extern size_t MEM_USAGE;
-extern size_t GPU_MEM_USAGE;
+extern std::atomic<size_t> MEM_USAGE;
+extern std::atomic<size_t> GPU_MEM_USAGE;
+extern std::atomic<size_t> ELEM_ALLOC_COUNT; // Number of calls to elemAlloc and elemAllocForce
 
 const size_t UNI10_GPU_GLOBAL_MEM = ((size_t)5) * 1<<30;
 const int UNI10_THREADMAX = 1024;
 const int UNI10_BLOCKMAX = 65535;
-void* elemAlloc(size_t memsize, bool& ongpu);
-void* elemAllocForce(size_t memsize, bool ongpu);
+/// Alignment in bytes of the host buffers from poolAlloc() and elemAlloc(), one cache line and one AVX-512 vector
+const size_t UNI10_ALIGNMENT = 64;
+/// Host buffers from this size on are placed by the NUMA policy
+const size_t UNI10_NUMA_LARGE = ((size_t)1) << 21;
+/// @brief Placement of large host buffers on NUMA nodes
+enum numaPolicy{
+  NUMA_DEFAULT,     ///< Pages land on the node of the thread which touches them first
+  NUMA_INTERLEAVE,  ///< Pages of fresh buffers are spread round-robin over all nodes
+  NUMA_FIRST_TOUCH  ///< elemBzero() clears buffers on the thread pool, so that each worker places the pages it clears
+};
+/// @brief Subsystems owning host memory, see getMemoryUsage()
+enum memTag{
+  MEM_TENSOR,   ///< Elements of UniTensor
+  MEM_MATRIX,   ///< Elements of Matrix, including the temporaries of the matrix algebra
+  MEM_LAPACK,   ///< Workspaces of the lapack wrappers
+  MEM_NETWORK,  ///< Tensors allocated by Network, the intermediates as well as the results
+  MEM_CONTRACT, ///< Operands packed by contract()
+  MEM_TAG_NUM
+};
+/// @brief Host memory in use and its peaks, in bytes
+struct MemoryUsage{
+  size_t current[MEM_TAG_NUM];  ///< Bytes in use by each subsystem
+  size_t peak[MEM_TAG_NUM];     ///< Peak of each subsystem
+  size_t total;                 ///< Bytes in use by all subsystems
+  size_t peakTotal;             ///< Peak of \c total
+  std::string peakSite;         ///< MemoryScope which was active when \c peakTotal was reached
+  size_t budget;                ///< Budget set by setMemoryBudget(), \c 0 for none
+};
+/// @brief Thrown when an allocation would exceed the budget of setMemoryBudget()
+///
+/// Kept by the exception propagation of Uni10, so that callers can catch it by type and free memory or shrink
+/// the problem before retrying.
+class MemoryBudgetError: public std::runtime_error{
+  public:
+    MemoryBudgetError(const std::string& msg, size_t requested, size_t usage, size_t budget);
+    /// @brief Bytes of the failed allocation
+    size_t requested()const{return m_requested;}
+    /// @brief Bytes in use at the failed allocation
+    size_t usage()const{return m_usage;}
+    /// @brief The budget in bytes
+    size_t budget()const{return m_budget;}
+  private:
+    size_t m_requested;
+    size_t m_usage;
+    size_t m_budget;
+};
+/// @brief Attributes the host allocations of a block to a call site
+///
+/// Scopes nest into a site path, e.g. \c "sweep 3/site 12", which is recorded for the peak and in the
+/// allocation trace. A scope with a subsystem also charges the allocations to it, as Network::launch() does
+/// with \c MEM_NETWORK. Scopes are per thread, and parallelFor() carries them over to the pool threads.
+/// @code
+/// for(int step = 0; step < steps; step++){
+///   uni10::MemoryScope scope("step " + std::to_string(step));
+///   ...
+/// }
+/// std::cout << uni10::getMemoryUsage().peakSite;
+/// @endcode
+class MemoryScope{
+  public:
+    /// @brief Enter the scope @p site, charging to @p tag if given
+    explicit MemoryScope(const std::string& site, memTag tag = MEM_TAG_NUM);
+    /// @brief Continue the scope @p adopt, taken by current() on another thread, on this thread
+    explicit MemoryScope(const MemoryScope* adopt);
+    ~MemoryScope();
+    /// @brief Innermost scope of the calling thread, \c NULL outside of any scope
+    static const MemoryScope* current();
+  private:
+    const MemoryScope* prev;
+    std::string site;
+    memTag tag;
+    friend size_t memAcquire(size_t memsize, memTag& tag);
+    MemoryScope(const MemoryScope&);
+    MemoryScope& operator=(const MemoryScope&);
+};
+/// @brief Host memory in use and its peaks per subsystem
+MemoryUsage getMemoryUsage();
+/// @brief Restart the peaks of getMemoryUsage() from the current usage
+void resetMemoryPeaks();
+/// @brief Bound the host memory in use, \c 0 for no bound
+///
+/// An allocation which would pass the budget throws MemoryBudgetError before any memory is requested from the
+/// system. Buffers cached by the memory pool are not counted.
+void setMemoryBudget(size_t bytes);
+/// @brief Start or stop recording every host allocation with its size, subsystem, site and lifetime
+///
+/// Starting clears the previous trace. Recording takes a lock per allocation, so keep it for diagnosis.
+void setMemoryTrace(bool on);
+/// @brief Write the usage and the recorded allocations as JSON to the file @p fname
+///
+/// Times are seconds since the trace started, \c null for buffers still alive.
+void dumpMemoryTrace(const std::string& fname);
+/// @brief Account an allocation of @p memsize bytes, called by poolAlloc()
+///
+/// Replaces @p tag by the subsystem of the active MemoryScope, if any, and throws MemoryBudgetError beyond the
+/// budget. Returns the trace id to hand to memRelease().
+size_t memAcquire(size_t memsize, memTag& tag);
+/// @brief Account the release of an allocation, called by poolFree()
+void memRelease(size_t memsize, memTag tag, size_t traceId);
+/// @brief Statistics of the host memory pool
+struct PoolStats{
+  bool enabled;           ///< Whether freed buffers are kept for reuse
+  size_t allocs;          ///< Number of requests served while the pool was enabled
+  size_t hits;            ///< Number of requests served from a cached buffer
+  size_t cachedBytes;     ///< Bytes currently held by the pool
+  size_t peakCachedBytes; ///< Largest value of \c cachedBytes so far
+  size_t limit;           ///< Bound on \c cachedBytes
+};
+/// @brief Buffer of at least @p memsize bytes from the host memory pool
+///
+/// Buffers are aligned to ::UNI10_ALIGNMENT bytes. Requests are rounded up to size classes a quarter of a power of two apart. Freed buffers up to 256 KiB are
+/// kept in a cache of the freeing thread, larger ones in lists shared by all threads, where a request may also
+/// take a buffer one class up. The pool backs elemAlloc() on host as well as the lapack and Matrix workspaces.
+/// The buffer is charged to @p tag, see getMemoryUsage(). Release with poolFree(), never with \c free().
+void* poolAlloc(size_t memsize, memTag tag);
+/// @brief Return a buffer from poolAlloc() to the pool
+void poolFree(void* ptr);
+/// @brief Switch the reuse of freed buffers on or off
+///
+/// Defaults to the environment variable \c UNI10_POOL, where \c 0 turns the pool off. When off, poolAlloc()
+/// and poolFree() go straight to \c malloc and \c free, and switching off releases the cached buffers as
+/// releasePool() does.
+void setPoolEnabled(bool enabled);
+/// @brief Bound the bytes kept by the pool, 256 MiB by default
+void setPoolLimit(size_t bytes);
+/// @brief Give the buffers cached by the pool back to the system
+///
+/// With @p tag, only the buffers last requested from poolAlloc() for @p tag are released. The shared lists and
+/// the cache of the calling thread are released at once, the caches of other threads at their next poolAlloc()
+/// or poolFree(), or when they exit.
+void releasePool(memTag tag = MEM_TAG_NUM);
+/// @brief Statistics of the host memory pool
+PoolStats getPoolStats();
+/// @brief Set the placement of host buffers of at least ::UNI10_NUMA_LARGE bytes
+///
+/// Defaults to the environment variable \c UNI10_NUMA, either \c interleave or \c firsttouch. Interleaving
+/// suits buffers read by all threads, like the operands of a parallel GEMM. First touch by the workers suits
+/// buffers split among the pool threads, like the blocks of a permutation. The pool is released, so that
+/// cached buffers placed by the old policy are not reused. Has no effect on machines with a single node.
+void setNumaPolicy(numaPolicy policy);
+/// @brief Placement of large host buffers on NUMA nodes
+numaPolicy getNumaPolicy();
+void* elemAlloc(size_t memsize, bool& ongpu, memTag tag = MEM_TENSOR);
+void* elemAllocForce(size_t memsize, bool ongpu, memTag tag = MEM_TENSOR);
 void* elemCopy(void* des, const void* src, size_t memsize, bool des_ongpu, bool src_ongpu);
 void elemFree(void* ptr, size_t memsize, bool ongpu);
 void elemBzero(void* ptr, size_t memsize, bool ongpu);
+/// @brief Owner of one buffer from elemAlloc
+///
+/// UniTensor and Matrix hold the buffer of their elements through a shared pointer to a store, so that copies
+/// alias the same elements until one of them writes. The buffer is released by elemFree with the store.
+struct _ElemStore{
+  _ElemStore(void* _elem, size_t _memsize, bool _ongpu): elem(_elem), memsize(_memsize), ongpu(_ongpu){}
+  ~_ElemStore(){
+    if(elem != NULL)
+      elemFree(elem, memsize, ongpu);
+  }
+  void* elem;
+  size_t memsize;
+  bool ongpu;
+private:
+  _ElemStore(const _ElemStore&);
+  _ElemStore& operator=(const _ElemStore&);
+};
 void elemRand(double* elem, size_t N, bool ongpu);
+/// @brief Seed the random numbers of elemRand(), e.g. of UniTensor::randomize() and Matrix::randomize()
+///
+/// Each thread draws from its own engine, so randomizing from several threads is safe. After seeding, the
+/// engines are reseeded in the order in which threads next draw, which makes a single-threaded run repeatable.
+/// Until the first call, each thread seeds its engine once, on its first draw, from \c rand(). A \c srand() before
+/// the first draw therefore still picks the random numbers.
+void setRandomSeed(unsigned seed);
 std::vector<_Swap> recSwap(std::vector<int>& ord, std::vector<int>& ordF);
 std::vector<_Swap> recSwap(std::vector<int>& ord);	//Given the reshape order out to in.
 void setDiag(double* elem, double* diag_elem, size_t M, size_t N, size_t diag_N, bool ongpu, bool diag_ongpu);
@@ -65,10 +234,34 @@ void shrinkWithoutFree(size_t memsize, bool ongpu);
 void reshapeElem(double* oldElem, int bondNum, size_t elemNum, size_t* offset, double* newElem);
 double getElemAt(size_t idx, double* elem, bool ongpu);
 void setElemAt(size_t idx, double val, double* elem, bool ongpu);
+/// @brief Set the number of threads of the Uni10 thread pool
+///
+/// The pool runs the multithreaded host kernels, e.g. the sub-block copies of UniTensor::permute().
+/// Defaults to the environment variable \c UNI10_NUM_THREADS, or to the number of hardware threads.
+/// @param num Number of threads, \c 1 runs every kernel serially
+/// @throw std::runtime_error when called from a task of parallelFor()
+void setThreadNum(int num);
+/// @brief Number of threads of the Uni10 thread pool
+int getThreadNum();
+/// @brief Run <tt> task(i) </tt> for every \c i in [0, \c n) on the Uni10 thread pool
+///
+/// Indices are handed out in increasing order, so callers get a largest-first schedule by sorting the
+/// work before. Falls back to a serial loop when called from a pool thread or while the pool is busy.
+/// The first exception thrown by a task is rethrown to the caller.
+void parallelFor(size_t n, const std::function<void(size_t)>& task);
+/// @brief Whether the calling thread runs a task of parallelFor() on the Uni10 thread pool
+bool inParallelFor();
 void propogate_exception(const std::exception& e, const std::string& func_msg);
 std::string exception_msg(const std::string& msg);
 double elemMax(double *elem, size_t ElemNum, bool ongpu);
 double elemAbsMax(double *elem, size_t ElemNum, bool ongpu);
+/// @brief Cache-blocked strided permutation on host memory
+///
+/// Copies the element indexed by @p dims from @p src to @p des, where each axis @c i advances
+/// @p srcAcc[i] elements in @p src and @p desAcc[i] elements in @p des. Elements are scaled by @p scale.
+/// Unit axes are dropped, adjacent axes which remain adjacent are fused and the two fastest-varying
+/// axes of source and destination are transposed in tiles, so that both sides stream through cache.
+void permuteElem(const double* src, double* des, const std::vector<size_t>& dims, const std::vector<size_t>& srcAcc, const std::vector<size_t>& desAcc, double scale = 1.0);
 /***** Complex version *****/
 std::complex<double> getElemAt(size_t idx, std::complex<double>* elem, bool ongpu);
 void setElemAt(size_t idx, std::complex<double> val, std::complex<double>* elem, bool ongpu);
@@ -78,6 +271,7 @@ void elemCast(double *des, std::complex<double> *src, size_t N, bool des_ongpu,
 void setDiag(std::complex<double>* elem, std::complex<double>* diag_elem, size_t M, size_t N, size_t diag_N, bool ongpu, bool diag_ongpu);
 void getDiag(std::complex<double>* elem, std::complex<double>* diag_elem, size_t M, size_t N, size_t diag_N, bool ongpu, bool diag_ongpu);
 void reshapeElem(std::complex<double>* oldElem, int bondNum, size_t elemNum, size_t* offset, std::complex<double>* newElem);
+void permuteElem(const std::complex<double>* src, std::complex<double>* des, const std::vector<size_t>& dims, const std::vector<size_t>& srcAcc, const std::vector<size_t>& desAcc, std::complex<double> scale = 1.0);
 
 // trim from start
 static inline std::string &ltrim(std::string &s) {
@@ -94,6 +288,20 @@ static inline std::string &trim(std::string &s) {
 	return ltrim(rtrim(s));
 }
 
+// every bond carries the single trivial quantum number, so a tensor is one dense block
+static inline bool trivialBonds(const std::vector<Bond>& bonds){
+	for(size_t b = 0; b < bonds.size(); b++)
+		if(!bonds[b].withoutSymmetry())
+			return false;
+	return true;
+}
+// labels of a followed by those of b
+static inline std::vector<int> concat(const std::vector<int>& a, const std::vector<int>& b){
+	std::vector<int> ab(a);
+	ab.insert(ab.end(), b.begin(), b.end());
+	return ab;
+}
+
 static inline void throwTypeError(rflag tp){
 	if(tp == RNULL){
 		std::ostringstream err;
@@ -158,3 +158,29 @@ TEST(Bond, combine){
     EXPECT_EQ(q2,it->first);
     EXPECT_EQ(2,it->second);
 }
+
+TEST(Bond, Move){
+    std::vector<Qnum> qnums(3, Qnum(1));
+    qnums.push_back(Qnum(-1));
+    Bond bd(BD_OUT, qnums);
+    Bond bd2(std::move(bd));
+    EXPECT_EQ(BD_OUT, bd2.type());
+    EXPECT_EQ(4, bd2.dim());
+    EXPECT_EQ(0, bd.dim());
+    EXPECT_TRUE(bd.Qlist().empty());
+
+    bd = std::move(bd2);
+    EXPECT_EQ(4, bd.dim());
+    EXPECT_EQ(qnums, bd.Qlist());
+    EXPECT_EQ(0, bd2.dim());
+}
+
+TEST(Bond, WithoutSymmetry){
+    EXPECT_TRUE(Bond(BD_IN, 100).withoutSymmetry());
+    EXPECT_TRUE(Bond(BD_OUT, std::vector<Qnum>(3, Qnum(0))).withoutSymmetry());
+    EXPECT_FALSE(Bond(BD_IN, std::vector<Qnum>(3, Qnum(1))).withoutSymmetry());
+    EXPECT_FALSE(Bond(BD_IN, std::vector<Qnum>(3, Qnum(0, PRT_ODD))).withoutSymmetry());
+    std::vector<Qnum> qnums(2, Qnum(0));
+    qnums.push_back(Qnum(-1));
+    EXPECT_FALSE(Bond(BD_IN, qnums).withoutSymmetry());
+}
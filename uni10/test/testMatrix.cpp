@@ -10,6 +10,7 @@
 #include <iostream>
 #include <map>
 #include "uni10.hpp"
+#include <uni10/tools/uni10_tools.h>
 #include <time.h>
 #include <vector>
 using namespace uni10;
@@ -134,3 +135,75 @@ TEST(Matrix, maxNorm){
         ASSERT_EQ(flag, true);
     }
 }
+
+TEST(Matrix, CopyOnWrite){
+    Matrix A(3, 8);
+    A.randomize();
+    Real* elem = A.getElem();
+
+    size_t mem = MEM_USAGE;
+    Matrix B = A;
+    Matrix C;
+    C = A;
+    const Matrix& cA = A;
+    const Matrix& cB = B;
+    const Matrix& cC = C;
+    ASSERT_EQ(mem, MEM_USAGE);
+    ASSERT_EQ(elem, cB.getElem());
+    ASSERT_EQ(elem, cC.getElem());
+
+    B *= 2.0;
+    ASSERT_NE(elem, cB.getElem());
+    ASSERT_EQ(elem, cA.getElem());
+    for(size_t i = 0; i < A.elemNum(); i++)
+        ASSERT_EQ(2 * C[i], B[i]);
+
+    C.set_zero();
+    ASSERT_EQ(elem, cA.getElem());
+    ASSERT_TRUE(B == A * 2.0);
+
+    // A Block view is copied
+    Matrix D = Block(A);
+    ASSERT_NE(elem, D.getElem());
+}
+
+TEST(Matrix, WriteThroughGetElem){
+    Matrix A(3, 8);
+    A.randomize();
+    Real a0 = A[0];
+    Matrix B = A;
+    B.getElem()[0] = 42;
+    ASSERT_EQ(a0, A[0]);
+    ASSERT_EQ(42, B[0]);
+
+    Matrix CA(CTYPE, 3, 8);
+    CA.randomize();
+    Complex c0 = CA(0);
+    Matrix CB = CA;
+    CB.getElem(CTYPE)[0] = Complex(42, 1);
+    ASSERT_EQ(c0, CA(0));
+    ASSERT_EQ(Complex(42, 1), CB(0));
+}
+
+TEST(Matrix, Move){
+    Matrix A(3, 8);
+    A.randomize();
+    Matrix ref = A;
+    Real* elem = A.getElem();
+
+    size_t allocs = ELEM_ALLOC_COUNT;
+    Matrix B(std::move(A));
+    ASSERT_EQ(elem, B.getElem());
+    ASSERT_EQ(0, A.elemNum());
+    ASSERT_TRUE(A.getElem() == NULL);
+
+    A = std::move(B);
+    ASSERT_EQ(elem, A.getElem());
+    ASSERT_EQ(0, B.elemNum());
+    ASSERT_TRUE(A == ref);
+    ASSERT_EQ(allocs, ELEM_ALLOC_COUNT);
+
+    // A moved-from Matrix can be assigned again
+    B = A;
+    ASSERT_TRUE(B == ref);
+}
@@ -9,6 +9,8 @@
 #include <iostream>
 #include <map>
 #include "uni10.hpp"
+#include <uni10/tools/uni10_tools.h>
+#include <uni10/numeric/lapack/uni10_lapack.h>
 #include <time.h>
 #include <vector>
 using namespace uni10;
@@ -91,3 +93,639 @@ TEST(Network,SimpleContract){
     ASSERT_EQ(C.typeID(), 2);
 
 }
+
+TEST(Network, OptimizeOrder){
+    // A chain of matrices 2x50, 50x2, 2x50, 50x2 is cheapest when contracted as (A B) (C D).
+    std::vector<Bond> bondsA;
+    bondsA.push_back(Bond(BD_IN, 2));
+    bondsA.push_back(Bond(BD_OUT, 50));
+    std::vector<Bond> bondsB;
+    bondsB.push_back(Bond(BD_IN, 50));
+    bondsB.push_back(Bond(BD_OUT, 2));
+    UniTensor A(bondsA), B(bondsB), C(bondsA), D(bondsB);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+    D.randomize();
+    Matrix ABCD = A.getBlock() * B.getBlock() * C.getBlock() * D.getBlock();
+
+    Network net("./Chain.net");
+    net.putTensor("A", A);
+    net.putTensor("B", B);
+    net.putTensor("C", C);
+    net.putTensor("D", D);
+    // Without ORDER line the order is searched for
+    Matrix M = net.launch().getBlock();
+    for(size_t i = 0; i < ABCD.elemNum(); i++)
+        ASSERT_NEAR(ABCD[i], M[i], 1E-10 * fabs(ABCD[i]));
+
+    ASSERT_EQ("((A B) (C D))", net.optimizeOrder(ORD_DP));
+    ASSERT_EQ("((A B) (C D))", net.optimizeOrder(ORD_BRANCH));
+    ASSERT_EQ("((A B) (C D))", net.optimizeOrder(ORD_GREEDY));
+    M = net.launch().getBlock();
+    for(size_t i = 0; i < ABCD.elemNum(); i++)
+        ASSERT_NEAR(ABCD[i], M[i], 1E-10 * fabs(ABCD[i]));
+
+    Network missing("./Chain.net");
+    missing.putTensor("A", A);
+    ASSERT_ANY_THROW(missing.optimizeOrder());
+}
+
+TEST(Network, AutoOrderDP){
+    // A chain of ten matrices, the cheapest first pair leads to 340 multiply-adds, the best order takes 150.
+    int dims[] = {2, 7, 3, 5, 2, 2, 6, 5, 8, 1, 2};
+    Network net("./Chain10.net");
+    Matrix prod;
+    for(int t = 0; t < 10; t++){
+        std::vector<Bond> bonds;
+        bonds.push_back(Bond(BD_IN, dims[t]));
+        bonds.push_back(Bond(BD_OUT, dims[t + 1]));
+        UniTensor T(bonds);
+        T.randomize();
+        net.putTensor(std::string(1, 'A' + t), T);
+        prod = t ? prod * T.getBlock() : T.getBlock();
+    }
+    // Without ORDER line a network of ten tensors is searched exhaustively.
+    ASSERT_NE(std::string::npos, net.profile(false).find("Multiply-adds: 150 "));
+    Matrix M = net.launch().getBlock();
+    for(size_t i = 0; i < prod.elemNum(); i++)
+        ASSERT_NEAR(prod[i], M[i], 1E-10 * fabs(prod[i]));
+
+    net.optimizeOrder(ORD_GREEDY);
+    ASSERT_NE(std::string::npos, net.profile(false).find("Multiply-adds: 340 "));
+}
+
+TEST(Network, SectorCost){
+    // U(1) bonds with sectors -1, 0, 1 of dimensions 1, 2, 1: each product of two matrices takes 1 + 8 + 1
+    // multiply-adds instead of 4 * 4 * 4.
+    std::vector<Qnum> qnums;
+    qnums.push_back(Qnum(-1));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(1));
+    std::vector<Bond> bonds;
+    bonds.push_back(Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    UniTensor A(bonds), B(bonds), C(bonds), D(bonds);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+    D.randomize();
+
+    Network net("./Chain.net");
+    net.putTensor("A", A);
+    net.putTensor("B", B);
+    net.putTensor("C", C);
+    net.putTensor("D", D);
+    std::string prof = net.profile(false);
+    ASSERT_NE(std::string::npos, prof.find("Multiply-adds: 30 (dense bonds: 192)"));
+    ASSERT_NE(std::string::npos, prof.find("Permutation traffic: 0"));
+
+    int labels[] = {1, 2, 3, 4, 5};
+    A.setLabel(labels);
+    B.setLabel(labels + 1);
+    C.setLabel(labels + 2);
+    D.setLabel(labels + 3);
+    UniTensor ABCD = contract(A, B);
+    ABCD = contract(ABCD, C);
+    ABCD = contract(ABCD, D);
+    ASSERT_TRUE(ABCD.elemCmp(net.launch()));
+}
+
+TEST(Network, Compile){
+    std::vector<Bond> bondsA;
+    bondsA.push_back(Bond(BD_IN, 3));
+    bondsA.push_back(Bond(BD_OUT, 5));
+    std::vector<Bond> bondsB;
+    bondsB.push_back(Bond(BD_IN, 5));
+    bondsB.push_back(Bond(BD_OUT, 3));
+    UniTensor A(bondsA), B(bondsB), C(bondsA), D(bondsB);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+    D.randomize();
+
+    Network net("./Chain.net"), ref("./Chain.net");
+    UniTensor* tens[] = {&A, &B, &C, &D};
+    const char* names[] = {"A", "B", "C", "D"};
+    for(int t = 0; t < 4; t++){
+        net.putTensor(names[t], *tens[t]);
+        ref.putTensor(names[t], *tens[t]);
+    }
+    net.compile();
+    UniTensor first = net.launch();
+    ASSERT_TRUE(first.elemCmp(ref.launch()));
+
+    // Replaying a plan allocates the result only.
+    D.randomize();
+    net.putTensor("D", D);
+    ref.putTensor("D", D);
+    size_t allocs = ELEM_ALLOC_COUNT;
+    UniTensor second = net.launch();
+    ASSERT_EQ(allocs + 1, ELEM_ALLOC_COUNT);
+    ASSERT_TRUE(second.elemCmp(ref.launch()));
+    ASSERT_FALSE(first.elemCmp(second));
+
+    // New bonds invalidate the plan
+    bondsB[0] = Bond(BD_IN, 4);
+    bondsA[1] = Bond(BD_OUT, 4);
+    UniTensor C4(bondsA), D4(bondsB);
+    C4.randomize();
+    D4.randomize();
+    net.putTensor("C", C4);
+    net.putTensor("D", D4);
+    ref.putTensor("C", C4);
+    ref.putTensor("D", D4);
+    ASSERT_TRUE(net.launch().elemCmp(ref.launch()));
+
+    // Complex tensors and real ones
+    UniTensor Dc(CTYPE, bondsB);
+    Dc.randomize();
+    net.putTensor("D", Dc);
+    ref.putTensor("D", Dc);
+    UniTensor Tc = net.launch();
+    ASSERT_EQ(2, Tc.typeID());
+    ASSERT_TRUE(Tc.elemCmp(ref.launch()));
+}
+
+TEST(Network, CompileSymmetric){
+    std::vector<Qnum> qnums;
+    qnums.push_back(Qnum(-1));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(1));
+    std::vector<Bond> bonds;
+    bonds.push_back(Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    UniTensor A(bonds), B(bonds), C(bonds), D(bonds);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+    D.randomize();
+    Network net("./Chain.net"), ref("./Chain.net");
+    UniTensor* tens[] = {&A, &B, &C, &D};
+    const char* names[] = {"A", "B", "C", "D"};
+    for(int t = 0; t < 4; t++){
+        net.putTensor(names[t], *tens[t]);
+        ref.putTensor(names[t], *tens[t]);
+    }
+    net.compile();
+    for(int i = 0; i < 2; i++)
+        ASSERT_TRUE(net.launch().elemCmp(ref.launch()));
+
+    // An outer product is permuted after the multiplication.
+    Network outer("./Outer.net"), refOuter("./Outer.net");
+    outer.putTensor("A", A);
+    outer.putTensor("B", B);
+    refOuter.putTensor("A", A);
+    refOuter.putTensor("B", B);
+    outer.compile();
+    UniTensor T = outer.launch();
+    ASSERT_TRUE(T.elemCmp(refOuter.launch()));
+    int labels[] = {1, 3, 2, 4};
+    ASSERT_EQ(std::vector<int>(labels, labels + 4), T.label());
+}
+
+TEST(Network, Parallel){
+    // (A B) and (C D) are contracted at the same time.
+    std::vector<Bond> bonds;
+    bonds.push_back(Bond(BD_IN, 300));
+    bonds.push_back(Bond(BD_OUT, 300));
+    UniTensor A(bonds), B(bonds), C(bonds), D(bonds);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+    D.randomize();
+    Network net("./Tree.net");
+    net.putTensor("A", A);
+    net.putTensor("B", B);
+    net.putTensor("C", C);
+    net.putTensor("D", D);
+    int threadNum = getThreadNum();
+    setThreadNum(4);
+    // The two branches split the four threads, each multiplies with two BLAS threads. The serial reference
+    // uses as many, since the rounding of BLAS depends on its thread count.
+    UniTensor serial;
+    {
+        BlasThreads blas(2);
+        net.setParallel(1);
+        serial = net.launch();
+    }
+
+    net.setParallel(0);
+    ASSERT_TRUE(serial.elemCmp(net.launch()));
+    // A budget below any tensor still lets one contraction run at a time.
+    net.setParallel(2, 1);
+    ASSERT_TRUE(serial.elemCmp(net.launch()));
+    // Intermediate tensors kept for the cache stay held until the launch ends.
+    net.setCache(3 * 300 * 300 * sizeof(Real));
+    ASSERT_TRUE(serial.elemCmp(net.launch()));
+    ASSERT_TRUE(serial.elemCmp(net.launch()));
+    net.setCache(0);
+    ASSERT_ANY_THROW(net.setParallel(-1));
+    setThreadNum(threadNum);
+}
+
+TEST(Network, Cache){
+    std::vector<Bond> bonds;
+    bonds.push_back(Bond(BD_IN, 20));
+    bonds.push_back(Bond(BD_OUT, 20));
+    UniTensor A(bonds), B(bonds), C(bonds), D(bonds);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+    D.randomize();
+    Network net("./Tree.net"), ref("./Tree.net");
+    UniTensor* tens[] = {&A, &B, &C, &D};
+    const char* names[] = {"A", "B", "C", "D"};
+    for(int t = 0; t < 4; t++){
+        net.putTensor(names[t], *tens[t]);
+        ref.putTensor(names[t], *tens[t]);
+    }
+    size_t allocs = ELEM_ALLOC_COUNT;
+    UniTensor T = ref.launch();
+    size_t full = ELEM_ALLOC_COUNT - allocs;
+
+    net.setCache(1 << 20);
+    ASSERT_TRUE(T.elemCmp(net.launch()));
+    // Nothing changed, the kept result is returned.
+    allocs = ELEM_ALLOC_COUNT;
+    ASSERT_TRUE(T.elemCmp(net.launch()));
+    ASSERT_EQ(allocs, ELEM_ALLOC_COUNT);
+    // Replacing A contracts (A B) and the root again, (C D) is kept.
+    A.randomize();
+    net.putTensor("A", A);
+    ref.putTensor("A", A);
+    allocs = ELEM_ALLOC_COUNT;
+    T = net.launch();
+    ASSERT_EQ(allocs + full * 2 / 3, ELEM_ALLOC_COUNT);
+    ASSERT_TRUE(T.elemCmp(ref.launch()));
+
+    // Room for a single intermediate tensor: the root, used last, is kept.
+    net.setCache(20 * 20 * sizeof(Real));
+    D.randomize();
+    net.putTensor("D", D);
+    ref.putTensor("D", D);
+    T = net.launch();
+    ASSERT_TRUE(T.elemCmp(ref.launch()));
+    allocs = ELEM_ALLOC_COUNT;
+    ASSERT_TRUE(T.elemCmp(net.launch()));
+    ASSERT_EQ(allocs, ELEM_ALLOC_COUNT);
+    C.randomize();
+    net.putTensor("C", C);
+    ref.putTensor("C", C);
+    allocs = ELEM_ALLOC_COUNT;
+    T = net.launch();
+    ASSERT_EQ(allocs + full, ELEM_ALLOC_COUNT);
+    ASSERT_TRUE(T.elemCmp(ref.launch()));
+
+    // Concurrent contractions skip the kept subtrees as well.
+    int threadNum = getThreadNum();
+    setThreadNum(4);
+    std::vector<Bond> large;
+    large.push_back(Bond(BD_IN, 300));
+    large.push_back(Bond(BD_OUT, 300));
+    for(int t = 0; t < 4; t++){
+        *tens[t] = UniTensor(large);
+        tens[t]->randomize();
+        net.putTensor(names[t], *tens[t]);
+        ref.putTensor(names[t], *tens[t]);
+    }
+    net.setCache(1 << 30);
+    ASSERT_TRUE(net.launch().elemCmp(ref.launch()));
+    B.randomize();
+    net.putTensor("B", B);
+    ref.putTensor("B", B);
+    ASSERT_TRUE(net.launch().elemCmp(ref.launch()));
+    setThreadNum(threadNum);
+}
+
+TEST(Network, PutTensorT){
+    // The tensors put into the network share their elements, the transpose of a tensor without symmetry too.
+    std::vector<Bond> bondsX;
+    bondsX.push_back(Bond(BD_IN, 4));
+    bondsX.push_back(Bond(BD_OUT, 2));
+    bondsX.push_back(Bond(BD_OUT, 3));
+    std::vector<Bond> bondsB;
+    bondsB.push_back(Bond(BD_IN, 4));
+    bondsB.push_back(Bond(BD_OUT, 5));
+    UniTensor X(bondsX), B(bondsB);
+    X.randomize();
+    B.randomize();
+    UniTensor XT = X;
+    XT.transpose();
+
+    Network net("./Trans.net"), ref("./Trans.net");
+    size_t allocs = ELEM_ALLOC_COUNT;
+    net.putTensorT("A", X);
+    net.putTensor("B", B);
+    // Fermionic signs need the transpose right away, see Qnum::isFermionic().
+    ASSERT_EQ(allocs + Qnum::isFermionic(), ELEM_ALLOC_COUNT);
+    ref.putTensor("A", XT);
+    ref.putTensor("B", B);
+    UniTensor T = net.launch();
+    ASSERT_TRUE(T.elemCmp(ref.launch()));
+    int labels[] = {1, 2, 4};
+    ASSERT_EQ(std::vector<int>(labels, labels + 3), T.label());
+    // The caller's tensor is left untouched.
+    int labelsX[] = {0, 1, 2};
+    ASSERT_EQ(std::vector<int>(labelsX, labelsX + 3), X.label());
+    ASSERT_ANY_THROW(net.putTensorT("A", XT));
+
+    net.compile();
+    ASSERT_TRUE(net.launch().elemCmp(ref.launch()));
+    UniTensor Xc(CTYPE, bondsX);
+    Xc.randomize();
+    UniTensor XTc = Xc;
+    XTc.transpose();
+    net.putTensorT("A", Xc);
+    ref.putTensor("A", XTc);
+    ASSERT_TRUE(net.launch().elemCmp(ref.launch()));
+
+    // Bonds with symmetry are transposed when put.
+    std::vector<Qnum> qnums;
+    qnums.push_back(Qnum(-1));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(1));
+    std::vector<Bond> bonds;
+    bonds.push_back(Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    UniTensor A(bonds), C(bonds);
+    A.randomize();
+    C.randomize();
+    UniTensor AT = A;
+    AT.transpose();
+    Network sym("./Chain.net"), refSym("./Chain.net");
+    const char* names[] = {"B", "C", "D"};
+    sym.putTensorT("A", A);
+    refSym.putTensor("A", AT);
+    for(int t = 0; t < 3; t++){
+        sym.putTensor(names[t], C);
+        refSym.putTensor(names[t], C);
+    }
+    ASSERT_TRUE(sym.launch().elemCmp(refSym.launch()));
+}
+
+TEST(Network, MemoryLimit){
+    // (((A B) C) D) is the cheapest order but holds a 1 x 1000 tensor, ((A B) (C D)) holds 2 x 2 ones.
+    int dims[] = {1, 1, 2, 1000, 2};
+    UniTensor tens[4];
+    const char* names[] = {"A", "B", "C", "D"};
+    Network net("./Chain.net"), ref("./Chain.net");
+    size_t given = 0;
+    for(int t = 0; t < 4; t++){
+        std::vector<Bond> bonds;
+        bonds.push_back(Bond(BD_IN, dims[t]));
+        bonds.push_back(Bond(BD_OUT, dims[t + 1]));
+        tens[t] = UniTensor(bonds);
+        tens[t].randomize();
+        net.putTensor(names[t], tens[t]);
+        ref.putTensor(names[t], tens[t]);
+        given += tens[t].elemNum() * sizeof(Real);
+    }
+    ASSERT_EQ("(((A B) C) D)", net.optimizeOrder());
+    net.setMemoryLimit(given + 500 * sizeof(Real));
+    ASSERT_EQ("((A B) (C D))", net.optimizeOrder());
+    ASSERT_TRUE(net.launch().elemCmp(ref.launch()));
+
+    // Nothing is contracted when the limit cannot be met.
+    net.setMemoryLimit(given);
+    ASSERT_ANY_THROW(net.launch());
+    try{
+        net.launch();
+    }
+    catch(const std::exception& e){
+        ASSERT_NE(std::string::npos, std::string(e.what()).find("above the limit of"));
+    }
+    net.setMemoryLimit(0);
+    net.compile();
+    ASSERT_TRUE(net.launch().elemCmp(ref.launch()));
+    net.setMemoryLimit(given);
+    ASSERT_ANY_THROW(net.launch());
+}
+
+TEST(Network, Slicing){
+    // (A B) and (C D) are 300 x 300 and held together, slicing bond 3 between B and C into four pieces makes
+    // them 300 x 75.
+    std::vector<Bond> tall, wide;
+    tall.push_back(Bond(BD_IN, 300));
+    tall.push_back(Bond(BD_OUT, 2));
+    wide.push_back(Bond(BD_IN, 2));
+    wide.push_back(Bond(BD_OUT, 300));
+    UniTensor A(tall), B(wide), C(tall), D(wide);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+    D.randomize();
+    Network net("./Tree.net"), ref("./Tree.net");
+    UniTensor* tens[] = {&A, &B, &C, &D};
+    const char* names[] = {"A", "B", "C", "D"};
+    for(int t = 0; t < 4; t++){
+        net.putTensor(names[t], *tens[t]);
+        ref.putTensor(names[t], *tens[t]);
+    }
+    UniTensor T = ref.launch();
+    int threadNum = getThreadNum();
+    setThreadNum(1);
+    net.setSlicing(2 * 300 * 75 * sizeof(Real));
+    ASSERT_NE(std::string::npos, net.profile(false).find("Sliced bonds: 3 in 4 pieces"));
+    UniTensor S = net.launch();
+    for(size_t i = 0; i < T.elemNum(); i++)
+        ASSERT_NEAR(T[i], S[i], 1E-10 * (1 + fabs(T[i])));
+    // Four slices at a time share the target, each gets a quarter of it.
+    setThreadNum(4);
+    ASSERT_NE(std::string::npos, net.profile(false).find("Sliced bonds: 3 in 32 pieces"));
+    S = net.launch();
+    for(size_t i = 0; i < T.elemNum(); i++)
+        ASSERT_NEAR(T[i], S[i], 1E-10 * (1 + fabs(T[i])));
+    // The slices are summed in their order, whichever finishes first.
+    UniTensor S2 = net.launch();
+    for(size_t i = 0; i < T.elemNum(); i++)
+        ASSERT_EQ(S[i], S2[i]);
+    // The memory limit counts the slices running at the same time, each holds a result of its own.
+    net.setMemoryLimit(4 * 300 * 300 * sizeof(Real));
+    ASSERT_ANY_THROW(net.launch());
+    net.setMemoryLimit(6 * 300 * 300 * sizeof(Real));
+    ASSERT_TRUE(S.elemCmp(net.launch()));
+    net.setMemoryLimit(0);
+    setThreadNum(threadNum);
+    net.setSlicing(0);
+    ASSERT_TRUE(T.elemCmp(net.launch()));
+
+    // Bonds with symmetry are not sliced.
+    std::vector<Qnum> qnums;
+    qnums.push_back(Qnum(-1));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(1));
+    std::vector<Bond> bonds;
+    bonds.push_back(Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    UniTensor Q(bonds);
+    Q.randomize();
+    Network sym("./Tree.net");
+    for(int t = 0; t < 4; t++)
+        sym.putTensor(names[t], Q);
+    sym.setSlicing(1);
+    ASSERT_ANY_THROW(sym.launch());
+}
+
+TEST(Network, LaunchBatch){
+    std::vector<Bond> bonds;
+    bonds.push_back(Bond(BD_IN, 20));
+    bonds.push_back(Bond(BD_OUT, 20));
+    UniTensor A(bonds), B(bonds), C(bonds), D(bonds);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+    D.randomize();
+    Network net("./Tree.net"), ref("./Tree.net");
+    UniTensor* tens[] = {&A, &B, &C, &D};
+    const char* names[] = {"A", "B", "C", "D"};
+    for(int t = 0; t < 4; t++){
+        net.putTensor(names[t], *tens[t]);
+        ref.putTensor(names[t], *tens[t]);
+    }
+    std::vector<UniTensor> batch(6, UniTensor(bonds));
+    for(size_t i = 0; i < batch.size(); i++)
+        batch[i].randomize();
+    int threadNum = getThreadNum();
+    for(int num = 1; num <= 4; num += 3){
+        setThreadNum(num);
+        for(int t = 0; t < 4; t++){
+            std::vector<UniTensor> results = net.launchBatch(names[t], batch);
+            ASSERT_EQ(batch.size(), results.size());
+            for(size_t i = 0; i < batch.size(); i++){
+                ref.putTensor(names[t], batch[i]);
+                ASSERT_TRUE(results[i].elemCmp(ref.launch()));
+            }
+            net.putTensor(names[t], *tens[t]);
+            ref.putTensor(names[t], *tens[t]);
+        }
+    }
+    setThreadNum(threadNum);
+    ASSERT_EQ(0, net.launchBatch("A", std::vector<UniTensor>()).size());
+    std::vector<Bond> other;
+    other.push_back(Bond(BD_IN, 20));
+    other.push_back(Bond(BD_OUT, 10));
+    batch.push_back(UniTensor(other));
+    ASSERT_ANY_THROW(net.launchBatch("A", batch));
+    ASSERT_ANY_THROW(net.launchBatch("E", batch));
+}
+
+TEST(Network, Environments){
+    // Contracting the environment of a tensor with the tensor gives the result of the network.
+    std::vector<Bond> bonds;
+    bonds.push_back(Bond(BD_IN, 6));
+    bonds.push_back(Bond(BD_OUT, 6));
+    UniTensor A(bonds), B(bonds), C(bonds), D(bonds);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+    D.randomize();
+    Network net("./Tree.net");
+    UniTensor* tens[] = {&A, &B, &C, &D};
+    const char* names[] = {"A", "B", "C", "D"};
+    for(int t = 0; t < 4; t++)
+        net.putTensor(names[t], *tens[t]);
+    UniTensor T = net.launch();
+    std::vector<UniTensor> envs = net.environments();
+    ASSERT_EQ(4, envs.size());
+    int labels[][2] = {{1, 2}, {2, 3}, {3, 4}, {4, 5}};
+    int outLabels[] = {1, 5};
+    for(int t = 0; t < 4; t++){
+        tens[t]->setLabel(labels[t]);
+        UniTensor E = contract(envs[t], *tens[t]);
+        E.permute(outLabels, 1);
+        for(size_t i = 0; i < T.elemNum(); i++)
+            ASSERT_NEAR(T[i], E[i], 1E-10 * (1 + fabs(T[i])));
+    }
+    std::vector<std::string> holes(1, "C");
+    envs = net.environments(holes);
+    ASSERT_EQ(1, envs.size());
+    int envLabels[] = {4, 3, 1, 5};
+    ASSERT_EQ(std::vector<int>(envLabels, envLabels + 4), envs[0].label());
+    ASSERT_EQ(1, envs[0].inBondNum());
+    holes.push_back("E");
+    ASSERT_ANY_THROW(net.environments(holes));
+
+    // A trace of U(1) tensors, the environment has the bonds the tensor pairs with.
+    std::vector<Qnum> qnums;
+    qnums.push_back(Qnum(-1));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(1));
+    std::vector<Bond> sym;
+    sym.push_back(Bond(BD_IN, qnums));
+    sym.push_back(Bond(BD_OUT, qnums));
+    UniTensor P(sym), Q(sym), R(sym);
+    P.randomize();
+    Q.randomize();
+    R.randomize();
+    Network ring("./Ring.net");
+    ring.putTensor("A", P);
+    ring.putTensor("B", Q);
+    ring.putTensor("C", R);
+    Real trace = ring.launch()[0];
+    envs = ring.environments();
+    UniTensor* ringTens[] = {&P, &Q, &R};
+    int ringLabels[][2] = {{1, 2}, {2, 3}, {3, 1}};
+    for(int t = 0; t < 3; t++){
+        ringTens[t]->setLabel(ringLabels[t]);
+        ASSERT_NEAR(trace, contract(envs[t], *ringTens[t])[0], 1E-10 * (1 + fabs(trace)));
+    }
+}
+
+TEST(Network, MemoryUsage){
+    std::vector<Bond> bondsA;
+    bondsA.push_back(Bond(BD_IN, 20));
+    bondsA.push_back(Bond(BD_OUT, 30));
+    std::vector<Bond> bondsB;
+    bondsB.push_back(Bond(BD_IN, 30));
+    bondsB.push_back(Bond(BD_OUT, 20));
+    UniTensor A(bondsA), B(bondsB), C(bondsA), D(bondsB);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+    D.randomize();
+    Network net("./Chain.net");
+    net.putTensor("A", A);
+    net.putTensor("B", B);
+    net.putTensor("C", C);
+    net.putTensor("D", D);
+
+    // Intermediates and the result are charged to the network, within the scope of the caller.
+    MemoryUsage before = getMemoryUsage();
+    resetMemoryPeaks();
+    {
+        MemoryScope scope("sweep");
+        UniTensor T = net.launch();
+        ASSERT_EQ(getMemoryUsage().current[MEM_NETWORK], before.current[MEM_NETWORK] + 20 * 20 * sizeof(Real));
+    }
+    MemoryUsage after = getMemoryUsage();
+    ASSERT_EQ(after.current[MEM_NETWORK], before.current[MEM_NETWORK]);
+    ASSERT_GT(after.peak[MEM_NETWORK], before.current[MEM_NETWORK] + 20 * 20 * sizeof(Real));
+    ASSERT_EQ("sweep/Network::launch", after.peakSite);
+
+    // A budget overrun keeps its type through the launch.
+    setMemoryBudget(after.total + 100);
+    ASSERT_THROW(net.launch(), MemoryBudgetError);
+    setMemoryBudget(0);
+    ASSERT_EQ(getMemoryUsage().total, after.total);
+    ASSERT_EQ(net.launch().elemNum(), 400);
+
+    // The buffers of a compiled plan are network memory as long as the plan lives.
+    before = getMemoryUsage();
+    {
+        Network cnet("./Chain.net");
+        cnet.putTensor("A", A);
+        cnet.putTensor("B", B);
+        cnet.putTensor("C", C);
+        cnet.putTensor("D", D);
+        cnet.compile();
+        MemoryUsage compiled = getMemoryUsage();
+        ASSERT_GT(compiled.current[MEM_NETWORK], before.current[MEM_NETWORK]);
+        ASSERT_EQ(cnet.launch().elemNum(), 400);
+        ASSERT_EQ(getMemoryUsage().current[MEM_NETWORK], compiled.current[MEM_NETWORK]);
+    }
+    ASSERT_EQ(getMemoryUsage().current[MEM_NETWORK], before.current[MEM_NETWORK]);
+}
@@ -8,8 +8,14 @@
 
 #include <gtest/gtest.h>
 #include <iostream>
+#include <fstream>
 #include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include "uni10.hpp"
+#include <uni10/tools/uni10_tools.h>
+#include <uni10/numeric/lapack/uni10_lapack.h>
 #include <time.h>
 #include <vector>
 using namespace uni10;
@@ -303,3 +309,298 @@ TEST(Tools, CAddR){
 
 }
 
+
+TEST(Tools, parallelFor){
+
+    int threadNum = getThreadNum();
+    setThreadNum(3);
+    std::vector<size_t> hits(1000, 0);
+    parallelFor(hits.size(), [&](size_t i){ hits[i] += i; });
+    for(size_t i = 0; i < hits.size(); i++)
+        ASSERT_EQ(hits[i], i);
+
+    bool thrown = false;
+    try{
+        parallelFor(100, [](size_t i){
+            if(i == 42)
+                throw std::runtime_error("task failed");
+        });
+    }
+    catch(const std::runtime_error& e){
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+
+    // Resizing the pool from one of its tasks throws instead of waiting for itself.
+    std::vector<int> refused(4, 0);
+    parallelFor(refused.size(), [&](size_t i){
+        try{
+            setThreadNum(2);
+        }
+        catch(const std::runtime_error& e){
+            refused[i] = 1;
+        }
+    });
+    for(size_t i = 0; i < refused.size(); i++)
+        ASSERT_EQ(refused[i], 1);
+    ASSERT_EQ(getThreadNum(), 3);
+    setThreadNum(threadNum);
+
+}
+
+TEST(Tools, BlasThreads){
+
+    int threadNum = getThreadNum();
+    setThreadNum(3);
+    ASSERT_FALSE(inParallelFor());
+    std::vector<int> inside(4, 0);
+    parallelFor(inside.size(), [&](size_t i){ inside[i] = inParallelFor(); });
+    for(size_t i = 0; i < inside.size(); i++)
+        ASSERT_EQ(inside[i], 1);
+    ASSERT_FALSE(inParallelFor());
+
+    // A BlasThreads restores the setting it found, also when the tasks under it set their own.
+    int before = setBlasLocalThreadNum(1);
+    setBlasLocalThreadNum(before);
+    {
+        BlasThreads blas(1);
+        parallelFor(4, [](size_t){ BlasThreads local(1); });
+    }
+    ASSERT_EQ(setBlasLocalThreadNum(before), before);
+    setThreadNum(threadNum);
+
+}
+
+TEST(Tools, matrixMulBatch){
+
+    // Small shapes on the micro-kernels, including edge tiles, and one through BLAS.
+    int shapes[][3] = {{1, 1, 1}, {3, 5, 7}, {4, 4, 4}, {9, 2, 13}, {3, 5, 7}, {40, 40, 40}};
+    size_t count = 6;
+    std::vector<std::vector<double> > As(count), Bs(count), Cs(count), refs(count);
+    std::vector<const double*> A(count), B(count);
+    std::vector<double*> C(count);
+    std::vector<int> M(count), N(count), K(count);
+    for(int t = 0; t < 4; t++){
+        bool transA = t & 1;
+        bool transB = t & 2;
+        for(size_t i = 0; i < count; i++){
+            M[i] = shapes[i][0];
+            N[i] = shapes[i][1];
+            K[i] = shapes[i][2];
+            As[i].resize(M[i] * K[i]);
+            Bs[i].resize(K[i] * N[i]);
+            Cs[i].resize(M[i] * N[i]);
+            elemRand(&As[i][0], As[i].size(), false);
+            elemRand(&Bs[i][0], Bs[i].size(), false);
+            elemRand(&Cs[i][0], Cs[i].size(), false);
+            refs[i].assign(M[i] * N[i], 0);
+            for(int m = 0; m < M[i]; m++)
+                for(int n = 0; n < N[i]; n++){
+                    double sum = 0;
+                    for(int k = 0; k < K[i]; k++)
+                        sum += (transA ? As[i][k * M[i] + m] : As[i][m * K[i] + k]) * (transB ? Bs[i][n * K[i] + k] : Bs[i][k * N[i] + n]);
+                    refs[i][m * N[i] + n] = 2 * sum + 0.5 * Cs[i][m * N[i] + n];
+                }
+            A[i] = &As[i][0];
+            B[i] = &Bs[i][0];
+            C[i] = &Cs[i][0];
+        }
+        matrixMulBatch(transA, transB, count, &A[0], &B[0], &M[0], &N[0], &K[0], 2.0, 0.5, &C[0], false);
+        for(size_t i = 0; i < count; i++)
+            for(size_t j = 0; j < Cs[i].size(); j++)
+                ASSERT_NEAR(Cs[i][j], refs[i][j], 1E-12);
+    }
+
+    Matrix CA(CTYPE, 5, 3);
+    CA.randomize();
+    Matrix CB(CTYPE, 3, 6);
+    CB.randomize();
+    Matrix CC = CA * CB;
+    for(int m = 0; m < 5; m++)
+        for(int n = 0; n < 6; n++){
+            Complex sum = 0;
+            for(int k = 0; k < 3; k++)
+                sum += CA(m * 3 + k) * CB(k * 6 + n);
+            ASSERT_NEAR(std::abs(CC(m * 6 + n) - sum), 0, 1E-12);
+        }
+
+}
+
+TEST(Tools, Pool){
+
+    setPoolEnabled(true);
+    // A freed buffer serves the next request of the same size class, from the thread cache or the shared lists.
+    for(size_t bytes = 1000; bytes <= (1 << 22); bytes *= 8){
+        void* ptr = poolAlloc(bytes, MEM_TENSOR);
+        memset(ptr, 1, bytes);
+        poolFree(ptr);
+        PoolStats before = getPoolStats();
+        ASSERT_GE(before.cachedBytes, bytes);
+        void* again = poolAlloc(bytes - 8, MEM_TENSOR);
+        ASSERT_EQ(ptr, again);
+        PoolStats after = getPoolStats();
+        ASSERT_EQ(after.hits, before.hits + 1);
+        ASSERT_EQ(after.allocs, before.allocs + 1);
+        poolFree(again);
+    }
+
+    // Element buffers of a Matrix come from the pool.
+    {
+        Matrix A(100, 100);
+        A.randomize();
+    }
+    PoolStats before = getPoolStats();
+    {
+        Matrix B(100, 100);
+    }
+    ASSERT_EQ(getPoolStats().hits, before.hits + 1);
+
+    // The limit bounds the cached bytes.
+    setPoolLimit(1 << 20);
+    releasePool();
+    void* big = poolAlloc(1 << 21, MEM_TENSOR);
+    poolFree(big);
+    ASSERT_LE(getPoolStats().cachedBytes, (size_t)(1 << 20));
+    setPoolLimit((size_t)256 << 20);
+
+    // Releasing the buffers of one tag keeps the others.
+    releasePool();
+    void* packed = poolAlloc(1000, MEM_CONTRACT);
+    void* kept = poolAlloc(5000, MEM_TENSOR);
+    poolFree(packed);
+    poolFree(kept);
+    UniTensor::clearContractWorkspace();
+    PoolStats cleared = getPoolStats();
+    void* again = poolAlloc(5000, MEM_TENSOR);
+    ASSERT_EQ(kept, again);
+    poolFree(again);
+    poolFree(poolAlloc(1000, MEM_CONTRACT));
+    ASSERT_EQ(getPoolStats().hits, cleared.hits + 1);
+    releasePool();
+
+    // The cache of another thread is released on its next request.
+    std::mutex lock;
+    std::condition_variable cv;
+    int step = 0;
+    size_t otherHits = 0;
+    std::thread other([&](){
+        poolFree(poolAlloc(1000, MEM_TENSOR));
+        std::unique_lock<std::mutex> lk(lock);
+        step = 1;
+        cv.notify_all();
+        cv.wait(lk, [&](){ return step == 2; });
+        size_t hits = getPoolStats().hits;
+        poolFree(poolAlloc(1000, MEM_TENSOR));
+        otherHits = getPoolStats().hits - hits;
+    });
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        cv.wait(lk, [&](){ return step == 1; });
+        releasePool();
+        step = 2;
+        cv.notify_all();
+    }
+    other.join();
+    ASSERT_EQ(otherHits, 0);
+
+    // Switched off, the pool holds nothing and buffers still round-trip.
+    setPoolEnabled(false);
+    PoolStats off = getPoolStats();
+    ASSERT_FALSE(off.enabled);
+    ASSERT_EQ(off.cachedBytes, 0);
+    void* ptr = poolAlloc(5000, MEM_TENSOR);
+    poolFree(ptr);
+    ASSERT_EQ(getPoolStats().cachedBytes, 0);
+    ASSERT_EQ(getPoolStats().allocs, off.allocs);
+    setPoolEnabled(true);
+
+}
+
+TEST(Tools, Alignment){
+
+    for(size_t bytes = 1; bytes < (1 << 23); bytes = bytes * 3 + 1){
+        void* ptr = poolAlloc(bytes, MEM_TENSOR);
+        ASSERT_EQ((size_t)ptr % UNI10_ALIGNMENT, 0);
+        poolFree(ptr);
+    }
+    Matrix A(CTYPE, 7, 3);
+    ASSERT_EQ((size_t)A.getElem(CTYPE) % UNI10_ALIGNMENT, 0);
+
+    // Each policy places buffers without changing their contents.
+    numaPolicy old = getNumaPolicy();
+    numaPolicy policies[] = {NUMA_DEFAULT, NUMA_INTERLEAVE, NUMA_FIRST_TOUCH};
+    size_t elemNum = UNI10_NUMA_LARGE / sizeof(Real) + 1000;
+    for(int p = 0; p < 3; p++){
+        setNumaPolicy(policies[p]);
+        ASSERT_EQ(getNumaPolicy(), policies[p]);
+        bool ongpu;
+        Real* elem = (Real*)elemAlloc(elemNum * sizeof(Real), ongpu);
+        memset(elem, 1, elemNum * sizeof(Real));
+        elemBzero(elem, elemNum * sizeof(Real), ongpu);
+        for(size_t i = 0; i < elemNum; i++)
+            ASSERT_EQ(elem[i], 0);
+        elemFree(elem, elemNum * sizeof(Real), ongpu);
+    }
+    setNumaPolicy(old);
+
+}
+
+TEST(Tools, MemoryUsage){
+
+    MemoryUsage before = getMemoryUsage();
+    {
+        Matrix A(100, 100);
+        MemoryUsage usage = getMemoryUsage();
+        ASSERT_EQ(usage.current[MEM_MATRIX], before.current[MEM_MATRIX] + 100 * 100 * sizeof(Real));
+        ASSERT_EQ(usage.total, before.total + 100 * 100 * sizeof(Real));
+        ASSERT_GE(usage.peak[MEM_MATRIX], usage.current[MEM_MATRIX]);
+    }
+    ASSERT_EQ(getMemoryUsage().current[MEM_MATRIX], before.current[MEM_MATRIX]);
+
+    // A scope with a subsystem charges to it, and names the site of a new peak.
+    resetMemoryPeaks();
+    {
+        MemoryScope outer("sweep");
+        MemoryScope inner("step 1", MEM_NETWORK);
+        Matrix A(300, 300);
+        ASSERT_EQ(getMemoryUsage().current[MEM_NETWORK], before.current[MEM_NETWORK] + 300 * 300 * sizeof(Real));
+    }
+    ASSERT_EQ("sweep/step 1", getMemoryUsage().peakSite);
+    ASSERT_EQ(getMemoryUsage().current[MEM_NETWORK], before.current[MEM_NETWORK]);
+
+    // Past the budget, allocations throw by type before taking memory.
+    setMemoryBudget(getMemoryUsage().total + 1000 * sizeof(Real));
+    Matrix small(10, 10);
+    size_t total = getMemoryUsage().total;
+    ASSERT_THROW(Matrix(100, 100), MemoryBudgetError);
+    try{
+        Matrix A(CTYPE, 100, 100);
+        FAIL();
+    }
+    catch(const MemoryBudgetError& e){
+        ASSERT_EQ(e.requested(), 100 * 100 * sizeof(Complex));
+        ASSERT_EQ(e.usage(), total);
+    }
+    ASSERT_EQ(getMemoryUsage().total, total);
+    setMemoryBudget(0);
+
+    // The trace records size, subsystem, site and lifetime.
+    setMemoryTrace(true);
+    {
+        MemoryScope scope("traced");
+        Matrix A(20, 30);
+        Matrix B = A;
+        A.randomize();
+    }
+    Matrix alive(7, 7);
+    setMemoryTrace(false);
+    dumpMemoryTrace("memoryTrace.json");
+    std::ifstream file("memoryTrace.json");
+    std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ASSERT_NE(json.find("\"bytes\": 4800, \"subsystem\": \"matrix\", \"site\": \"traced\""), std::string::npos);
+    ASSERT_NE(json.find("\"bytes\": 392, \"subsystem\": \"matrix\", \"site\": \"\""), std::string::npos);
+    ASSERT_NE(json.find("\"freeTime\": null"), std::string::npos);
+    ASSERT_NE(json.find("\"subsystems\": {\"tensor\": {"), std::string::npos);
+    remove("memoryTrace.json");
+
+}
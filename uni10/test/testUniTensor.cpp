@@ -9,6 +9,8 @@
 #include <iostream>
 #include <map>
 #include "uni10.hpp"
+#include <uni10/tools/uni10_tools.h>
+#include <thread>
 #include <time.h>
 #include <vector>
 using namespace uni10;
@@ -253,3 +255,582 @@ TEST(UniTensor, maxNorm){
     }
 }
 
+
+TEST(UniTensor, PermuteWithoutSymmetry){
+
+    std::vector<Bond> bonds;
+    bonds.push_back(Bond(BD_IN, 3));
+    bonds.push_back(Bond(BD_IN, 37));
+    bonds.push_back(Bond(BD_OUT, 5));
+    bonds.push_back(Bond(BD_OUT, 41));
+    int newLabels[] = {3, 1, 0, 2};
+    std::vector<int> labels(newLabels, newLabels + 4);
+
+    UniTensor A(bonds);
+    A.randomize();
+    UniTensor B = A;
+    B.permute(labels, 1);
+    ASSERT_EQ(B.inBondNum(), 1);
+
+    UniTensor CA(CTYPE, bonds);
+    CA.randomize();
+    UniTensor CB = CA;
+    CB.permute(labels, 3);
+
+    std::vector<size_t> idxs(4), pidxs(4);
+    for(idxs[0] = 0; idxs[0] < 3; idxs[0]++)
+        for(idxs[1] = 0; idxs[1] < 37; idxs[1]++)
+            for(idxs[2] = 0; idxs[2] < 5; idxs[2]++)
+                for(idxs[3] = 0; idxs[3] < 41; idxs[3]++){
+                    for(int b = 0; b < 4; b++)
+                        pidxs[b] = idxs[labels[b]];
+                    ASSERT_EQ(A.at(idxs), B.at(pidxs));
+                    ASSERT_EQ(CA.at(CTYPE, idxs), CB.at(CTYPE, pidxs));
+                }
+
+    B.permute(A.label(), 2);
+    for(size_t i = 0; i < A.elemNum(); i++)
+        ASSERT_EQ(A[i], B[i]);
+
+}
+
+TEST(UniTensor, PermutePlanCache){
+
+    std::vector<Qnum> qnums;
+    qnums.push_back(Qnum(1));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(-1));
+    std::vector<Bond> bonds(2, Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    int newLabels[] = {2, 0, 3, 1};
+    std::vector<int> labels(newLabels, newLabels + 4);
+
+    UniTensor A(bonds);
+    A.randomize();
+
+    UniTensor::setPermutePlanCacheSize(0);
+    UniTensor::clearPermutePlanCache();
+    UniTensor B = A;
+    B.permute(labels, 1);
+    ASSERT_EQ(UniTensor::permutePlanHits(), 0);
+    ASSERT_EQ(UniTensor::permutePlanMisses(), 1);
+
+    Matrix rawA = A.getRawElem();
+    Matrix rawB = B.getRawElem();
+    std::vector<size_t> idxs(4), pidxs(4);
+    for(idxs[0] = 0; idxs[0] < 4; idxs[0]++)
+        for(idxs[1] = 0; idxs[1] < 4; idxs[1]++)
+            for(idxs[2] = 0; idxs[2] < 4; idxs[2]++)
+                for(idxs[3] = 0; idxs[3] < 4; idxs[3]++){
+                    for(int b = 0; b < 4; b++)
+                        pidxs[b] = idxs[labels[b]];
+                    ASSERT_EQ(rawA.at(idxs[0] * 4 + idxs[1], idxs[2] * 4 + idxs[3]),
+                              rawB.at(pidxs[0], (pidxs[1] * 4 + pidxs[2]) * 4 + pidxs[3]));
+                }
+
+    UniTensor::setPermutePlanCacheSize(256);
+    for(int i = 0; i < 3; i++){
+        UniTensor C = A;
+        C.permute(labels, 1);
+        ASSERT_TRUE(C.elemCmp(B));
+        C.permute(A.label(), 2);
+        ASSERT_TRUE(C.elemCmp(A));
+    }
+    ASSERT_EQ(UniTensor::permutePlanHits(), 4);
+    ASSERT_EQ(UniTensor::permutePlanMisses(), 3);
+
+    UniTensor::setPermutePlanCacheSize(1);
+    B.permute(A.label(), 2);
+    ASSERT_TRUE(B.elemCmp(A));
+    UniTensor::clearPermutePlanCache();
+    ASSERT_EQ(UniTensor::permutePlanHits(), 0);
+    UniTensor::setPermutePlanCacheSize(256);
+
+}
+
+TEST(UniTensor, PermuteThreads){
+
+    std::vector<Qnum> qnums;
+    for(int q = -2; q <= 2; q++){
+        qnums.push_back(Qnum(q));
+        qnums.push_back(Qnum(q));
+    }
+    std::vector<Bond> bonds(2, Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    int newLabels[] = {4, 2, 0, 3, 1};
+    std::vector<int> labels(newLabels, newLabels + 5);
+
+    UniTensor A(bonds);
+    A.randomize();
+    UniTensor CA(CTYPE, bonds);
+    CA.randomize();
+
+    int threadNum = getThreadNum();
+    setThreadNum(1);
+    ASSERT_EQ(getThreadNum(), 1);
+    UniTensor B = A;
+    B.permute(labels, 3);
+    UniTensor CB = CA;
+    CB.permute(labels, 2);
+
+    setThreadNum(4);
+    ASSERT_EQ(getThreadNum(), 4);
+    UniTensor C = A;
+    C.permute(labels, 3);
+    UniTensor CC = CA;
+    CC.permute(labels, 2);
+    setThreadNum(threadNum);
+
+    for(size_t i = 0; i < B.elemNum(); i++)
+        ASSERT_EQ(B[i], C[i]);
+    for(size_t i = 0; i < CB.elemNum(); i++)
+        ASSERT_EQ(CB(i), CC(i));
+
+}
+
+TEST(UniTensor, ManySectors){
+
+    std::vector<Qnum> qnums;
+    for(int q = -3; q <= 3; q++)
+        qnums.push_back(Qnum(q));
+    std::vector<Bond> bonds(2, Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    int newLabels[] = {3, 0, 2, 1};
+    std::vector<int> labels(newLabels, newLabels + 4);
+
+    UniTensor A(bonds);
+    A.randomize();
+    UniTensor B = A;
+    B.permute(labels, 1);
+    UniTensor C;
+    C = B;
+    C.permute(2);
+    C.permute(labels, 2);
+    UniTensor CA(CTYPE, bonds);
+    CA.randomize();
+    UniTensor CB = CA;
+    CB.permute(labels, 3);
+
+    // Elements outside the symmetry sectors read as zero.
+    std::vector<size_t> idxs(4), pidxs(4);
+    for(idxs[0] = 0; idxs[0] < 7; idxs[0]++)
+        for(idxs[1] = 0; idxs[1] < 7; idxs[1]++)
+            for(idxs[2] = 0; idxs[2] < 7; idxs[2]++)
+                for(idxs[3] = 0; idxs[3] < 7; idxs[3]++){
+                    for(int b = 0; b < 4; b++)
+                        pidxs[b] = idxs[labels[b]];
+                    if(idxs[0] + idxs[1] != idxs[2] + idxs[3]){
+                        ASSERT_EQ(A.at(idxs), 0);
+                    }
+                    ASSERT_EQ(A.at(idxs), B.at(pidxs));
+                    ASSERT_EQ(A.at(idxs), C.at(pidxs));
+                    ASSERT_EQ(CA.at(CTYPE, idxs), CB.at(CTYPE, pidxs));
+                }
+
+    C.permute(A.label(), 2);
+    ASSERT_TRUE(C.elemCmp(A));
+    ASSERT_EQ(A.blockNum(), 13);
+
+}
+
+TEST(UniTensor, ContractLayouts){
+
+    std::vector<Qnum> qnums;
+    qnums.push_back(Qnum(1));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(-1));
+    std::vector<Qnum> trivial(3, Qnum());
+    for(int sym = 0; sym < 2; sym++){
+        const std::vector<Qnum>& q = sym ? qnums : trivial;
+        std::vector<Bond> bondsA(2, Bond(BD_IN, q));
+        bondsA.push_back(Bond(BD_OUT, q));
+        bondsA.push_back(Bond(BD_OUT, q));
+        std::vector<Bond> bondsB(2, Bond(BD_IN, q));
+        bondsB.push_back(Bond(BD_OUT, q));
+        int labelA[] = {1, 2, 3, 4};
+        int labelB[] = {3, 4, 5};
+        int labelAt[] = {3, 4, 1, 2};
+        int labelBt[] = {5, 3, 4};
+        int labelC[] = {1, 2, 5};
+
+        UniTensor A(bondsA);
+        A.setLabel(labelA);
+        A.randomize();
+        UniTensor B(bondsB);
+        B.setLabel(labelB);
+        B.randomize();
+        Matrix rawC = A.getRawElem() * B.getRawElem();
+
+        // Operands in the GEMM layout, its transpose, and neither.
+        UniTensor As[3] = {A, A, A};
+        As[1].permute(labelAt, 2);
+        As[2].permute(labelAt, 1);
+        UniTensor Bs[3] = {B, B, B};
+        Bs[1].permute(labelBt, 1);
+        Bs[2].permute(labelBt, 2);
+        for(int a = 0; a < 3; a++)
+            for(int b = 0; b < 3; b++){
+                UniTensor C = contract(As[a], Bs[b], false);
+                C.permute(labelC, 2);
+                Matrix raw = C.getRawElem();
+                ASSERT_EQ(raw.elemNum(), rawC.elemNum());
+                for(size_t i = 0; i < raw.elemNum(); i++)
+                    ASSERT_NEAR(raw[i], rawC[i], 1E-12);
+            }
+    }
+
+}
+
+TEST(UniTensor, ContractConst){
+
+    std::vector<Qnum> qnums;
+    qnums.push_back(Qnum(1));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(-1));
+    std::vector<Bond> bonds(2, Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    int labelEnv[] = {1, 2, 3, 4};
+    int labelOp[] = {5, 4, 3, 6};
+
+    UniTensor E(bonds);
+    E.setLabel(labelEnv);
+    E.randomize();
+    const UniTensor env = E;
+    std::vector<UniTensor> ops(8, UniTensor(bonds));
+    std::vector<UniTensor> refs;
+    for(size_t i = 0; i < ops.size(); i++){
+        ops[i].permute(2);
+        ops[i].setLabel(labelOp);
+        ops[i].randomize();
+        UniTensor cE = E;
+        UniTensor cOp = ops[i];
+        refs.push_back(contract(cE, cOp, true));
+    }
+
+    UniTensor C = contract(env, ops[0]);
+    ASSERT_TRUE(C.elemCmp(refs[0]));
+    ASSERT_TRUE(env.elemCmp(E));
+    ASSERT_EQ(env.label(), E.label());
+    ASSERT_EQ(env.inBondNum(), E.inBondNum());
+
+    // A shared read-only tensor feeding several threads.
+    int threadNum = getThreadNum();
+    setThreadNum(4);
+    std::vector<UniTensor> outs(ops.size());
+    parallelFor(ops.size(), [&](size_t i){
+        outs[i] = contract(env, ops[i]);
+    });
+    setThreadNum(threadNum);
+    for(size_t i = 0; i < ops.size(); i++)
+        ASSERT_TRUE(outs[i].elemCmp(refs[i]));
+    ASSERT_TRUE(env.elemCmp(E));
+
+    UniTensor::clearContractWorkspace();
+
+}
+
+TEST(UniTensor, ContractThreads){
+
+    // Sectors of very different sizes.
+    std::vector<Qnum> qnums;
+    for(int q = -2; q <= 2; q++)
+        for(int d = 0; d < q + 3; d++)
+            qnums.push_back(Qnum(q));
+    std::vector<Bond> bonds(2, Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    int labelA[] = {1, 2, 3, 4};
+    int labelB[] = {3, 4, 5, 6};
+
+    UniTensor A(bonds);
+    A.setLabel(labelA);
+    A.randomize();
+    UniTensor B(bonds);
+    B.setLabel(labelB);
+    B.randomize();
+    UniTensor CA(CTYPE, bonds);
+    CA.setLabel(labelA);
+    CA.randomize();
+
+    int threadNum = getThreadNum();
+    setThreadNum(1);
+    UniTensor C1 = contract(A, B);
+    UniTensor CC1 = contract(CA, B);
+    setThreadNum(4);
+    UniTensor C4 = contract(A, B);
+    UniTensor CC4 = contract(CA, B);
+    setThreadNum(threadNum);
+
+    ASSERT_TRUE(C1.elemCmp(C4));
+    ASSERT_TRUE(CC1.elemCmp(CC4));
+    Matrix raw = C1.getRawElem();
+    Matrix rawC = A.getRawElem() * B.getRawElem();
+    for(size_t i = 0; i < raw.elemNum(); i++)
+        ASSERT_NEAR(raw[i], rawC[i], 1E-10);
+
+}
+
+TEST(UniTensor, ConcurrentRandomize){
+
+    // Runs before any setRandomSeed(), so every thread seeds its engine from rand() on its first draw.
+    std::vector<Bond> bonds(2, Bond(BD_IN, 6));
+    bonds.push_back(Bond(BD_OUT, 6));
+    int threadNum = 8;
+    std::vector<UniTensor> tensors(threadNum, UniTensor(bonds));
+    std::vector<int> failures(threadNum, 0);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < threadNum; t++)
+        threads.push_back(std::thread([&, t](){
+            for(int r = 0; r < 50; r++){
+                tensors[t].randomize();
+                for(size_t i = 0; i < tensors[t].elemNum(); i++)
+                    if(tensors[t][i] < 0 || tensors[t][i] >= 1)
+                        failures[t]++;
+            }
+        }));
+    for(int t = 0; t < threadNum; t++)
+        threads[t].join();
+    for(int t = 0; t < threadNum; t++){
+        ASSERT_EQ(failures[t], 0);
+        for(int s = 0; s < t; s++)
+            ASSERT_FALSE(tensors[t].elemCmp(tensors[s]));
+    }
+
+}
+
+TEST(UniTensor, ConcurrentThreads){
+
+    std::vector<Qnum> qnums;
+    for(int q = -1; q <= 1; q++)
+        for(int d = 0; d < 3; d++)
+            qnums.push_back(Qnum(q));
+    std::vector<Bond> bonds(2, Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    int labelA[] = {1, 2, 3, 4};
+    int labelB[] = {3, 4, 5, 6};
+    int perm[] = {6, 1, 5, 2};
+
+    UniTensor A(bonds);
+    A.setLabel(labelA);
+    A.randomize();
+    UniTensor B(bonds);
+    B.setLabel(labelB);
+    B.randomize();
+    const UniTensor sharedA = A;
+    const UniTensor sharedB = B;
+    UniTensor ref = contract(A, B);
+    ref.permute(perm, 2);
+    size_t memUsage = MEM_USAGE;
+
+    // Every thread builds, randomizes, copies, contracts and destroys tensors, so that the global counters,
+    // the random engines and the memory pool are hit concurrently.
+    int threadNum = 8;
+    std::vector<int> failures(threadNum, 0);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < threadNum; t++)
+        threads.push_back(std::thread([&, t](){
+            for(int r = 0; r < 20; r++){
+                std::vector<Bond> own(2, Bond(BD_IN, qnums));
+                own.push_back(Bond(BD_OUT, qnums));
+                own.push_back(Bond(BD_OUT, qnums));
+                UniTensor X(own);
+                X.setLabel(labelA);
+                X.randomize();
+                UniTensor Y = X;
+                Y.setLabel(labelB);
+                UniTensor Z = contract(X, Y);
+                Z.permute(perm, 2);
+                UniTensor C = contract(sharedA, sharedB);
+                C.permute(perm, 2);
+                if(!C.elemCmp(ref))
+                    failures[t]++;
+            }
+        }));
+    for(int t = 0; t < threadNum; t++)
+        threads[t].join();
+    for(int t = 0; t < threadNum; t++)
+        ASSERT_EQ(failures[t], 0);
+    ASSERT_EQ(size_t(MEM_USAGE), memUsage);
+
+    // A seed makes the random elements repeatable.
+    setRandomSeed(17);
+    A.randomize();
+    setRandomSeed(17);
+    B.setLabel(labelA);
+    B.randomize();
+    ASSERT_TRUE(A.elemCmp(B));
+    for(size_t i = 0; i < A.elemNum(); i++){
+        ASSERT_GE(A[i], 0);
+        ASSERT_LT(A[i], 1);
+    }
+
+}
+
+TEST(UniTensor, ContractInto){
+
+    std::vector<Qnum> qnums;
+    qnums.push_back(Qnum(1));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(-1));
+    std::vector<Bond> bonds(2, Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    int labelA[] = {1, 2, 3, 4};
+    int labelB[] = {4, 3, 5, 6};
+
+    UniTensor A(bonds);
+    A.setLabel(labelA);
+    A.randomize();
+    UniTensor B(bonds);
+    B.setLabel(labelB);
+    B.randomize();
+    UniTensor C = contract(A, B);
+
+    UniTensor D = C;
+    D.randomize();
+    contract(A, B, D);
+    ASSERT_TRUE(D.elemCmp(C));
+    contract(A, B, D, 2.0, 0.5);
+    ASSERT_TRUE(D.elemCmp(C * 2.5));
+
+    // Complex output of Real operands
+    UniTensor CD(CTYPE, C.bond());
+    CD.setLabel(C.label());
+    contract(A, B, CD);
+    ASSERT_TRUE(CD.elemCmp(C));
+
+    // Outer product
+    std::vector<Bond> bondsO(1, Bond(BD_IN, qnums));
+    bondsO.push_back(Bond(BD_OUT, qnums));
+    UniTensor X(bondsO);
+    X.randomize();
+    int labelY[] = {2, 3};
+    UniTensor Y(bondsO);
+    Y.setLabel(labelY);
+    Y.randomize();
+    UniTensor XY = contract(X, Y);
+    UniTensor Z = XY;
+    contract(X, Y, Z, 1.0, -1.0);
+    for(size_t i = 0; i < Z.elemNum(); i++)
+        ASSERT_NEAR(Z[i], 0, 1E-12);
+
+    UniTensor W(bonds);
+    ASSERT_ANY_THROW(contract(A, B, W));
+    ASSERT_ANY_THROW(contract(A, C, C));
+
+}
+
+TEST(UniTensor, CopyOnWrite){
+    std::vector<Qnum> qnums;
+    qnums.push_back(Qnum(1));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(-1));
+    std::vector<Bond> bonds(2, Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    UniTensor A(bonds);
+    A.randomize();
+    const Block& blkA = A.const_getBlock(Qnum(0));
+    Real* elemA = blkA.getElem();
+    Matrix matA = A.getBlock(Qnum(0));
+
+    size_t mem = MEM_USAGE;
+    UniTensor B = A;
+    UniTensor C;
+    C = A;
+    ASSERT_EQ(mem, MEM_USAGE);
+    ASSERT_EQ(elemA, B.const_getBlock(Qnum(0)).getElem());
+    ASSERT_EQ(elemA, C.const_getBlock(Qnum(0)).getElem());
+
+    // Writes copy the elements of the written tensor only
+    B *= 2.0;
+    ASSERT_NE(elemA, B.const_getBlock(Qnum(0)).getElem());
+    ASSERT_TRUE(B.elemCmp(C * 2.0));
+    ASSERT_EQ(elemA, blkA.getElem());
+    ASSERT_TRUE(A.getBlock(Qnum(0)) == matA);
+
+    Matrix zero(matA.row(), matA.col());
+    zero.set_zero();
+    C.putBlock(Qnum(0), zero);
+    ASSERT_TRUE(C.getBlock(Qnum(0)) == zero);
+    ASSERT_TRUE(A.getBlock(Qnum(0)) == matA);
+
+    // The last owner writes in place
+    UniTensor D = A;
+    D.set_zero();
+    A.setElem(D.getElem());
+    ASSERT_EQ(elemA, blkA.getElem());
+    ASSERT_EQ(0.0, A.norm());
+
+    UniTensor E(CTYPE, bonds);
+    E.randomize();
+    UniTensor F = E;
+    F.setElem(std::vector<Complex>(F.elemNum(), Complex(1, 1)));
+    ASSERT_FALSE(E.elemCmp(F));
+    ASSERT_EQ(Complex(1, 1), F.at(CTYPE, 0));
+}
+
+TEST(UniTensor, Move){
+    std::vector<Qnum> qnums;
+    qnums.push_back(Qnum(1));
+    qnums.push_back(Qnum(0));
+    qnums.push_back(Qnum(-1));
+    std::vector<Bond> bonds(2, Bond(BD_IN, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    bonds.push_back(Bond(BD_OUT, qnums));
+    int labelA[] = {1, 2, 3, 4};
+    int labelB[] = {3, 4, 5, 6};
+    UniTensor A(bonds);
+    A.setLabel(labelA);
+    A.randomize();
+    UniTensor ref = A;
+    ref.set_zero();
+    ref += A;
+    Real* elem = A.const_getBlock(Qnum(0)).getElem();
+
+    size_t allocs = ELEM_ALLOC_COUNT;
+    UniTensor B(std::move(A));
+    ASSERT_EQ(elem, B.const_getBlock(Qnum(0)).getElem());
+    ASSERT_EQ(0, A.elemNum());
+    ASSERT_EQ(0, A.bondNum());
+    ASSERT_TRUE(A.blockQnum().empty());
+    ASSERT_TRUE(B.elemCmp(ref));
+
+    A = std::move(B);
+    ASSERT_EQ(elem, A.const_getBlock(Qnum(0)).getElem());
+    ASSERT_EQ(0, B.elemNum());
+    ASSERT_TRUE(A.elemCmp(ref));
+    ASSERT_EQ(labelA[3], A.label(3));
+
+    std::vector<UniTensor> tens;
+    for(int i = 0; i < 16; i++)
+        tens.push_back(A);
+    ASSERT_TRUE(tens.back().elemCmp(ref));
+    tens.clear();
+    A *= 2.0;
+    ASSERT_EQ(allocs, ELEM_ALLOC_COUNT);
+    ASSERT_TRUE(A.elemCmp(ref * 2.0));
+
+    // Only the result of the contraction is allocated
+    B = A;
+    B.setLabel(labelB);
+    allocs = ELEM_ALLOC_COUNT;
+    UniTensor C = contract(A, B);
+    ASSERT_EQ(allocs + 1, ELEM_ALLOC_COUNT);
+    ASSERT_TRUE(C.elemCmp(contract(ref, B) * 2.0));
+
+    // A moved-from tensor can be assigned again
+    UniTensor D(std::move(C));
+    C = D;
+    ASSERT_TRUE(C.elemCmp(D));
+}